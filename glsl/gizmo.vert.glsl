@@ -0,0 +1,33 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Draws one joint gizmo per instance. The geometry is in the joint's local space;
+// the joint's world matrix, parent position and tint come from u_Instances.
+
+uniform mat4 u_ViewProj;
+
+uniform samplerBuffer u_Instances; // 6 texels per joint: matrix columns, parent position, tint
+
+in vec4 vs_Pos;     // w = 0 marks the end of the bone that sits on the parent
+in vec4 vs_Col;
+
+out vec4 fs_Col;
+
+void main()
+{
+    int base = gl_InstanceID * 6;
+    mat4 world = mat4(texelFetch(u_Instances, base),
+                      texelFetch(u_Instances, base + 1),
+                      texelFetch(u_Instances, base + 2),
+                      texelFetch(u_Instances, base + 3));
+    vec4 parentPos = texelFetch(u_Instances, base + 4);
+    vec4 tint = texelFetch(u_Instances, base + 5);
+
+    vec4 worldPos = vs_Pos.w == 0 ? parentPos : world * vs_Pos;
+
+    // selected joints tint their circles; the bone keeps its colors
+    bool circle = dot(vs_Pos.xyz, vs_Pos.xyz) > 0;
+    fs_Col = (circle && tint.a > 0) ? tint : vs_Col;
+
+    gl_Position = u_ViewProj * worldPos;
+}
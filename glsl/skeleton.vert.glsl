@@ -20,11 +20,11 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
-uniform mat4 u_bindMatrices[100]; // the uniform array of matrices that
-                                  // each describe the bind matrix of a particular joint
+uniform samplerBuffer u_JointPalette; // 3 texels per joint: the top three rows of the joint's skin
+                                      // matrix (overall transformation * bind matrix)
 
-uniform mat4 u_jointTrans[100]; // the uniform array of matrices that
-                                // each describe the overall transformation of a particular joint
+uniform int u_PaletteBase;  // The texel where the current pose starts in u_JointPalette
+                            // (non-zero when playing back a bake holding many poses)
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 
@@ -32,9 +32,10 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
-in ivec2 vs_ids;            // The array of IDs of the joints
+in ivec4 vs_ids;            // The array of IDs of the (up to four) joints moving the vertex
 
-in vec2 vs_Inf;             // The array of joint influences on the vertex
+in vec4 vs_Inf;             // The array of joint influences on the vertex; they sum to 1,
+                            // or to 0 for a vertex that isn't bound to the skeleton
 
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
@@ -43,36 +44,42 @@ out vec4 fs_Col;            // The color of each vertex. This is implicitly pass
 const vec4 lightPos = vec4(5, 5, 3, 1); //The position of our virtual light, which is used to compute the shading of
                                         //the geometry in the fragment shader.
 
-void main() {
-
-
-    // get bind matrices based on joint IDs
-    int id1 = vs_ids[0];
-    mat4 fs_Bind1 = u_bindMatrices[id1];
-    mat4 fs_Trans1 = u_jointTrans[id1];
-
-    int id2 = vs_ids[1];
-    mat4 fs_Bind2 = u_bindMatrices[id2];
-    mat4 fs_Trans2 = u_jointTrans[id2];
+// apply the affine skin matrix of the given joint to p
+vec3 skin(int id, vec4 p) {
+    int texel = u_PaletteBase + 3 * id;
+    return vec3(dot(texelFetch(u_JointPalette, texel), p),
+                dot(texelFetch(u_JointPalette, texel + 1), p),
+                dot(texelFetch(u_JointPalette, texel + 2), p));
+}
 
-    // pass joint influence on vertices
-    float inf1 = vs_Inf[0];
-    float inf2 = vs_Inf[1];
+void main() {
 
     //color influence
     fs_Col = vs_Col;
 
+    // blend the skinned positions and normals of every influence
+    // (w = 0 drops the translation column for the normal)
+    vec3 pos = vec3(0);
+    vec3 skinNor = vec3(0);
+    for (int i = 0; i < 4; ++i) {
+        if (vs_Inf[i] > 0) {
+            pos += vs_Inf[i] * skin(vs_ids[i], vs_Pos);
+            skinNor += vs_Inf[i] * skin(vs_ids[i], vs_Nor);
+        }
+    }
+
+    // unbound vertices stay at their rest position
+    bool bound = vs_Inf[0] > 0;
+    vec4 newpos = bound ? vec4(pos, 1) : vs_Pos;
+    vec4 nor = bound ? vec4(normalize(skinNor), 0) : vs_Nor;
+
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * vec3(nor), 0);             // Pass the vertex normals to the fragment shader for interpolation.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
 
-
-     vec4 newpos = inf1 * fs_Trans1 * fs_Bind1 * vs_Pos;
-     newpos += inf2 * fs_Trans2 * fs_Bind2 * vs_Pos;
-
     fs_LightVec = lightPos - newpos;  // Compute the direction in which the light source lies
 
     gl_Position = u_ViewProj * newpos;// gl_Position is a built-in variable of OpenGL which is
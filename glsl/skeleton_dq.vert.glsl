@@ -0,0 +1,102 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+//This is a vertex shader. While it is called a "shader" due to outdated conventions, this file
+//is used to apply matrix transformations to the arrays of vertex data passed to it.
+//Since this code is run on your GPU, each vertex is transformed simultaneously.
+//If it were run on your CPU, each vertex would have to be processed in a FOR loop, one at a time.
+//This simultaneous transformation allows your program to run much faster, especially when rendering
+//geometry with millions of vertices.
+
+uniform mat4 u_Model;       // The matrix that defines the transformation of the
+                            // object we're rendering. In this assignment,
+                            // this will be the result of traversing your scene graph.
+
+uniform mat4 u_ModelInvTr;  // The inverse transpose of the model matrix.
+                            // This allows us to transform the object's normals properly
+                            // if the object has been non-uniformly scaled.
+
+uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformation.
+                            // We've written a static matrix for you to use for HW2,
+                            // but in HW3 you'll have to generate one yourself
+
+uniform samplerBuffer u_JointPalette; // 2 texels per joint: the rotation (real part) and translation
+                                      // (dual part) of the joint's skin transformation as a unit dual
+                                      // quaternion, stored xyzw
+
+uniform int u_PaletteBase;  // The texel where the current pose starts in u_JointPalette
+                            // (non-zero when playing back a bake holding many poses)
+
+in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+
+in vec4 vs_Nor;             // The array of vertex normals passed to the shader
+
+in vec4 vs_Col;             // The array of vertex colors passed to the shader.
+
+in ivec4 vs_ids;            // The array of IDs of the (up to four) joints moving the vertex
+
+in vec4 vs_Inf;             // The array of joint influences on the vertex; they sum to 1,
+                            // or to 0 for a vertex that isn't bound to the skeleton
+
+out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
+out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
+out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+
+const vec4 lightPos = vec4(5, 5, 3, 1); //The position of our virtual light, which is used to compute the shading of
+                                        //the geometry in the fragment shader.
+
+// rotate v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+
+    //color influence
+    fs_Col = vs_Col;
+
+    // blend the dual quaternions of every influence; a quaternion and its
+    // negation are the same rotation, so flip those facing away from the first
+    vec4 first = texelFetch(u_JointPalette, u_PaletteBase + 2 * vs_ids[0]);
+    vec4 real = vec4(0);
+    vec4 dual = vec4(0);
+    for (int i = 0; i < 4; ++i) {
+        float w = vs_Inf[i];
+        if (w > 0) {
+            vec4 r = texelFetch(u_JointPalette, u_PaletteBase + 2 * vs_ids[i]);
+            vec4 d = texelFetch(u_JointPalette, u_PaletteBase + 2 * vs_ids[i] + 1);
+            if (dot(r, first) < 0) {
+                w = -w;
+            }
+            real += w * r;
+            dual += w * d;
+        }
+    }
+
+    // unbound vertices stay at their rest position
+    bool bound = vs_Inf[0] > 0;
+    vec4 newpos = vs_Pos;
+    vec4 nor = vs_Nor;
+    if (bound) {
+        float len = length(real);
+        real /= len;
+        dual /= len;
+
+        // translation = 2 * dual * conjugate(real)
+        vec3 trans = 2 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+        newpos = vec4(rotate(real, vs_Pos.xyz) + trans, 1);
+        nor = vec4(rotate(real, vs_Nor.xyz), 0);
+    }
+
+    mat3 invTranspose = mat3(u_ModelInvTr);
+    fs_Nor = vec4(invTranspose * vec3(nor), 0);             // Pass the vertex normals to the fragment shader for interpolation.
+                                                            // Transform the geometry's normals by the inverse transpose of the
+                                                            // model matrix. This is necessary to ensure the normals remain
+                                                            // perpendicular to the surface after the surface is transformed by
+                                                            // the model matrix.
+
+    fs_LightVec = lightPos - newpos;  // Compute the direction in which the light source lies
+
+    gl_Position = u_ViewProj * newpos;// gl_Position is a built-in variable of OpenGL which is
+                                             // used to render the final positions of the geometry's vertices
+}
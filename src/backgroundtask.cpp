@@ -0,0 +1,62 @@
+#include "backgroundtask.h"
+
+// constructor
+BackgroundTask::BackgroundTask()
+    : cancelled(false), done(false), percent(0)
+{}
+
+// destructor
+BackgroundTask::~BackgroundTask() {
+    cancel();
+    finish();
+}
+
+// run work on a new thread
+bool BackgroundTask::start(std::function<void(BackgroundTask&)> work) {
+    if (isRunning()) {
+        return false;
+    }
+    cancelled = false;
+    done = false;
+    percent = 0;
+    thread = std::thread([this, work]() {
+        work(*this);
+        done = true;
+    });
+    return true;
+}
+
+// has work been started and not finished yet?
+bool BackgroundTask::isRunning() const {
+    return thread.joinable();
+}
+
+// has the work returned?
+bool BackgroundTask::isDone() const {
+    return done;
+}
+
+// wait for the work to return
+void BackgroundTask::finish() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+// ask the work to stop
+void BackgroundTask::cancel() {
+    cancelled = true;
+}
+
+bool BackgroundTask::isCancelled() const {
+    return cancelled;
+}
+
+// progress of the work in percent
+void BackgroundTask::setProgress(int p) {
+    percent = p;
+}
+
+int BackgroundTask::progress() const {
+    return percent;
+}
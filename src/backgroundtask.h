@@ -0,0 +1,46 @@
+#ifndef BACKGROUNDTASK_H
+#define BACKGROUNDTASK_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/// One piece of work run on its own thread while the GUI keeps going.
+///
+/// The work reports its progress and checks for cancellation through the task;
+/// the GUI thread polls isDone() and progress() (from a timer) and calls
+/// finish() once the work is done before it picks up the result. Cancelling
+/// only raises a flag: the work stops at its next check, and whatever it made
+/// is to be thrown away.
+
+class BackgroundTask {
+private:
+    std::thread thread;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> done;
+    std::atomic<int> percent;
+
+public:
+    BackgroundTask();
+    // cancels the work and waits for it
+    ~BackgroundTask();
+
+    // run work on a new thread; false if the previous work hasn't been finished
+    bool start(std::function<void(BackgroundTask&)> work);
+    // has work been started and not finished yet?
+    bool isRunning() const;
+    // has the work returned?
+    bool isDone() const;
+    // wait for the work to return
+    void finish();
+
+    // ask the work to stop
+    void cancel();
+    bool isCancelled() const;
+
+    // progress of the work in percent
+    void setProgress(int p);
+    int progress() const;
+};
+
+#endif // BACKGROUNDTASK_H
@@ -33,6 +33,23 @@ GLenum Drawable::drawMode()
     return GL_TRIANGLES;
 }
 
+GLenum Drawable::indexType()
+{
+    // bufIdx holds GLuints unless a subclass says otherwise
+    return GL_UNSIGNED_INT;
+}
+
+int Drawable::instanceCount()
+{
+    return 1;
+}
+
+bool Drawable::bindInstances(int /*unit*/)
+{
+    // plain drawables have no per-instance data
+    return false;
+}
+
 int Drawable::elemCount()
 {
     return count;
@@ -35,10 +35,13 @@ public:
     virtual ~Drawable();
 
     virtual void create() = 0; // To be implemented by subclasses. Populates the VBOs of the Drawable.
-    void destroy(); // Frees the VBOs of the Drawable.
+    virtual void destroy(); // Frees the VBOs of the Drawable.
 
     // Getter functions for various GL data
     virtual GLenum drawMode();
+    virtual GLenum indexType(); // GL_UNSIGNED_INT unless overridden
+    virtual int instanceCount(); // How many copies one draw call renders (1 unless overridden)
+    virtual bool bindInstances(int unit); // Binds per-instance data read through gl_InstanceID, if any
     int elemCount();
 
     // Call these functions when you want to call glGenBuffers on the buffers stored in the Drawable
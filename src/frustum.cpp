@@ -0,0 +1,60 @@
+#include "frustum.h"
+
+// Gribb & Hartmann: each clip plane is a sum or difference of the
+// fourth row of the matrix with one of the other three rows
+Frustum::Frustum(const glm::mat4 &viewProj)
+{
+    // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::mat4 t = glm::transpose(viewProj);
+    planes[0] = t[3] + t[0]; // left
+    planes[1] = t[3] - t[0]; // right
+    planes[2] = t[3] + t[1]; // bottom
+    planes[3] = t[3] - t[1]; // top
+    planes[4] = t[3] + t[2]; // near
+    planes[5] = t[3] - t[2]; // far
+
+    for (glm::vec4 &p : planes) {
+        p /= glm::length(glm::vec3(p));
+    }
+}
+
+bool Frustum::intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    for (const glm::vec4 &p : planes) {
+        // the corner of the box furthest along the plane normal
+        glm::vec3 corner(p.x >= 0 ? boxMax.x : boxMin.x,
+                         p.y >= 0 ? boxMax.y : boxMin.y,
+                         p.z >= 0 ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(p), corner) + p.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3 &center, float radius) const
+{
+    for (const glm::vec4 &p : planes) {
+        if (glm::dot(glm::vec3(p), center) + p.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Arvo's method: project the box extents onto each row of the matrix
+void Frustum::transformBounds(const glm::mat4 &m, glm::vec3 &boxMin, glm::vec3 &boxMax)
+{
+    glm::vec3 lo = glm::vec3(m[3]);
+    glm::vec3 hi = lo;
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            float a = m[col][row] * boxMin[col];
+            float b = m[col][row] * boxMax[col];
+            lo[row] += glm::min(a, b);
+            hi[row] += glm::max(a, b);
+        }
+    }
+    boxMin = lo;
+    boxMax = hi;
+}
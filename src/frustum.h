@@ -0,0 +1,29 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <la.h>
+
+//The six planes of a camera's view frustum, in world space
+//Used to skip drawing geometry the camera can't see
+class Frustum
+{
+private:
+    // plane i is the set of points p with dot(planes[i], vec4(p, 1)) == 0,
+    // the inside of the frustum being the positive side of all six
+    glm::vec4 planes[6];
+
+public:
+    // extract the planes from a combined projection * view matrix
+    Frustum(const glm::mat4 &viewProj);
+
+    // is any part of the axis-aligned box inside the frustum? (conservative)
+    bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+    // is any part of the sphere inside the frustum? (conservative)
+    bool intersects(const glm::vec3 &center, float radius) const;
+
+    // bounding box of an axis-aligned box after an affine transformation
+    static void transformBounds(const glm::mat4 &m, glm::vec3 &boxMin, glm::vec3 &boxMax);
+};
+
+#endif // FRUSTUM_H
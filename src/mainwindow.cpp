@@ -60,6 +60,21 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->loadOBJButton, SIGNAL(clicked(bool)), this, SLOT(slot_loadOBJClicked(bool)));
     connect(this, SIGNAL(sendLoadOBJ(bool)), ui->mygl, SLOT(slot_loadOBJ(bool)));
 
+    // drop the elements of a mesh that's being replaced
+    connect(ui->mygl, SIGNAL(sendClearMesh()), this, SLOT(slot_clearMeshLists()));
+
+    // sessions
+    connect(this, SIGNAL(sendOpenSession(bool)), ui->mygl, SLOT(slot_openSession(bool)));
+    connect(this, SIGNAL(sendSaveSession(bool)), ui->mygl, SLOT(slot_saveSession(bool)));
+
+    // import glTF
+    connect(this, SIGNAL(sendImportGLB(bool)), ui->mygl, SLOT(slot_importGLB(bool)));
+
+    // export mesh
+    connect(this, SIGNAL(sendExportOBJ(bool)), ui->mygl, SLOT(slot_exportOBJ(bool)));
+    connect(this, SIGNAL(sendExportPLY(bool)), ui->mygl, SLOT(slot_exportPLY(bool)));
+    connect(this, SIGNAL(sendExportRig(bool)), ui->mygl, SLOT(slot_exportRig(bool)));
+
     // load skeleton
     connect(ui->loadSkeleton, SIGNAL(clicked(bool)), this, SLOT(slot_loadSkeletonClicked(bool)));
     connect(this, SIGNAL(sendLoadSkeleton(bool)), ui->mygl, SLOT(slot_loadSkeleton(bool)));
@@ -101,6 +116,24 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(this, SIGNAL(sendNewJtYRot(bool)), ui->mygl, SLOT(slot_changeJtYRot(bool)));
     connect(this, SIGNAL(sendNewJtZRot(bool)), ui->mygl, SLOT(slot_changeJtZRot(bool)));
 
+    // skinning mode
+    connect(this, SIGNAL(sendDualQuatSkinning(bool)), ui->mygl, SLOT(slot_setDualQuatSkinning(bool)));
+
+    // animation
+    connect(this, SIGNAL(sendRecordKeyframe(bool)), ui->mygl, SLOT(slot_recordKeyframe(bool)));
+    connect(this, SIGNAL(sendPlayAnimation(bool)), ui->mygl, SLOT(slot_playAnimation(bool)));
+    connect(this, SIGNAL(sendClearAnimation(bool)), ui->mygl, SLOT(slot_clearAnimation(bool)));
+    connect(this, SIGNAL(sendBakePalettes(bool)), ui->mygl, SLOT(slot_bakePalettes(bool)));
+    connect(this, SIGNAL(sendSaveBakedPalettes(bool)), ui->mygl, SLOT(slot_saveBakedPalettes(bool)));
+    connect(this, SIGNAL(sendOpenBakedPalettes(bool)), ui->mygl, SLOT(slot_openBakedPalettes(bool)));
+    connect(this, SIGNAL(sendBakePointCache(bool)), ui->mygl, SLOT(slot_bakePointCache(bool)));
+    connect(this, SIGNAL(sendOpenPointCache(bool)), ui->mygl, SLOT(slot_openPointCache(bool)));
+
+    // inverse kinematics
+    connect(this, SIGNAL(sendAddIKHandle(bool)), ui->mygl, SLOT(slot_addIKHandle(bool)));
+    connect(this, SIGNAL(sendUseFABRIK(bool)), ui->mygl, SLOT(slot_setFABRIK(bool)));
+    connect(this, SIGNAL(sendClearIKHandles(bool)), ui->mygl, SLOT(slot_clearIKHandles(bool)));
+
     // name items
     connect(ui->mygl, SIGNAL(sendVertex(Vertex*)), this, SLOT(slot_getVertex(Vertex*)));
     connect(ui->mygl, SIGNAL(sendHE(HalfEdge*)), this, SLOT(slot_getHE(HalfEdge*)));
@@ -117,12 +150,105 @@ void MainWindow::on_actionQuit_triggered()
     QApplication::exit();
 }
 
+void MainWindow::on_actionOpen_Session_triggered()
+{
+    emit sendOpenSession(true);
+}
+
+void MainWindow::on_actionSave_Session_triggered()
+{
+    emit sendSaveSession(true);
+}
+
+void MainWindow::on_actionImport_glTF_triggered()
+{
+    emit sendImportGLB(true);
+}
+
+void MainWindow::on_actionExport_OBJ_triggered()
+{
+    emit sendExportOBJ(true);
+}
+
+void MainWindow::on_actionExport_PLY_triggered()
+{
+    emit sendExportPLY(true);
+}
+
+void MainWindow::on_actionExport_Rig_triggered()
+{
+    emit sendExportRig(true);
+}
+
 void MainWindow::on_actionCamera_Controls_triggered()
 {
     CameraControlsHelp* c = new CameraControlsHelp();
     c->show();
 }
 
+void MainWindow::on_actionDual_Quaternion_Skinning_triggered(bool checked)
+{
+    emit sendDualQuatSkinning(checked);
+}
+
+void MainWindow::on_actionRecord_Keyframe_triggered()
+{
+    emit sendRecordKeyframe(true);
+}
+
+void MainWindow::on_actionPlay_Animation_triggered(bool checked)
+{
+    emit sendPlayAnimation(checked);
+}
+
+void MainWindow::on_actionClear_Animation_triggered()
+{
+    ui->actionPlay_Animation->setChecked(false);
+    emit sendClearAnimation(true);
+}
+
+void MainWindow::on_actionBake_Palettes_triggered()
+{
+    emit sendBakePalettes(true);
+}
+
+void MainWindow::on_actionSave_Baked_Palettes_triggered()
+{
+    emit sendSaveBakedPalettes(true);
+}
+
+void MainWindow::on_actionOpen_Baked_Palettes_triggered()
+{
+    ui->actionPlay_Animation->setChecked(false);
+    emit sendOpenBakedPalettes(true);
+}
+
+void MainWindow::on_actionBake_Point_Cache_triggered()
+{
+    emit sendBakePointCache(true);
+}
+
+void MainWindow::on_actionOpen_Point_Cache_triggered()
+{
+    ui->actionPlay_Animation->setChecked(false);
+    emit sendOpenPointCache(true);
+}
+
+void MainWindow::on_actionAdd_IK_Handle_triggered()
+{
+    emit sendAddIKHandle(true);
+}
+
+void MainWindow::on_actionUse_FABRIK_triggered(bool checked)
+{
+    emit sendUseFABRIK(checked);
+}
+
+void MainWindow::on_actionRemove_IK_Handles_triggered()
+{
+    emit sendClearIKHandles(true);
+}
+
 // get mesh components and add them to the lists
 
 void MainWindow::slot_getVertex(Vertex* v) {
@@ -201,10 +327,14 @@ void MainWindow::slot_extrudeClicked(bool) {
 
 // load OBJ signal
 void MainWindow::slot_loadOBJClicked(bool) {
+    emit sendLoadOBJ(true);
+}
+
+// the list items are the mesh's elements, so this deletes them
+void MainWindow::slot_clearMeshLists() {
     ui->vertList->clear();
     ui->heList->clear();
     ui->faceList->clear();
-    emit sendLoadOBJ(true);
 }
 
 // load skeleton signal
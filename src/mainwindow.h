@@ -22,8 +22,30 @@ public:
 private slots:
     void on_actionQuit_triggered();
 
+    void on_actionOpen_Session_triggered();
+    void on_actionSave_Session_triggered();
+    void on_actionImport_glTF_triggered();
+    void on_actionExport_OBJ_triggered();
+    void on_actionExport_PLY_triggered();
+    void on_actionExport_Rig_triggered();
+
     void on_actionCamera_Controls_triggered();
 
+    void on_actionDual_Quaternion_Skinning_triggered(bool);
+
+    void on_actionRecord_Keyframe_triggered();
+    void on_actionPlay_Animation_triggered(bool);
+    void on_actionClear_Animation_triggered();
+    void on_actionBake_Palettes_triggered();
+    void on_actionSave_Baked_Palettes_triggered();
+    void on_actionOpen_Baked_Palettes_triggered();
+    void on_actionBake_Point_Cache_triggered();
+    void on_actionOpen_Point_Cache_triggered();
+
+    void on_actionAdd_IK_Handle_triggered();
+    void on_actionUse_FABRIK_triggered(bool);
+    void on_actionRemove_IK_Handles_triggered();
+
     void slot_getVertex(Vertex*);
     void slot_getHE(HalfEdge*);
     void slot_getFace(Face*);
@@ -46,6 +68,7 @@ private slots:
     void slot_extrudeClicked(bool);
 
     void slot_loadOBJClicked(bool);
+    void slot_clearMeshLists();
 
     void slot_loadSkeletonClicked(bool);
 
@@ -83,6 +106,12 @@ signals:
     void sendExtrude(bool);
 
     void sendLoadOBJ(bool);
+    void sendOpenSession(bool);
+    void sendSaveSession(bool);
+    void sendImportGLB(bool);
+    void sendExportOBJ(bool);
+    void sendExportPLY(bool);
+    void sendExportRig(bool);
     void sendLoadSkeleton(bool);
 
     void sendCurrJoint(Joint*);
@@ -101,6 +130,21 @@ signals:
     void sendNewJtYRot(bool);
     void sendNewJtZRot(bool);
 
+    void sendDualQuatSkinning(bool);
+
+    void sendRecordKeyframe(bool);
+    void sendPlayAnimation(bool);
+    void sendClearAnimation(bool);
+    void sendBakePalettes(bool);
+    void sendSaveBakedPalettes(bool);
+    void sendOpenBakedPalettes(bool);
+    void sendBakePointCache(bool);
+    void sendOpenPointCache(bool);
+
+    void sendAddIKHandle(bool);
+    void sendUseFABRIK(bool);
+    void sendClearIKHandles(bool);
+
 private:
     Ui::MainWindow *ui;
 };
@@ -1,15 +1,28 @@
 #include "mygl.h"
+#include <scene/skinbinding.h>
+#include <scene/objreader.h>
+#include <scene/meshcache.h>
+#include <scene/objwriter.h>
+#include <scene/plyreader.h>
+#include <scene/plywriter.h>
+#include <scene/glbreader.h>
+#include <scene/skeletonreader.h>
+#include <scene/rigfile.h>
+#include <scene/sessionfile.h>
+#include <scene/cpuskinning.h>
+#include <scene/normals.h>
 #include <la.h>
 
+#include <algorithm>
+#include <cmath>
+#include <random>
 #include <iostream>
 #include <QApplication>
+#include <QDebug>
 #include <QKeyEvent>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QString>
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
-#include <QJsonValue>
 #include <glm/gtc/matrix_transform.hpp>
 
 
@@ -17,7 +30,7 @@ MyGL::MyGL(QWidget *parent)
     : GLWidget277(parent),
       m_geomCylinder(this), m_geomSphere(this),
       m_geomMesh(this),
-      m_progLambert(this), m_progFlat(this), prog_skeleton(this),
+      m_progLambert(this), m_progFlat(this), prog_skeleton(this), prog_skeletonDQ(this), prog_gizmo(this),
       m_glCamera(),
       currVert(nullptr),
       currHE(nullptr),
@@ -26,14 +39,38 @@ MyGL::MyGL(QWidget *parent)
       heSelect(this),
       faceSelect(this),
       skeleton(std::vector<Joint*>()),
+      skeletonGizmo(this),
+      jointPaletteBuf(this),
+      paletteDirty(false),
       currJoint(nullptr),
-      skinPressed(false)
+      skinPressed(false),
+      dualQuatSkinning(false),
+      animKeyCount(0),
+      bakedPaletteBuf(this),
+      bakedDirty(false),
+      bakedFrame(0),
+      maxBufferTexels(0),
+      pointCacheFrame(-1),
+      ikSolver(ik::CCD),
+      loadProgress(nullptr)
 {
     setFocusPolicy(Qt::StrongFocus);
+
+    // about 60 frames per second while an animation plays
+    animTimer.setInterval(16);
+    connect(&animTimer, SIGNAL(timeout()), this, SLOT(timerUpdate()));
+
+    // poll a background load often enough for a smooth progress bar
+    loadTimer.setInterval(50);
+    connect(&loadTimer, SIGNAL(timeout()), this, SLOT(slot_pollLoad()));
 }
 
 MyGL::~MyGL()
 {
+    // a load still running writes into loadResult until it stops
+    loadTask.cancel();
+    loadTask.finish();
+
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
     m_geomCylinder.destroy();
@@ -42,136 +79,48 @@ MyGL::~MyGL()
     vertSelect.destroy();
     heSelect.destroy();
     faceSelect.destroy();
-    for (Joint* jt : skeleton) {
-        jt->destroy();
-    }
+    skeletonGizmo.destroy();
+    jointPaletteBuf.destroy();
+    bakedPaletteBuf.destroy();
 }
 
 void MyGL::setupCube() {
-    // create vertices
-    std::vector<Vertex*> verts;
-    verts.push_back(new Vertex(glm::vec4(-0.5, -0.5, 0.5, 1)));    // 0
-    verts.push_back(new Vertex(glm::vec4(0.5, -0.5, 0.5, 1)));     // 1
-    verts.push_back(new Vertex(glm::vec4(0.5, 0.5, 0.5, 1)));      // 2
-    verts.push_back(new Vertex(glm::vec4(-0.5, 0.5, 0.5, 1)));     // 3
-    verts.push_back(new Vertex(glm::vec4(-0.5, -0.5, -0.5, 1)));   // 4
-    verts.push_back(new Vertex(glm::vec4(-0.5, 0.5, -0.5, 1)));    // 5
-    verts.push_back(new Vertex(glm::vec4(0.5, 0.5, -0.5, 1)));     // 6
-    verts.push_back(new Vertex(glm::vec4(0.5, -0.5, -0.5, 1)));    // 7
-
-    std::vector<Face*> faces;
-
-    faces.push_back(new Face(glm::vec4(1, 0, 0, 1))); // 0: red
-    faces.push_back(new Face(glm::vec4(0, 1, 0, 1))); // 1: green
-    faces.push_back(new Face(glm::vec4(0, 0, 1, 1))); // 2: blue
-    faces.push_back(new Face(glm::vec4(1, 1, 0, 1))); // 3: yellow
-    faces.push_back(new Face(glm::vec4(0, 1, 1, 1))); // 4: cyan
-    faces.push_back(new Face(glm::vec4(1, 0, 1, 1))); // 5: magenta
-
-    // create half-edges
-    std::vector<HalfEdge*> halfedges;
-    // face 0
-    halfedges.push_back(new HalfEdge(faces.at(0), verts.at(0)));    // 0
-    halfedges.push_back(new HalfEdge(faces.at(0), verts.at(1)));    // 1
-    halfedges.push_back(new HalfEdge(faces.at(0), verts.at(2)));    // 2
-    halfedges.push_back(new HalfEdge(faces.at(0), verts.at(3)));    // 3
-
-    // face 1
-    halfedges.push_back(new HalfEdge(faces.at(1), verts.at(1)));    // 4
-    halfedges.push_back(new HalfEdge(faces.at(1), verts.at(7)));    // 5
-    halfedges.push_back(new HalfEdge(faces.at(1), verts.at(6)));    // 6
-    halfedges.push_back(new HalfEdge(faces.at(1), verts.at(2)));    // 7
-
-    // face 2
-    halfedges.push_back(new HalfEdge(faces.at(2), verts.at(7)));    // 8
-    halfedges.push_back(new HalfEdge(faces.at(2), verts.at(4)));    // 9
-    halfedges.push_back(new HalfEdge(faces.at(2), verts.at(5)));    // 10
-    halfedges.push_back(new HalfEdge(faces.at(2), verts.at(6)));    // 11
-
-    // face 3
-    halfedges.push_back(new HalfEdge(faces.at(3), verts.at(4)));    // 12
-    halfedges.push_back(new HalfEdge(faces.at(3), verts.at(0)));    // 13
-    halfedges.push_back(new HalfEdge(faces.at(3), verts.at(3)));    // 14
-    halfedges.push_back(new HalfEdge(faces.at(3), verts.at(5)));    // 15
-
-    // face 4
-    halfedges.push_back(new HalfEdge(faces.at(4), verts.at(0)));    // 16
-    halfedges.push_back(new HalfEdge(faces.at(4), verts.at(4)));    // 17
-    halfedges.push_back(new HalfEdge(faces.at(4), verts.at(7)));    // 18
-    halfedges.push_back(new HalfEdge(faces.at(4), verts.at(1)));    // 19
-
-    // face 5
-    halfedges.push_back(new HalfEdge(faces.at(5), verts.at(2)));    // 20
-    halfedges.push_back(new HalfEdge(faces.at(5), verts.at(6)));    // 21
-    halfedges.push_back(new HalfEdge(faces.at(5), verts.at(5)));    // 22
-    halfedges.push_back(new HalfEdge(faces.at(5), verts.at(3)));    // 23
-
-    for (int i = 0; i < faces.size(); i++) {
-        faces.at(i)->setHE(halfedges.at(4 * i));
-    }
-
-    // set pointers to HEs for vertices
-    verts.at(0)->setEdge(halfedges.at(0));
-    verts.at(1)->setEdge(halfedges.at(1));
-    verts.at(2)->setEdge(halfedges.at(2));
-    verts.at(3)->setEdge(halfedges.at(3));
-    verts.at(4)->setEdge(halfedges.at(9));
-    verts.at(5)->setEdge(halfedges.at(10));
-    verts.at(6)->setEdge(halfedges.at(11));
-    verts.at(7)->setEdge(halfedges.at(8));
-
-    // set next pointers
-    for (HalfEdge* he : halfedges) {
-        int id = he->getID();
-        if (id % 4 != 3) {
-            he->setNextHE(halfedges.at(id + 1));
-        } else {
-            he->setNextHE(halfedges.at(id - 3));
-        }
+    MeshArrays arrays;
+
+    // vertices
+    arrays.positions.push_back(glm::vec4(-0.5, -0.5, 0.5, 1));    // 0
+    arrays.positions.push_back(glm::vec4(0.5, -0.5, 0.5, 1));     // 1
+    arrays.positions.push_back(glm::vec4(0.5, 0.5, 0.5, 1));      // 2
+    arrays.positions.push_back(glm::vec4(-0.5, 0.5, 0.5, 1));     // 3
+    arrays.positions.push_back(glm::vec4(-0.5, -0.5, -0.5, 1));   // 4
+    arrays.positions.push_back(glm::vec4(-0.5, 0.5, -0.5, 1));    // 5
+    arrays.positions.push_back(glm::vec4(0.5, 0.5, -0.5, 1));     // 6
+    arrays.positions.push_back(glm::vec4(0.5, -0.5, -0.5, 1));    // 7
+
+    // faces: the vertices each half-edge points to, in order
+    const uint32_t corners[6][4] = {
+        {0, 1, 2, 3},   // 0: red
+        {1, 7, 6, 2},   // 1: green
+        {7, 4, 5, 6},   // 2: blue
+        {4, 0, 3, 5},   // 3: yellow
+        {0, 4, 7, 1},   // 4: cyan
+        {2, 6, 5, 3},   // 5: magenta
+    };
+    for (int f = 0; f < 6; ++f) {
+        arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+        arrays.corners.insert(arrays.corners.end(), corners[f], corners[f] + 4);
     }
+    arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
 
-    // set sym pointers
-    // face 0
-    halfedges.at(0)->setSymHE(halfedges.at(14));
-    halfedges.at(1)->setSymHE(halfedges.at(16));
-    halfedges.at(2)->setSymHE(halfedges.at(4));
-    halfedges.at(3)->setSymHE(halfedges.at(20));
-
-    // face 1
-    halfedges.at(4)->setSymHE(halfedges.at(2));
-    halfedges.at(5)->setSymHE(halfedges.at(19));
-    halfedges.at(6)->setSymHE(halfedges.at(8));
-    halfedges.at(7)->setSymHE(halfedges.at(21));
-
-    // face 2
-    halfedges.at(8)->setSymHE(halfedges.at(6));
-    halfedges.at(9)->setSymHE(halfedges.at(18));
-    halfedges.at(10)->setSymHE(halfedges.at(12));
-    halfedges.at(11)->setSymHE(halfedges.at(22));
-
-    // face 3
-    halfedges.at(12)->setSymHE(halfedges.at(10));
-    halfedges.at(13)->setSymHE(halfedges.at(17));
-    halfedges.at(14)->setSymHE(halfedges.at(0));
-    halfedges.at(15)->setSymHE(halfedges.at(23));
-
-    // face 4
-    halfedges.at(16)->setSymHE(halfedges.at(1));
-    halfedges.at(17)->setSymHE(halfedges.at(13));
-    halfedges.at(18)->setSymHE(halfedges.at(9));
-    halfedges.at(19)->setSymHE(halfedges.at(5));
-
-    // face 5
-    halfedges.at(20)->setSymHE(halfedges.at(3));
-    halfedges.at(21)->setSymHE(halfedges.at(7));
-    halfedges.at(22)->setSymHE(halfedges.at(11));
-    halfedges.at(23)->setSymHE(halfedges.at(15));
-
-    // create cube mesh and set values
-    m_geomMesh.setVerts(verts);
-    m_geomMesh.setFaces(faces);
-    m_geomMesh.setHEs(halfedges);
+    arrays.faceColors.push_back(glm::vec4(1, 0, 0, 1));
+    arrays.faceColors.push_back(glm::vec4(0, 1, 0, 1));
+    arrays.faceColors.push_back(glm::vec4(0, 0, 1, 1));
+    arrays.faceColors.push_back(glm::vec4(1, 1, 0, 1));
+    arrays.faceColors.push_back(glm::vec4(0, 1, 1, 1));
+    arrays.faceColors.push_back(glm::vec4(1, 0, 1, 1));
 
+    // create cube mesh: next and sym pointers come from the connectivity builder
+    m_geomMesh.setArrays(arrays);
 }
 
 
@@ -203,11 +152,20 @@ void MyGL::initializeGL()
     setupCube();
     m_geomMesh.create();
 
+    // Shared geometry of the joint gizmos
+    skeletonGizmo.create();
+
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
     // Create and set up the flat lighting shader
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
     prog_skeleton.create(":/glsl/skeleton.vert.glsl", ":/glsl/skeleton.frag.glsl");
+    prog_skeletonDQ.create(":/glsl/skeleton_dq.vert.glsl", ":/glsl/skeleton.frag.glsl");
+    // Create the instanced joint gizmo shader
+    prog_gizmo.create(":/glsl/gizmo.vert.glsl", ":/glsl/flat.frag.glsl");
+
+    // how many frames of baked palettes fit in one buffer texture
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxBufferTexels);
 
     // Set a color with which to draw geometry since you won't have one
     // defined until you implement the Node classes.
@@ -245,10 +203,55 @@ void MyGL::resizeGL(int w, int h)
     m_progLambert.setViewProjMatrix(viewproj);
     m_progFlat.setViewProjMatrix(viewproj);
     prog_skeleton.setViewProjMatrix(viewproj);
+    prog_skeletonDQ.setViewProjMatrix(viewproj);
+    prog_gizmo.setViewProjMatrix(viewproj);
 
     printGLErrorLog();
 }
 
+// is any part of the chunk inside the frustum?
+// a skinned vertex is a weighted average of its rest position moved by each of its
+// joints (and of the rest position itself for weights short of one), so the union of
+// the rest bounds moved by every joint of the chunk, plus the rest bounds if some
+// vertex isn't fully bound, holds it
+bool MyGL::chunkVisible(const Frustum &frustum, const MeshChunk &chunk) const {
+    if (playingBaked() || showingPointCache()) {
+        // the skin matrices aren't evaluated while playing a bake or a point cache
+        return true;
+    }
+
+    const std::vector<int> &ids = chunk.getJointIDs();
+    if (!skinPressed || skinMatrices.empty() || ids.empty()) {
+        return frustum.intersects(chunk.getBoundsMin(), chunk.getBoundsMax());
+    }
+    if (dualQuatSkinning) {
+        // a dual quaternion blend turns each vertex with the blended rotation
+        // about a blended pivot, so it can swing out of every joint's box by an
+        // amount that depends on its distance from the joints, not on the
+        // chunk's size; without a bound for that, skinned chunks are drawn
+        return true;
+    }
+
+    glm::vec3 posedMin(HUGE_VALF);
+    glm::vec3 posedMax(-HUGE_VALF);
+    if (chunk.hasRestVertices()) {
+        posedMin = chunk.getBoundsMin();
+        posedMax = chunk.getBoundsMax();
+    }
+    for (int id : ids) {
+        if (id < 0 || id >= (int) skinMatrices.size()) {
+            // stale influence from an older skeleton: can't bound it, so draw it
+            return true;
+        }
+        glm::vec3 boundsMin = chunk.getBoundsMin();
+        glm::vec3 boundsMax = chunk.getBoundsMax();
+        Frustum::transformBounds(skinMatrices[id], boundsMin, boundsMax);
+        posedMin = glm::min(posedMin, boundsMin);
+        posedMax = glm::max(posedMax, boundsMax);
+    }
+    return frustum.intersects(posedMin, posedMax);
+}
+
 //This function is called by Qt any time your GL window is supposed to update
 //For example, when the function updateGL is called, paintGL is called implicitly.
 //DO NOT CONSTRUCT YOUR SCENE GRAPH IN THIS FUNCTION!
@@ -263,26 +266,65 @@ void MyGL::paintGL()
     m_progFlat.setViewProjMatrix(m_glCamera.getViewProj());
     m_progLambert.setViewProjMatrix(m_glCamera.getViewProj());
     prog_skeleton.setViewProjMatrix(m_glCamera.getViewProj());
+    prog_skeletonDQ.setViewProjMatrix(m_glCamera.getViewProj());
+    prog_gizmo.setViewProjMatrix(m_glCamera.getViewProj());
 
     //#define NOPE
 #ifndef NOPE
     glm::mat4 model;
 
-    if (skinPressed) {
-        prog_skeleton.setModelMatrix(model);
-        prog_skeleton.draw(m_geomMesh);
-    } else {
-        m_progLambert.setModelMatrix(model);
-        m_progLambert.draw(m_geomMesh);
+    // only geometry that overlaps the view frustum gets submitted
+    Frustum frustum(m_glCamera.getViewProj());
+
+    // draw the mesh chunk by chunk
+    bool skinOnGPU = skinPressed && !showingPointCache(); // point cache positions are posed already
+    ShaderProgram &skinProg = dualQuatSkinning ? prog_skeletonDQ : prog_skeleton;
+    ShaderProgram &meshProg = skinOnGPU ? skinProg : m_progLambert;
+    meshProg.setModelMatrix(model);
+    if (playingBaked()) {
+        size_t frameTexels = bakedPalettes.getFrameTexels();
+        if (bakedPalettes.getTexelCount() <= (size_t) maxBufferTexels) {
+            // every frame is uploaded once; after that a frame is just an offset
+            if (bakedDirty) {
+                bakedPaletteBuf.upload(bakedPalettes.getData(),
+                                       bakedPalettes.getTexelCount() * sizeof(glm::vec4));
+                bakedDirty = false;
+            }
+            bakedPaletteBuf.bind(1);
+            skinProg.setPaletteBase((int) (bakedFrame * frameTexels));
+        } else {
+            // too big for one buffer texture: stream the frame into the live palette
+            const glm::vec4* frame = bakedPalettes.getData() + bakedFrame * frameTexels;
+            jointPaletteBuf.upload(frame, frameTexels * sizeof(glm::vec4));
+            jointPaletteBuf.bind(1);
+            skinProg.setPaletteBase(0);
+            paletteDirty = true;
+        }
+        skinProg.setJointPalette(1);
+    } else if (skinOnGPU) {
+        if (paletteDirty) {
+            // the whole palette goes up in one glBufferSubData per pose change
+            jointPaletteBuf.upload(jointPalette.data(), jointPalette.size() * sizeof(glm::vec4));
+            paletteDirty = false;
+        }
+        jointPaletteBuf.bind(1);
+        skinProg.setPaletteBase(0);
+        skinProg.setJointPalette(1);
+    }
+    for (MeshChunk* chunk : m_geomMesh.getChunks()) {
+        if (chunkVisible(frustum, *chunk)) {
+            meshProg.draw(*chunk);
+        }
     }
 
     // disable depth when drawing mesh components
     glDisable(GL_DEPTH_TEST);
 
-    // draw skeleton
-    m_progFlat.setModelMatrix(model);
-    for (Joint* bone : skeleton) {
-         m_progFlat.draw(*bone);
+    // draw skeleton: one instance per visible joint
+    // (a bake or a point cache holds no joint poses, so the skeleton is hidden while it plays)
+    if (!playingBaked() && !showingPointCache()) {
+        skeletonGizmo.cull(frustum);
+        prog_gizmo.draw(skeletonGizmo);
     }
 
     // draw selected mesh component
@@ -352,7 +394,8 @@ void MyGL::keyPressEvent(QKeyEvent *e)
             heSelect.create();
         }
     } else if (e->key() == Qt::Key_M) {
-        if (currHE != nullptr) {
+        // boundary half edges have no sym to go to
+        if (currHE != nullptr && currHE->getSymHE() != nullptr) {
             currHE = currHE->getSymHE();
             heSelect.setHE(currHE);
             heSelect.create();
@@ -416,8 +459,7 @@ void MyGL::slot_changeX(double x) {
     if (currVert != nullptr) {
         glm::vec4 coord = currVert->getCoord();
         currVert->setCoord(glm::vec4(coord[0] + x, coord[1], coord[2], 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateVertex(currVert);
         update();
     }
 }
@@ -426,8 +468,7 @@ void MyGL::slot_changeY(double y) {
     if (currVert != nullptr) {
         glm::vec4 coord = currVert->getCoord();
         currVert->setCoord(glm::vec4(coord[0], coord[1] + y, coord[2], 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateVertex(currVert);
         update();
     }
 }
@@ -436,8 +477,7 @@ void MyGL::slot_changeZ(double z) {
     if (currVert != nullptr) {
         glm::vec4 coord = currVert->getCoord();
         currVert->setCoord(glm::vec4(coord[0], coord[1], coord[2] + z, 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateVertex(currVert);
         update();
     }
 }
@@ -448,8 +488,7 @@ void MyGL::slot_changeR(double r) {
     if (currFace != nullptr) {
         glm::vec4 col = currFace->getColor();
         currFace->setColor(glm::vec4(r, col[1], col[2], 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateFace(currFace);
         update();
     }
 }
@@ -458,8 +497,7 @@ void MyGL::slot_changeG(double g){
     if (currFace != nullptr) {
         glm::vec4 col = currFace->getColor();
         currFace->setColor(glm::vec4(col[0], g, col[2], 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateFace(currFace);
         update();
     }
 }
@@ -468,8 +506,7 @@ void MyGL::slot_changeB(double b){
     if (currFace != nullptr) {
         glm::vec4 col = currFace->getColor();
         currFace->setColor(glm::vec4(col[0], col[1], b, 1));
-        m_geomMesh.destroy();
-        m_geomMesh.create();
+        m_geomMesh.updateFace(currFace);
         update();
     }
 }
@@ -572,200 +609,366 @@ void MyGL::slot_extrude(bool pressed) {
     }
 }
 
+// read a mesh file (or its binary cache) and build its connectivity; runs on
+// the loading thread, so it must not touch the scene
+static bool readMesh(const QString &filename, unsigned seed, BackgroundTask &task,
+                     MeshArrays &arrays, connectivity::Links &links) {
+    bool ply = filename.endsWith(".ply", Qt::CaseInsensitive);
+
+    // reuse the binary cache of this file if it was made from this
+    // exact version of it, and write one otherwise
+    QString cachePath = meshcache::cachePath(filename);
+    meshcache::SourceStamp source = meshcache::stamp(filename);
+    if (meshcache::load(cachePath, arrays, links, &source)) {
+        return true;
+    }
+    task.setProgress(5);
+    if (task.isCancelled() || !(ply ? plyreader::read(filename, arrays) : objreader::read(filename, arrays))) {
+        return false;
+    }
+    task.setProgress(60);
+    if (task.isCancelled()) {
+        return false;
+    }
+
+    // files without colors get random ones
+    std::minstd_rand random(seed);
+    std::uniform_real_distribution<float> channel(0.f, 1.f);
+    for (size_t f = arrays.faceColors.size(); f < arrays.faceCount(); ++f) {
+        float r = channel(random);
+        float g = channel(random);
+        float b = channel(random);
+        arrays.faceColors.push_back(glm::vec4(r, g, b, 1));
+    }
+    connectivity::build(arrays.faceOffsets, arrays.corners, arrays.positions.size(), links);
+    task.setProgress(90);
+    if (task.isCancelled()) {
+        return false;
+    }
+    if (!meshcache::save(cachePath, arrays, links, &source)) {
+        qDebug() << "could not write mesh cache" << cachePath;
+    }
+    return true;
+}
+
+// read a .glb file and build its connectivity; runs on the loading thread
+static bool readGLB(const QString &filename, unsigned seed, BackgroundTask &task, MeshArrays &arrays,
+                    connectivity::Links &links, glbreader::SkeletonData &skeletonData) {
+    task.setProgress(5);
+    if (!glbreader::read(filename, arrays, skeletonData, &task)) {
+        return false;
+    }
+    task.setProgress(60);
+    if (task.isCancelled()) {
+        return false;
+    }
+
+    // faces without a material color get random ones
+    std::minstd_rand random(seed);
+    std::uniform_real_distribution<float> channel(0.f, 1.f);
+    for (size_t f = arrays.faceColors.size(); f < arrays.faceCount(); ++f) {
+        float r = channel(random);
+        float g = channel(random);
+        float b = channel(random);
+        arrays.faceColors.push_back(glm::vec4(r, g, b, 1));
+    }
+    connectivity::build(arrays.faceOffsets, arrays.corners, arrays.positions.size(), links);
+    task.setProgress(90);
+    return !task.isCancelled();
+}
+
 // load obj file
 void MyGL::slot_loadOBJ(bool pressed) {
     if (pressed) {
-        std::vector<Vertex*> vertices;
-        std::vector<HalfEdge*> halfedges;
-        std::vector<Face*> faces;
-        QMap<std::pair<Vertex*, Vertex*>, HalfEdge*> hePairs;
-
         QString filename = QFileDialog::getOpenFileName(0,
                                                         QString("LoadOBJ"),
                                                         QString("../../"),
-                                                        tr("*.obj"));
-        QFile file(filename);
-
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            // clear cube
-            m_geomMesh.destroy();
-            HalfEdge::resetID();
-            Vertex::resetID();
-            Face::resetID();
-
-            QTextStream in(&file);
-            QString line = in.readLine();
-
-            while (!line.isNull()) {
-
-                // parse through vertices
-                if(line.indexOf(QString("v ")) == 0) {
-                    QTextStream stream(&line);
-                    // read in vertex position
-                    // get rid of "v "
-                    QString prefix;
-                    float xPos;
-                    float yPos;
-                    float zPos;
-                    stream >> prefix >> xPos >> yPos >> zPos;
-
-                    glm::vec4 pos = glm::vec4(xPos, yPos, zPos, 1);
-
-                    // Make new vertex
-                    Vertex* v = new Vertex(pos);
-
-                    // add vertex to list of vertices
-                    vertices.push_back(v);
-                }
-
-                // parse through faces
-                if(line.indexOf(QString("f ")) == 0) {
-                    QTextStream stream(&line);
-
-                    // get rid of "f "
-                    QString prefix;
-                    stream >> prefix;
-
-                    std::vector<QString> strVec;
-                    while (!stream.atEnd()) {
-                        QString curr;
-                        stream >> curr;
-                        strVec.push_back(curr);
-                    }
-
-                    std::vector<QString> indices;
-                    for (QString str : strVec) {
-                        QString val = "";
-                        for (int i = 0; i < str.length(); ++i) {
-                            if (str.at(i) != "/") {
-                                val += str.at(i);
-                            } else {
-                                break;
-                            }
-                        }
-                        indices.push_back(val);
-                    }
-
-                    float r = ((float) rand() / (RAND_MAX));
-                    float g = ((float) rand() / (RAND_MAX));
-                    float b = ((float) rand() / (RAND_MAX));
-                    Face* f = new Face(glm::vec4(r, g, b, 1));
-
-                    /// we are creating our HEs as we're creating the face
-                    /// for each half edge we create, we store it in a map
-                    /// under a vertex pair (v1, v2) or (v2, v3)
-                    /// if either (v1, v2) or (v2, v3) are in the map:
-                    ///     -- get the half edge the pair points to and set
-                    ///        that as the sym of the current HE
-                    /// else:
-                    ///     -- add the current vertex pair and map it to the current HE
-
-                    // create half edges
-                    std::vector<HalfEdge*> faceHEs;
-                    for (int i = 0; i < indices.size(); ++i) {
-                        int index = indices.at(i).toInt() - 1;
-                        HalfEdge* he = new HalfEdge(f, vertices.at(index));
-
-                        Vertex* currVert = vertices.at(index);
-                        Vertex* prevVert;
-                        if (i == 0) {
-                            // last vertex in face list
-                            prevVert =  vertices.at(indices.at(indices.size() - 1).toInt() - 1);
-                        } else {
-                            // previous vertex in face list
-                            prevVert = vertices.at(indices.at(i - 1).toInt() - 1);
-                        }
-                        // set vertex pointer
-                        currVert->setEdge(he);
-
-                        // add to list of face HEs
-                        faceHEs.push_back(he);
-
-                        // add vertex pair and HE to map OR set sym pointer
-                        std::pair<Vertex*, Vertex*> pair1 = std::make_pair(currVert, prevVert);
-                        std::pair<Vertex*, Vertex*> pair2 = std::make_pair(prevVert, currVert);
-                        if (hePairs.contains(pair1) || hePairs.contains(pair2)) {
-                            std::pair<Vertex*, Vertex*> currPair;
-                            if (hePairs.contains(pair1)) {
-                                currPair = pair1;
-                            } else {
-                                currPair = pair2;
-                            }
-
-                            HalfEdge* sym = hePairs[currPair];
-                            he->setSymHE(sym);
-                        } else {
-                            hePairs.insert(pair1, he);
-                        }
-                    }
-
-                    // set face HE pointer
-                    f->setHE(faceHEs.at(0));
-
-                    // set next pointers
-                    for (int i = 0; i < faceHEs.size(); i++) {
-                        faceHEs.at(i)->setNextHE(faceHEs.at((i + 1) % faceHEs.size()));
-                        halfedges.push_back(faceHEs.at(i));
-                    }
-
-                    faces.push_back(f);
-                }
-
-                line = in.readLine();
-            }
-
-            m_geomMesh.setFaces(faces);
-            m_geomMesh.setHEs(halfedges);
-            m_geomMesh.setVerts(vertices);
-        }
-        m_geomMesh.create();
-        for (Vertex* v : m_geomMesh.getVerts()) {
-            emit sendVertex(v);
+                                                        tr("*.obj *.ply"));
+        if (filename.isEmpty()) {
+            return;
         }
+        // the worker can't share rand() with the GUI thread, so it gets its own generator
+        unsigned seed = (unsigned) rand();
+        startLoad(LoadResult::MESH, filename, [this, filename, seed](BackgroundTask &task) {
+            loadResult.ok = readMesh(filename, seed, task, loadResult.arrays, loadResult.links);
+        });
+    }
+}
 
-        for (Face* f : m_geomMesh.getFaces()) {
-            emit sendFace(f);
-        }
+// import a skinned mesh and its skeleton from a binary glTF file
+void MyGL::slot_importGLB(bool) {
+    QString filename = QFileDialog::getOpenFileName(0,
+                                                    QString("Import glTF"),
+                                                    QString("../../"),
+                                                    tr("*.glb"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    unsigned seed = (unsigned) rand();
+    startLoad(LoadResult::GLB, filename, [this, filename, seed](BackgroundTask &task) {
+        loadResult.ok = readGLB(filename, seed, task, loadResult.arrays, loadResult.links, loadResult.glbSkeleton);
+    });
+}
+
+// make the joints of an imported skeleton, posed in the file's rest pose and
+// bound with its bind matrices
+void MyGL::buildGLBSkeleton(const glbreader::SkeletonData &skeletonData) {
+    clearSkeleton();
+    for (const glbreader::JointData &data : skeletonData.joints) {
+        Joint* parent = data.parent >= 0 ? skeleton.at(data.parent) : nullptr;
+        Joint* jt = new Joint(data.name, parent, glm::vec4(data.translation, 1), data.rotation);
+        // the file's bind pose, not the pose it's loaded in
+        jt->setBindMatrix(data.inverseBind);
+        skeleton.push_back(jt);
+    }
+    publishSkeleton();
+}
+
+// replace the mesh with one built from flat arrays and their links
+void MyGL::replaceMesh(const MeshArrays &arrays, const connectivity::Links &links, const QString &source) {
+    // the lists own the old elements and delete them
+    emit sendClearMesh();
+    // a point cache is only good for the mesh it was written for
+    pointCache.close();
+    currVert = nullptr;
+    currHE = nullptr;
+    currFace = nullptr;
 
-        for (HalfEdge* he : m_geomMesh.getHEs()) {
-            emit sendHE(he);
+    m_geomMesh.destroy();
+    HalfEdge::resetID();
+    Vertex::resetID();
+    Face::resetID();
+
+    m_geomMesh.setArrays(arrays, links);
+    const connectivity::Report &report = links.report;
+    if (report.boundaryEdges > 0 || report.nonManifoldEdges > 0) {
+        qDebug() << source << "has" << report.boundaryEdges << "boundary and"
+                 << report.nonManifoldEdges << "non-manifold edges";
+    }
+}
+
+// upload the mesh and send its elements to the lists
+void MyGL::publishMesh() {
+    m_geomMesh.create();
+    for (Vertex* v : m_geomMesh.getVerts()) {
+        emit sendVertex(v);
+    }
+
+    for (Face* f : m_geomMesh.getFaces()) {
+        emit sendFace(f);
+    }
+
+    for (HalfEdge* he : m_geomMesh.getHEs()) {
+        emit sendHE(he);
+    }
+    update();
+}
+
+// the mesh as flat arrays for export, with area-weighted vertex normals; a
+// skinned mesh is posed like on screen, normals included
+void MyGL::getExportArrays(MeshArrays &arrays) const {
+    m_geomMesh.getArrays(arrays);
+    size_t vertCount = arrays.positions.size();
+    arrays.normals.resize(vertCount);
+    if (vertCount != 0) {
+        normals::vertexNormals(arrays.positionData(), vertCount, arrays.faceOffsets.data(),
+                               arrays.corners.data(), arrays.faceCount(), &arrays.normals[0][0]);
+    }
+    if (skinPressed && !skeleton.empty() && skinMatrices.size() == (size_t) skeleton.size()
+            && vertCount != 0) {
+        // skinned on the CPU the same way as the displayed shader does it
+        size_t n = skinMatrices.size();
+        std::vector<glm::vec4> posed(vertCount);
+        std::vector<glm::vec4> posedNormals(vertCount);
+        if (dualQuatSkinning) {
+            std::vector<glm::vec4> palette(BakedPalettes::DUAL_QUAT_TEXELS * n);
+            for (size_t i = 0; i < n; ++i) {
+                BakedPalettes::packSkinMatrix(skinMatrices[i], true, &palette[BakedPalettes::DUAL_QUAT_TEXELS * i]);
+            }
+            skinning::skinDualQuat(arrays.positionData(), &arrays.normals[0][0], arrays.skinWeights.data(),
+                                   vertCount, &palette[0][0], n, &posed[0][0], &posedNormals[0][0]);
+        } else {
+            std::vector<float> palette(12 * n);
+            skinning::packPalette(&skinMatrices[0][0][0], n, palette.data());
+            skinning::skinLinear(arrays.positionData(), &arrays.normals[0][0], arrays.skinWeights.data(),
+                                 vertCount, palette.data(), n, &posed[0][0], &posedNormals[0][0]);
         }
-        update();
+        arrays.positions.swap(posed);
+        arrays.normals.swap(posedNormals);
+    }
+}
+
+// write the mesh to an OBJ file
+void MyGL::slot_exportOBJ(bool) {
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Export OBJ"),
+                                                    QString("../../"),
+                                                    tr("*.obj"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    MeshArrays arrays;
+    getExportArrays(arrays);
+    if (!objwriter::write(filename, arrays, true)) {
+        qDebug() << "could not write" << filename;
+    }
+}
+
+// write the mesh to a binary PLY file
+void MyGL::slot_exportPLY(bool) {
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Export PLY"),
+                                                    QString("../../"),
+                                                    tr("*.ply"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    MeshArrays arrays;
+    getExportArrays(arrays);
+    if (!plywriter::write(filename, arrays, true, true)) {
+        qDebug() << "could not write" << filename;
+    }
+}
+
+// write the skeleton (in its current pose) to a binary rig file
+void MyGL::slot_exportRig(bool) {
+    if (skeleton.empty()) {
+        return;
+    }
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Export Rig"),
+                                                    QString("../../"),
+                                                    tr("*.rig"));
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    SkeletonArrays arrays;
+    getSkeletonArrays(arrays);
+    if (!rigfile::save(filename, arrays)) {
+        qDebug() << "could not write" << filename;
+    }
+}
+
+// the skeleton (in its current pose) as flat arrays
+void MyGL::getSkeletonArrays(SkeletonArrays &arrays) const {
+    arrays = SkeletonArrays();
+    arrays.nameOffsets.push_back(0);
+    // joint ids are their indices, and every loaded skeleton lists parents first
+    for (Joint* jt : skeleton) {
+        Joint* parent = jt->getParent();
+        arrays.parents.push_back(parent != nullptr ? parent->getID() : -1);
+        arrays.positions.push_back(jt->getLocalPosition());
+        arrays.rotations.push_back(jt->getQuaternion());
+        arrays.names += jt->getName().toUtf8().toStdString();
+        arrays.nameOffsets.push_back((uint32_t) arrays.names.size());
     }
 }
 
-// helper function which recursively sets children
-void MyGL::setChildren(QJsonArray children, Joint* parent) {
-    if (children.size() != 0) {
-        for (int i = 0; i < children.size(); ++i) {
-            QJsonObject curr = children.at(i).toObject();
+// save the scene to a session file
+void MyGL::slot_saveSession(bool) {
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Save Session"),
+                                                    QString("../../"),
+                                                    tr("*.session"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    sessionfile::Session session;
+    getSession(session);
+    if (!sessionfile::save(filename, session)) {
+        qDebug() << "could not write" << filename;
+    }
+}
 
-            QString name = curr["name"].toString();
-            QJsonArray currPos = curr["pos"].toArray();
-            QJsonArray currRot = curr["rot"].toArray();
-            QJsonArray currChildren = curr["children"].toArray();
+// open a session file in the background
+void MyGL::slot_openSession(bool) {
+    QString filename = QFileDialog::getOpenFileName(0,
+                                                    QString("Open Session"),
+                                                    QString("../../"),
+                                                    tr("*.session"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    startLoad(LoadResult::SESSION, filename, [this, filename](BackgroundTask &) {
+        loadResult.ok = sessionfile::load(filename, loadResult.session);
+    });
+}
 
-            // get root position based on world space
-            glm::vec4 pos = glm::vec4((float) currPos.at(0).toDouble(),
-                                      (float) currPos.at(1).toDouble(),
-                                      (float) currPos.at(2).toDouble(),
-                                      1);
+// the scene as a session
+void MyGL::getSession(sessionfile::Session &session) const {
+    // rest positions and weights, with links matching the corners as getArrays() orders them
+    MeshArrays &mesh = session.mesh;
+    m_geomMesh.getArrays(mesh);
+    connectivity::build(mesh.faceOffsets, mesh.corners, mesh.positions.size(), session.links);
 
-            // converts identity matrix to a rotation matrix using the rot values
-            glm::mat4 rot = glm::rotate(glm::mat4(),
-                                        glm::radians((float) currRot.at(0).toDouble()),
-                                        glm::vec3((float) currRot.at(1).toDouble(),
-                                                  (float) currRot.at(2).toDouble(),
-                                                  (float) currRot.at(3).toDouble()));
+    getSkeletonArrays(session.skeleton);
+    session.bindMatrices.clear();
+    for (Joint* jt : skeleton) {
+        session.bindMatrices.push_back(jt->getBindMatrix());
+    }
 
-            // convert to quatrenion
-            glm::quat quat = glm::toQuat(rot);
+    // selections as indices into the arrays
+    sessionfile::State &state = session.state;
+    state = sessionfile::State();
+    const std::vector<Vertex*> &verts = m_geomMesh.getVerts();
+    const std::vector<Face*> &faces = m_geomMesh.getFaces();
+    auto vert = std::find(verts.begin(), verts.end(), currVert);
+    if (currVert != nullptr && vert != verts.end()) {
+        state.vertex = (int32_t) (vert - verts.begin());
+    }
+    auto face = std::find(faces.begin(), faces.end(), currFace);
+    if (currFace != nullptr && face != faces.end()) {
+        state.face = (int32_t) (face - faces.begin());
+    }
+    if (currHE != nullptr) {
+        // the corner of a half-edge: its face's first, plus the steps around to it
+        auto heFace = std::find(faces.begin(), faces.end(), currHE->getFace());
+        if (heFace != faces.end()) {
+            uint32_t corner = mesh.faceOffsets[heFace - faces.begin()];
+            for (HalfEdge* e = (*heFace)->getHE(); e != currHE; e = e->getNextHE()) {
+                corner++;
+            }
+            state.halfEdge = (int32_t) corner;
+        }
+    }
+    if (currJoint != nullptr) {
+        state.joint = currJoint->getID();
+    }
+    state.skinned = skinPressed ? 1 : 0;
+}
 
-            Joint* currJt = new Joint(name, parent, pos, quat, this);
-            skeleton.push_back(currJt);
+// make the scene of a session
+void MyGL::restoreSession(const sessionfile::Session &session, const QString &source) {
+    replaceMesh(session.mesh, session.links, source);
 
-            setChildren(currChildren, currJt);
+    if (session.skeleton.jointCount() > 0) {
+        buildSkeleton(session.skeleton);
+        for (size_t j = 0; j < skeleton.size(); ++j) {
+            skeleton[j]->setBindMatrix(session.bindMatrices[j]);
         }
+    } else {
+        clearSkeleton();
+    }
+    skinPressed = session.state.skinned != 0 && !skeleton.empty();
+    if (skinPressed) {
+        setJointTrans();
+    }
+    publishMesh();
+
+    // the element arrays are in the order the session has them
+    const sessionfile::State &state = session.state;
+    if (state.vertex >= 0) {
+        slot_getCurrVertex(m_geomMesh.getVerts()[state.vertex]);
+    }
+    if (state.halfEdge >= 0) {
+        slot_getCurrHE(m_geomMesh.getHEs()[state.halfEdge]);
+    }
+    if (state.face >= 0) {
+        slot_getCurrFace(m_geomMesh.getFaces()[state.face]);
+    }
+    if (state.joint >= 0) {
+        slot_storeCurrJoint(skeleton[state.joint]);
     }
 }
 
@@ -775,66 +978,128 @@ void MyGL::slot_loadSkeleton(bool pressed) {
         QString filename = QFileDialog::getOpenFileName(0,
                                                         QString("Load Skeleton"),
                                                         QString("../../"),
-                                                        tr("*.json"));
-        QFile file(filename);
-
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            // destroy currently present skeleton
-            for (Joint* jt : skeleton) {
-                jt->destroy();
-            }
-            skeleton.clear();
-
-            QString documentStr = file.readAll();
-            file.close();
-
-            QJsonDocument doc = QJsonDocument::fromJson(documentStr.toUtf8());
-            QJsonObject docObj = doc.object();
-            QJsonValue rootVal = docObj.value(QString("root"));
-            QJsonObject root = rootVal.toObject();
+                                                        tr("*.json *.rig"));
+        if (filename.isEmpty()) {
+            return;
+        }
+        startLoad(LoadResult::SKELETON, filename, [this, filename](BackgroundTask &) {
+            loadResult.ok = skeletonreader::read(filename, loadResult.skeleton);
+        });
+    }
+}
 
-            // parse first node
-            QString rootName = root["name"].toString();
-            QJsonArray rootPos = root["pos"].toArray();
-            QJsonArray rootRot = root["rot"].toArray();
-            QJsonArray children = root["children"].toArray();
+// make the joints of a skeleton from its arrays
+void MyGL::buildSkeleton(const SkeletonArrays &arrays) {
+    clearSkeleton();
+    for (size_t j = 0; j < arrays.jointCount(); ++j) {
+        int32_t parent = arrays.parents[j];
+        Joint* jt = new Joint(arrays.name(j), parent >= 0 ? skeleton.at(parent) : nullptr,
+                              arrays.positions[j], arrays.rotations[j]);
+        skeleton.push_back(jt);
+    }
+    publishSkeleton();
+}
 
-            // get root position based on world space
-            glm::vec4 pos = glm::vec4((float) rootPos.at(0).toDouble(),
-                                      (float) rootPos.at(1).toDouble(),
-                                      (float) rootPos.at(2).toDouble(),
-                                      1);
+// read a mesh or skeleton on the loading thread, showing its progress
+void MyGL::startLoad(LoadResult::Kind kind, const QString &filename,
+                     std::function<void(BackgroundTask&)> work) {
+    if (loadTask.isRunning()) {
+        qDebug() << "still loading" << loadResult.source;
+        return;
+    }
+    loadResult = LoadResult();
+    loadResult.kind = kind;
+    loadResult.source = filename;
+
+    if (loadProgress == nullptr) {
+        loadProgress = new QProgressDialog(this);
+        loadProgress->setWindowModality(Qt::NonModal);
+        loadProgress->setRange(0, 100);
+        loadProgress->setMinimumDuration(500);
+        connect(loadProgress, SIGNAL(canceled()), this, SLOT(slot_cancelLoad()));
+    }
+    loadProgress->setLabelText(QString("Loading ") + QFileInfo(filename).fileName());
+    loadProgress->reset();
+    loadProgress->setValue(0);
 
-            // make quaternion
-            glm::quat quat = glm::angleAxis((float) rootRot.at(0).toDouble(),
-                                            glm::vec3((float) rootRot.at(1).toDouble(),
-                                                      (float) rootRot.at(2).toDouble(),
-                                                      (float) rootRot.at(3).toDouble()));
+    loadTask.start(work);
+    loadTimer.start();
+}
 
-            Joint* rootJt = new Joint(rootName, nullptr, pos, quat, this);
+// take over a finished load, or show how far it has come
+void MyGL::slot_pollLoad() {
+    if (!loadTask.isDone()) {
+        loadProgress->setValue(loadTask.progress());
+        return;
+    }
+    loadTimer.stop();
+    loadTask.finish();
+    loadProgress->reset();
+    loadProgress->hide();
+
+    if (loadTask.isCancelled()) {
+        // nothing of a cancelled load is kept
+    } else if (!loadResult.ok) {
+        qDebug() << "could not load" << loadResult.source;
+    } else if (loadResult.kind == LoadResult::MESH) {
+        replaceMesh(loadResult.arrays, loadResult.links, loadResult.source);
+        publishMesh();
+    } else if (loadResult.kind == LoadResult::GLB) {
+        const glbreader::SkeletonData &skeletonData = loadResult.glbSkeleton;
+        if (!skeletonData.joints.empty()) {
+            buildGLBSkeleton(skeletonData);
+        }
+        replaceMesh(loadResult.arrays, loadResult.links, loadResult.source);
 
-            skeleton.push_back(rootJt);
+        // the weights came with the file, so the mesh is skinned right away
+        skinPressed = !skeletonData.joints.empty();
+        if (skinPressed) {
+            bakedPalettes.clear();
+            setJointTrans();
+        }
+        publishMesh();
+    } else if (loadResult.kind == LoadResult::SESSION) {
+        restoreSession(loadResult.session, loadResult.source);
+    } else {
+        buildSkeleton(loadResult.skeleton);
+        update();
+    }
+    loadResult = LoadResult();
+}
 
-            // helper function:
-            // goes through children and adds created joints to the vector of Joints
-            setChildren(children, rootJt);
+// stop waiting for the current load; the loading thread drops it at its next check
+void MyGL::slot_cancelLoad() {
+    loadTask.cancel();
+}
 
-        }
+// forget the currently present skeleton (and its animation)
+void MyGL::clearSkeleton() {
+    skeleton.clear();
+    // the gizmo would otherwise keep drawing (and reading) the old joints
+    skeletonGizmo.setSkeleton(skeleton);
+    currJoint = nullptr;
+    animTimer.stop();
+    animClip.reset(0);
+    animSampler.setClip(nullptr);
+    animKeyCount = 0;
+    bakedPalettes.clear();
+    ikHandles.clear();
+    Joint::resetID();
+}
 
-        sendRoot(skeleton.at(0));
+// link a freshly loaded skeleton's children and show it
+void MyGL::publishSkeleton() {
+    sendRoot(skeleton.at(0));
 
-        // set children
-        for (Joint* jt : skeleton) {
-            Joint* parent = jt->getParent();
-            if (parent != nullptr) {
-                parent->addChild(jt);
+    // set children
+    for (Joint* jt : skeleton) {
+        Joint* parent = jt->getParent();
+        if (parent != nullptr) {
+            parent->addChild(jt);
 
-            }
-            jt->create();
         }
-
-        update();
     }
+    skeletonGizmo.setSkeleton(skeleton);
 }
 
 // store currently selected joint
@@ -850,49 +1115,56 @@ void MyGL::slot_storeCurrJoint(Joint* joint) {
 
     // send current position to gui
     sendJointPos(currJoint->getWorldPosition());
-    for (Joint* jt : skeleton) {
-        jt->destroy();
-        jt->create();
-    }
+    skeletonGizmo.updatePose();
 
     update();
 }
 
 // set influence of the joints on each vertex in the mesh
 void MyGL::slot_setVertexInfluence(bool pressed) {
-    if (pressed) {
-        for (Vertex* v : m_geomMesh.getVerts()) {
-            Joint* jt1;
-            float minDist1 = HUGE_VALF;
-
-            // compute first closest joint
-            for (Joint* jt : skeleton) {
-                glm::vec4 vPos = v->getCoord();
-                glm::vec4 jtPos = jt->getWorldPosition();
-                float currDist = glm::distance(vPos, jtPos);
-                if (currDist < minDist1) {
-                    jt1 = jt;
-                    minDist1 = currDist;
-                }
+    if (pressed && !skeleton.empty()) {
+        // bring every cached joint transformation up to date once, up front
+        Joint::updateTransforms(skeleton);
+
+        // bones: a segment from each joint to each of its children, owned by the joint;
+        // joints without children are single points
+        std::vector<skinbinding::Bone> bones;
+        bones.reserve(skeleton.size());
+        for (int i = 0; i < skeleton.size(); ++i) {
+            Joint* jt = skeleton.at(i);
+            glm::vec4 jtPos = jt->getWorldPosition();
+            if (jt->getChildren().empty()) {
+                bones.push_back({{jtPos[0], jtPos[1], jtPos[2]}, {jtPos[0], jtPos[1], jtPos[2]}, i});
             }
-
-            Joint* jt2;
-            float minDist2 = HUGE_VALF;
-            // compute second closest joint
-            for (Joint* jt : skeleton) {
-                if (jt != jt1) {
-                    glm::vec4 vPos = v->getCoord();
-                    glm::vec4 jtPos = jt->getWorldPosition();
-                    float currDist = glm::distance(vPos, jtPos);
-                    if (currDist < minDist2) {
-                        jt2 = jt;
-                        minDist2 = currDist;
-                    }
-                }
+            Joint* parent = jt->getParent();
+            if (parent != nullptr) {
+                glm::vec4 parentPos = parent->getWorldPosition();
+                bones.push_back({{parentPos[0], parentPos[1], parentPos[2]},
+                                 {jtPos[0], jtPos[1], jtPos[2]},
+                                 parent->getID()});
             }
+        }
+        skinbinding::BoneBVH bvh;
+        bvh.build(bones);
 
-            // set vertex influence
-            v->setInfluence(jt1, minDist1, jt2, minDist2);
+        // nearest joints per vertex, computed in parallel over flat arrays
+        const int k = SkinWeights::MAX_INFLUENCES;
+        std::vector<Vertex*> verts = m_geomMesh.getVerts();
+        std::vector<glm::vec4> positions(verts.size());
+        for (size_t v = 0; v < verts.size(); ++v) {
+            positions[v] = verts[v]->getCoord();
+        }
+        std::vector<int> joints(k * verts.size());
+        std::vector<float> weights(k * verts.size());
+        if (!verts.empty()) {
+            skinbinding::bind(&positions[0][0], verts.size(), bvh, k, joints.data(), weights.data());
+        }
+
+        // set vertex influence (pruned, normalized and packed)
+        for (size_t v = 0; v < verts.size(); ++v) {
+            SkinWeights skin;
+            skin.set(&joints[k * v], &weights[k * v], k);
+            verts[v]->setSkinWeights(skin);
         }
         skinPressed = true;
         setBindArray();
@@ -907,47 +1179,40 @@ void MyGL::slot_setVertexInfluence(bool pressed) {
 
 void MyGL::slot_changeJtX(double x) {
     if (currJoint != nullptr) {
-        glm::vec4 coordW = currJoint->getWorldPosition();
-        float diff = x - coordW[0];
-        glm::vec4 coordL = currJoint->getLocalPosition();
-        currJoint->setPosition(glm::vec4(coordL[0] + diff, coordL[1], coordL[2], 1));
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
-        setJointTrans();
-        update();
+        moveCurrJoint(0, x);
     }
 }
 
 void MyGL::slot_changeJtY(double y) {
     if (currJoint != nullptr) {
-        glm::vec4 coordW = currJoint->getWorldPosition();
-        float diff = y - coordW[1];
-        glm::vec4 coordL = currJoint->getLocalPosition();
-        currJoint->setPosition(glm::vec4(coordL[0], coordL[1] + diff, coordL[2], 1));
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
-        setJointTrans();
-        update();
+        moveCurrJoint(1, y);
     }
 }
 
 void MyGL::slot_changeJtZ(double z) {
     if (currJoint != nullptr) {
-        glm::vec4 coordW = currJoint->getWorldPosition();
-        float diff = z - coordW[2];
+        moveCurrJoint(2, z);
+    }
+}
+
+// move the current joint (or the target of its IK handle) along one world axis
+void MyGL::moveCurrJoint(int axis, float coord) {
+    IKHandle* handle = findIKHandle(currJoint);
+    if (handle != nullptr) {
+        // the chain bends to follow the target instead of the joint moving
+        glm::vec3 target = handle->getTarget();
+        target[axis] = coord;
+        handle->setTarget(target);
+    } else {
         glm::vec4 coordL = currJoint->getLocalPosition();
-        currJoint->setPosition(glm::vec4(coordL[0], coordL[1], coordL[2] + diff, 1));
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
-        setJointTrans();
-        update();
+        coordL[axis] += coord - currJoint->getWorldPosition()[axis];
+        currJoint->setPosition(coordL);
     }
+    // moving a joint can also move the chains of other handles
+    solveIK();
+    skeletonGizmo.updatePose();
+    setJointTrans();
+    update();
 }
 
 void MyGL::slot_changeJtXRot(bool pressed) {
@@ -955,10 +1220,7 @@ void MyGL::slot_changeJtXRot(bool pressed) {
         glm::quat quat = currJoint->getQuaternion();
         quat = glm::angleAxis(glm::radians(5.f), glm::vec3(1,0,0)) * quat;
         currJoint->setQuat(quat);
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
+        skeletonGizmo.updatePose();
         setJointTrans();
         update();
     }
@@ -969,10 +1231,7 @@ void MyGL::slot_changeJtYRot(bool pressed) {
         glm::quat quat = currJoint->getQuaternion();
         quat = glm::angleAxis(glm::radians(5.f), glm::vec3(0,1,0)) * quat;
         currJoint->setQuat(quat);
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
+        skeletonGizmo.updatePose();
         setJointTrans();
         update();
     }
@@ -983,10 +1242,7 @@ void MyGL::slot_changeJtZRot(bool pressed) {
         glm::quat quat = currJoint->getQuaternion();
         quat = glm::angleAxis(glm::radians(5.f), glm::vec3(0,0,1)) * quat;
         currJoint->setQuat(quat);
-        for (Joint* jt : skeleton) {
-            jt->destroy();
-            jt->create();
-        }
+        skeletonGizmo.updatePose();
         setJointTrans();
         update();
     }
@@ -994,43 +1250,363 @@ void MyGL::slot_changeJtZRot(bool pressed) {
 
 // function to set bind matrix array
 void MyGL::setBindArray() {
-    prog_skeleton.useMe();
+    // the bind matrices are folded into the skin matrices by setJointTrans()
+    // (and into any baked palettes, which are now out of date)
+    bakedPalettes.clear();
+    Joint::updateTransforms(skeleton);
+    for (Joint* jt : skeleton) {
+        jt->setBindMatrix();
+    }
+}
 
-    glm::mat4 bindMatrices[100];
+// function to set joint transformation array
+void MyGL::setJointTrans() {
+    skinMatrices.resize(skeleton.size());
+    int texels = dualQuatSkinning ? BakedPalettes::DUAL_QUAT_TEXELS : BakedPalettes::LINEAR_TEXELS;
+    jointPalette.resize(texels * skeleton.size());
+    Joint::updateTransforms(skeleton);
 
-    // set bind array values
+    // Trans * Bind is the same for every vertex of a joint, so it is computed
+    // once here and the shader only does one matrix-vector product per influence
     for (int i = 0; i < skeleton.size(); i++) {
         Joint* jt = skeleton.at(i);
-        jt->setBindMatrix();
-        bindMatrices[i] = jt->getBindMatrix();
-    }
+        glm::mat4 skin = jt->getOverallTransformation() * jt->getBindMatrix();
+        skinMatrices[i] = skin;
 
-    if (prog_skeleton.unifBindMatrices != -1) {
-        this->glUniformMatrix4fv(prog_skeleton.unifBindMatrices,
-                                 skeleton.size(),
-                                 GL_FALSE,
-                                 &(bindMatrices[0][0][0]));
+        BakedPalettes::packSkinMatrix(skin, dualQuatSkinning, &jointPalette[texels * i]);
     }
+    paletteDirty = true;
+}
 
+// switch between linear blend and dual quaternion skinning
+void MyGL::slot_setDualQuatSkinning(bool dualQuat) {
+    dualQuatSkinning = dualQuat;
+    if (skinPressed) {
+        // the palette layout depends on the skinning mode
+        setJointTrans();
+    }
+    update();
 }
 
-// function to set joint transformation array
-void MyGL::setJointTrans() {
-    prog_skeleton.useMe();
-    glm::mat4 jointTrans[100];
+// record the current pose as the next keyframe
+void MyGL::slot_recordKeyframe(bool) {
+    if (skeleton.empty()) {
+        return;
+    }
+    if (animClip.getJointCount() != skeleton.size()) {
+        animClip.reset(skeleton.size());
+        animKeyCount = 0;
+    }
 
-    // set bind array values
-    for (int i = 0; i < skeleton.size(); i++) {
+    // the bake no longer matches the clip
+    bakedPalettes.clear();
+
+    float time = (float) animKeyCount++;
+    for (int i = 0; i < skeleton.size(); ++i) {
         Joint* jt = skeleton.at(i);
-        jointTrans[i] = jt->getOverallTransformation();
+        animClip.addKey(i, time, glm::vec3(jt->getLocalPosition()), jt->getQuaternion());
+    }
+    animClip.compile();
+    animSampler.setClip(&animClip);
+}
+
+// start / stop playing the recorded keyframes
+void MyGL::slot_playAnimation(bool play) {
+    bool canPlayBake = skinPressed && bakedPalettes.matches(skeleton.size(), dualQuatSkinning);
+    if (play && (animKeyCount > 1 || canPlayBake || showingPointCache())) {
+        bakedFrame = 0;
+        animClock.start();
+        animTimer.start();
+    } else {
+        animTimer.stop();
+        // back to the pose the joints are in
+        paletteDirty = true;
+        update();
+    }
+}
+
+// forget all recorded keyframes
+void MyGL::slot_clearAnimation(bool) {
+    animTimer.stop();
+    bakedPalettes.clear();
+    closePointCache();
+    paletteDirty = true;
+    animClip.reset(skeleton.size());
+    animSampler.setClip(&animClip);
+    animKeyCount = 0;
+}
+
+// advance the animation (driven by animTimer)
+void MyGL::timerUpdate() {
+    if (showingPointCache()) {
+        // no skeleton, no skinning: the frame's positions come off the disk
+        showPointCacheFrame(pointCache.frameAt(animClock.elapsed() / 1000.f));
+        return;
     }
 
-    if (prog_skeleton.unifJointTrans != -1) {
-        this->glUniformMatrix4fv(prog_skeleton.unifJointTrans,
-                                 skeleton.size(),
-                                 GL_FALSE,
-                                 &(jointTrans[0][0][0]));
+    if (playingBaked()) {
+        // no sampling, no hierarchy: just pick the frame
+        bakedFrame = bakedPalettes.frameAt(animClock.elapsed() / 1000.f);
+        update();
+        return;
+    }
+
+    float duration = animClip.getDuration();
+    if (duration <= 0) {
+        return;
+    }
+    float t = std::fmod(animClock.elapsed() / 1000.f, duration);
+    applyAnimation(t);
+    update();
+}
+
+// pose the skeleton as the clip is at time t
+void MyGL::applyAnimation(float t) {
+    size_t n = skeleton.size();
+    if (animClip.getJointCount() != n) {
+        return;
+    }
+
+    // joints without keys keep their current pose
+    animTranslations.resize(n);
+    animRotations.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        animTranslations[i] = glm::vec3(skeleton[i]->getLocalPosition());
+        animRotations[i] = skeleton[i]->getQuaternion();
+    }
+
+    animSampler.sample(t, animTranslations.data(), animRotations.data());
+
+    for (size_t i = 0; i < n; ++i) {
+        skeleton[i]->setPosition(glm::vec4(animTranslations[i], 1));
+        skeleton[i]->setQuat(animRotations[i]);
+    }
+
+    // handles pull their chains away from the keyed pose
+    solveIK();
+
+    // one sweep over the hierarchy, then the palette and gizmos
+    if (skinPressed) {
+        setJointTrans();
+    }
+    skeletonGizmo.updatePose();
+}
+
+// is playback drawing baked palettes instead of evaluating the skeleton?
+bool MyGL::playingBaked() const {
+    return animTimer.isActive() && skinPressed && !showingPointCache()
+        && bakedPalettes.matches(skeleton.size(), dualQuatSkinning);
+}
+
+// is the mesh drawn with positions from a point cache?
+bool MyGL::showingPointCache() const {
+    return pointCache.isOpen();
+}
+
+// put a frame of the point cache into the mesh's position buffers
+void MyGL::showPointCacheFrame(int frame) {
+    if (frame == pointCacheFrame) {
+        return;
+    }
+    if (!pointCache.readFrame(frame, pointCachePositions.data())
+            || !m_geomMesh.uploadPositions(pointCachePositions.data(), pointCachePositions.size())) {
+        // the mesh was edited into a different vertex count
+        closePointCache();
+        return;
+    }
+    pointCacheFrame = frame;
+    update();
+}
+
+// stop showing the point cache and draw the mesh as it is again
+void MyGL::closePointCache() {
+    if (!showingPointCache()) {
+        return;
+    }
+    pointCache.close();
+    pointCachePositions.clear();
+    pointCachePositions.shrink_to_fit();
+    pointCacheFrame = -1;
+    m_geomMesh.destroy();
+    m_geomMesh.create();
+    update();
+}
+
+// bake the palettes of the recorded clip for playback
+void MyGL::slot_bakePalettes(bool) {
+    if (!skinPressed || animKeyCount < 2 || animClip.getJointCount() != skeleton.size()) {
+        return;
+    }
+    // 30 samples per second, in the current skinning mode, with the IK handles
+    // solved every frame like in live playback
+    bakedPalettes.bake(animClip, skeleton, 30.f, dualQuatSkinning, &ikHandles, ikSolver);
+    bakedDirty = true;
+}
+
+// write the baked palettes to a cache file
+void MyGL::slot_saveBakedPalettes(bool) {
+    if (bakedPalettes.isEmpty()) {
+        return;
     }
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Save Baked Palettes"),
+                                                    QString("../../"),
+                                                    tr("*.mmpb"));
+    if (!filename.isEmpty() && !bakedPalettes.save(filename)) {
+        qDebug() << "could not write" << filename;
+    }
+}
+
+// memory-map baked palettes from a cache file
+void MyGL::slot_openBakedPalettes(bool) {
+    QString filename = QFileDialog::getOpenFileName(0,
+                                                    QString("Open Baked Palettes"),
+                                                    QString("../../"),
+                                                    tr("*.mmpb"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    animTimer.stop();
+    if (!bakedPalettes.map(filename)) {
+        qDebug() << "not a palette cache:" << filename;
+        return;
+    }
+    if (!bakedPalettes.matches(skeleton.size(), dualQuatSkinning)) {
+        qDebug() << "the cached palettes were baked for a different rig or skinning mode";
+    }
+    bakedDirty = true;
+}
+
+// pose the mesh at every frame of the recorded clip and write a point cache
+void MyGL::slot_bakePointCache(bool) {
+    if (!skinPressed || animKeyCount < 2 || animClip.getJointCount() != skeleton.size()) {
+        return;
+    }
+    QString filename = QFileDialog::getSaveFileName(0,
+                                                    QString("Bake Point Cache"),
+                                                    QString("../../"),
+                                                    tr("*.pcache"));
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    // palettes of the whole clip, 30 samples per second, in the displayed skinning
+    // mode and with the IK handles solved like in live playback; each frame is
+    // then skinned on the CPU, rest vertex normals included, and streamed to
+    // the file before the next one
+    BakedPalettes palettes;
+    palettes.bake(animClip, skeleton, 30.f, dualQuatSkinning, &ikHandles, ikSolver);
+    MeshArrays arrays;
+    m_geomMesh.getArrays(arrays);
+    size_t n = arrays.positions.size();
+    std::vector<glm::vec4> posed(n);
+    std::vector<glm::vec4> posedNormals(n);
+    arrays.normals.resize(n);
+    if (n != 0) {
+        normals::vertexNormals(arrays.positionData(), n, arrays.faceOffsets.data(),
+                               arrays.corners.data(), arrays.faceCount(), &arrays.normals[0][0]);
+    }
+
+    PointCacheWriter writer;
+    if (palettes.isEmpty() || !writer.open(filename, n, palettes.getRate(),
+                                           pointcache::QUANTIZED | pointcache::DELTA | pointcache::NORMALS)) {
+        qDebug() << "could not write" << filename;
+        return;
+    }
+    bool ok = true;
+    for (int f = 0; ok && f < palettes.getFrameCount(); ++f) {
+        const glm::vec4* palette = palettes.getData() + f * palettes.getFrameTexels();
+        if (dualQuatSkinning) {
+            skinning::skinDualQuat(arrays.positionData(), &arrays.normals[0][0], arrays.skinWeights.data(), n,
+                                   &palette[0][0], skeleton.size(), &posed[0][0], &posedNormals[0][0]);
+        } else {
+            skinning::skinLinear(arrays.positionData(), &arrays.normals[0][0], arrays.skinWeights.data(), n,
+                                 &palette[0][0], skeleton.size(), &posed[0][0], &posedNormals[0][0]);
+        }
+        ok = writer.append(posed.data(), posedNormals.data());
+    }
+    if (!writer.close() || !ok) {
+        qDebug() << "could not write" << filename;
+    }
+}
 
+// map a point cache file and show it instead of the mesh's own positions
+void MyGL::slot_openPointCache(bool) {
+    QString filename = QFileDialog::getOpenFileName(0,
+                                                    QString("Open Point Cache"),
+                                                    QString("../../"),
+                                                    tr("*.pcache"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    animTimer.stop();
+    closePointCache();
+    if (!pointCache.open(filename)) {
+        qDebug() << "not a point cache:" << filename;
+        return;
+    }
+    size_t n = m_geomMesh.getVerts().size();
+    if (pointCache.getVertexCount() != n) {
+        qDebug() << "the point cache was written for a mesh of" << pointCache.getVertexCount()
+                 << "vertices, not" << n;
+        pointCache.close();
+        return;
+    }
+    // the first frame shows until playback starts
+    pointCachePositions.resize(n);
+    pointCacheFrame = -1;
+    showPointCacheFrame(0);
+}
+
+// the IK handle whose effector is the given joint, if any
+IKHandle* MyGL::findIKHandle(Joint* effector) {
+    for (IKHandle &handle : ikHandles) {
+        if (handle.getEffector() == effector) {
+            return &handle;
+        }
+    }
+    return nullptr;
+}
+
+// solve every IK handle
+void MyGL::solveIK() {
+    // each handle reads the world transformations left by the previous ones,
+    // so chains sharing joints still end up consistent
+    for (IKHandle &handle : ikHandles) {
+        handle.solve(ikSolver);
+    }
 }
 
+// add an IK handle with the current joint as its end effector
+void MyGL::slot_addIKHandle(bool) {
+    if (currJoint == nullptr || currJoint->getParent() == nullptr
+            || findIKHandle(currJoint) != nullptr) {
+        return;
+    }
+    // the effector bends its parent and grandparent, like an arm or a leg
+    ikHandles.push_back(IKHandle(currJoint, 2));
+    // the bake was solved without it
+    bakedPalettes.clear();
+}
+
+// remove all IK handles
+void MyGL::slot_clearIKHandles(bool) {
+    ikHandles.clear();
+    // the bake was solved with them
+    bakedPalettes.clear();
+}
+
+// solve IK handles with FABRIK rather than CCD
+void MyGL::slot_setFABRIK(bool fabrik) {
+    ikSolver = fabrik ? ik::FABRIK : ik::CCD;
+    // the bake and the current pose came from the other solver
+    bakedPalettes.clear();
+    if (!ikHandles.empty()) {
+        solveIK();
+        skeletonGizmo.updatePose();
+        if (skinPressed) {
+            setJointTrans();
+        }
+        update();
+    }
+}
@@ -9,11 +9,26 @@
 #include <scene/mesh.h>
 #include <scene/vertex.h>
 #include <scene/joint.h>
+#include <scene/skeletonarrays.h>
+#include <scene/sessionfile.h>
+#include <scene/glbreader.h>
+#include <scene/skeletongizmo.h>
+#include <scene/animation.h>
+#include <scene/palettebake.h>
+#include <scene/pointcache.h>
+#include <scene/ik.h>
+#include <texturebuffer.h>
+#include <backgroundtask.h>
 #include <scene/drawvertex.h>
 #include "camera.h"
+#include "frustum.h"
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QProgressDialog>
+#include <functional>
 
 
 class MyGL
@@ -28,6 +43,8 @@ private:
     ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
     ShaderProgram prog_skeleton; // A shader program variable for manipulating skeleton
+    ShaderProgram prog_skeletonDQ; // The same, with dual quaternion instead of linear blend skinning
+    ShaderProgram prog_gizmo; // A shader program that draws one joint gizmo per instance
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
@@ -42,9 +59,67 @@ private:
     drawHE heSelect;
     drawFace faceSelect;
     std::vector<Joint*> skeleton;
+    SkeletonGizmo skeletonGizmo; // draws every joint of the skeleton in one call
+
+    // per-joint skin matrices (overall transformation * bind matrix), indexed by joint id
+    std::vector<glm::mat4> skinMatrices;
+
+    // the skin transformations as read by the skinning shader: the top three rows
+    // of each (affine) matrix, one texel per row, or with dual quaternion skinning
+    // the real and dual part of each unit dual quaternion
+    std::vector<glm::vec4> jointPalette;
+    TextureBuffer jointPaletteBuf;
+    bool paletteDirty; // does jointPaletteBuf need to be uploaded before the next draw?
     Joint* currJoint;
 
     bool skinPressed;
+    bool dualQuatSkinning; // blend dual quaternions rather than matrices
+
+    // animation: keys are recorded one second apart and played back in a loop
+    AnimationClip animClip;
+    AnimationSampler animSampler;
+    QTimer animTimer;
+    QElapsedTimer animClock;
+    int animKeyCount;
+    std::vector<glm::vec3> animTranslations; // sampled local pose, reused every frame
+    std::vector<glm::quat> animRotations;
+
+    // baked playback: every frame's palette in one buffer texture, indexed per frame
+    BakedPalettes bakedPalettes;
+    TextureBuffer bakedPaletteBuf;
+    bool bakedDirty;        // does bakedPaletteBuf need the frames uploaded?
+    int bakedFrame;         // frame shown while playing the bake
+    int maxBufferTexels;    // GL_MAX_TEXTURE_BUFFER_SIZE
+
+    // point cache playback: each frame's positions are read from the mapped
+    // file straight into the mesh's position buffers, no skinning involved
+    PointCacheReader pointCache;
+    std::vector<glm::vec4> pointCachePositions;
+    int pointCacheFrame;    // frame in the position buffers, -1 for none yet
+
+    // IK handles, solved whenever a target moves and every animation frame
+    std::vector<IKHandle> ikHandles;
+    ik::Solver ikSolver;
+
+    // background loading: the loading thread fills loadResult, and the GUI
+    // thread swaps it into the scene once loadTimer finds the task done
+    struct LoadResult {
+        enum Kind { MESH, SKELETON, SESSION, GLB };
+        Kind kind;
+        QString source;
+        bool ok;
+        MeshArrays arrays;
+        connectivity::Links links;
+        SkeletonArrays skeleton;
+        sessionfile::Session session;
+        glbreader::SkeletonData glbSkeleton;
+
+        LoadResult() : kind(MESH), ok(false) {}
+    };
+    LoadResult loadResult;
+    BackgroundTask loadTask;
+    QTimer loadTimer;
+    QProgressDialog* loadProgress;
 
 public:
     explicit MyGL(QWidget *parent = 0);
@@ -56,21 +131,75 @@ public:
     void resizeGL(int w, int h);
     void paintGL();
 
+    // frustum test of a mesh chunk, in its posed position when the mesh is skinned
+    // (skinned chunks always pass with dual quaternion skinning)
+    bool chunkVisible(const Frustum &frustum, const MeshChunk &chunk) const;
+
     void setBindArray();
     void setJointTrans();
 
-    // helper function for loading skeleton: sets children of a given node
-    void setChildren(QJsonArray children, Joint* parent);
+    // pose the skeleton as the clip is at time t
+    void applyAnimation(float t);
+
+    // is playback drawing baked palettes instead of evaluating the skeleton?
+    bool playingBaked() const;
+
+    // is the mesh drawn with positions from a point cache?
+    bool showingPointCache() const;
+    // put a frame of the point cache into the mesh's position buffers
+    void showPointCacheFrame(int frame);
+    // stop showing the point cache and draw the mesh as it is again
+    void closePointCache();
+
+    // the IK handle whose effector is the given joint, if any
+    IKHandle* findIKHandle(Joint* effector);
+    // solve every IK handle
+    void solveIK();
+    // move the current joint (or the target of its IK handle) along one world axis
+    void moveCurrJoint(int axis, float coord);
+
+    // the mesh as flat arrays for export, with vertex normals, posed like on
+    // screen if it's skinned
+    void getExportArrays(MeshArrays &arrays) const;
+
+    // replace the mesh with one built from flat arrays and their links
+    void replaceMesh(const MeshArrays &arrays, const connectivity::Links &links, const QString &source);
+    // upload the mesh and send its elements to the lists
+    void publishMesh();
+
+    // read a mesh or skeleton on the loading thread, showing its progress
+    void startLoad(LoadResult::Kind kind, const QString &filename,
+                   std::function<void(BackgroundTask&)> work);
+    // make the joints of a skeleton from its arrays
+    void buildSkeleton(const SkeletonArrays &arrays);
+    // make the joints of a skeleton imported from a .glb file
+    void buildGLBSkeleton(const glbreader::SkeletonData &skeletonData);
+    // the skeleton (in its current pose) as flat arrays
+    void getSkeletonArrays(SkeletonArrays &arrays) const;
+
+    // the scene as a session, and back
+    void getSession(sessionfile::Session &session) const;
+    void restoreSession(const sessionfile::Session &session, const QString &source);
+
+    // forget the currently present skeleton (and its animation)
+    void clearSkeleton();
+    // link a freshly loaded skeleton's children and show it
+    void publishSkeleton();
 
 protected:
     void keyPressEvent(QKeyEvent *e);
 
+    // advance the animation (driven by animTimer)
+    virtual void timerUpdate() override;
+
 signals:
     void sendFace(Face* face);
     void sendHE(HalfEdge* he);
     void sendVertex(Vertex* vert);
     void sendRoot(Joint* jt);
     void sendJointPos(glm::vec4 pos);
+    // the mesh is about to be replaced; its elements are to be dropped from the lists
+    void sendClearMesh();
 
 
 public slots:
@@ -92,8 +221,23 @@ public slots:
     void slot_extrude(bool);
 
     void slot_loadOBJ(bool);
+    // import a skinned mesh and its skeleton from a binary glTF file
+    void slot_importGLB(bool);
+    // write the mesh (posed, if skinned) to an OBJ or binary PLY file
+    void slot_exportOBJ(bool);
+    void slot_exportPLY(bool);
+    // write the skeleton (in its current pose) to a binary rig file
+    void slot_exportRig(bool);
+
+    // save the scene to a session file, or open one in the background
+    void slot_saveSession(bool);
+    void slot_openSession(bool);
 
     void slot_loadSkeleton(bool);
+    // take over a finished load, or show how far it has come
+    void slot_pollLoad();
+    // stop waiting for the current load
+    void slot_cancelLoad();
     void slot_storeCurrJoint(Joint*);
 
     // set joint influence of all vertices in mesh
@@ -107,6 +251,36 @@ public slots:
     void slot_changeJtYRot(bool);
     void slot_changeJtZRot(bool);
 
+    // switch between linear blend and dual quaternion skinning
+    void slot_setDualQuatSkinning(bool);
+
+    // record the current pose as the next keyframe
+    void slot_recordKeyframe(bool);
+    // start / stop playing the recorded keyframes
+    void slot_playAnimation(bool);
+    // forget all recorded keyframes
+    void slot_clearAnimation(bool);
+
+    // bake the palettes of the recorded clip for playback
+    void slot_bakePalettes(bool);
+    // write the baked palettes to a cache file
+    void slot_saveBakedPalettes(bool);
+    // memory-map baked palettes from a cache file
+    void slot_openBakedPalettes(bool);
+
+    // pose the mesh at every frame of the recorded clip on the CPU and write
+    // the positions to a point cache file
+    void slot_bakePointCache(bool);
+    // map a point cache file and show it instead of the mesh's own positions
+    void slot_openPointCache(bool);
+
+    // add an IK handle with the current joint as its end effector
+    void slot_addIKHandle(bool);
+    // remove all IK handles
+    void slot_clearIKHandles(bool);
+    // solve IK handles with FABRIK rather than CCD
+    void slot_setFABRIK(bool);
+
 };
 
 
@@ -0,0 +1,51 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// Minimal data-parallel loop for the bulk mesh and skinning kernels.
+///
+/// forRange() splits [0, count) into contiguous blocks of at least grain items,
+/// runs body(begin, end) on each block across the hardware threads, and returns
+/// when every block is done. Small ranges run inline on the calling thread.
+
+namespace parallel {
+    // number of worker threads forRange() uses at most
+    inline unsigned threadCount() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+    template<typename Body>
+    void forRange(size_t count, size_t grain, Body body) {
+        if (count == 0) {
+            return;
+        }
+        size_t blocks = std::min<size_t>(threadCount(), (count + grain - 1) / std::max<size_t>(grain, 1));
+        if (blocks <= 1) {
+            body((size_t) 0, count);
+            return;
+        }
+
+        size_t step = (count + blocks - 1) / blocks;
+        std::vector<std::thread> workers;
+        workers.reserve(blocks - 1);
+        for (size_t b = 1; b < blocks; ++b) {
+            size_t begin = b * step;
+            size_t end = std::min(count, begin + step);
+            if (begin < end) {
+                workers.emplace_back([=]() { body(begin, end); });
+            }
+        }
+        // the calling thread takes the first block
+        body((size_t) 0, std::min(count, step));
+        for (std::thread &t : workers) {
+            t.join();
+        }
+    }
+}
+
+#endif // PARALLEL_H
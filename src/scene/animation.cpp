@@ -0,0 +1,176 @@
+#include "animation.h"
+#include <algorithm>
+#include <cmath>
+
+/// ANIMATION CLIP FUNCTIONS:
+
+// an empty clip
+AnimationClip::AnimationClip() :
+    jointCount(0),
+    duration(0)
+{}
+
+// drop all keys and set the number of joints animated
+void AnimationClip::reset(size_t joints) {
+    jointCount = joints;
+    duration = 0;
+    recorded.assign(joints, std::vector<Key>());
+    transOffsets.assign(joints + 1, 0);
+    transTimes.clear();
+    transValues.clear();
+    rotOffsets.assign(joints + 1, 0);
+    rotTimes.clear();
+    rotValues.clear();
+}
+
+// record a key for one joint
+void AnimationClip::addKey(size_t joint, float time, const glm::vec3 &translation, const glm::quat &rotation) {
+    if (joint < jointCount) {
+        recorded[joint].push_back({time, translation, rotation});
+    }
+}
+
+// sort the recorded keys and build the flat channel arrays
+void AnimationClip::compile() {
+    transOffsets.assign(jointCount + 1, 0);
+    rotOffsets.assign(jointCount + 1, 0);
+    transTimes.clear();
+    transValues.clear();
+    rotTimes.clear();
+    rotValues.clear();
+    duration = 0;
+
+    for (size_t j = 0; j < jointCount; ++j) {
+        std::vector<Key> keys = recorded[j];
+        std::stable_sort(keys.begin(), keys.end(),
+                         [](const Key &a, const Key &b) { return a.time < b.time; });
+
+        // a channel that never changes keeps just its first key
+        bool constTrans = true;
+        bool constRot = true;
+        for (const Key &k : keys) {
+            constTrans = constTrans && k.translation == keys[0].translation;
+            constRot = constRot && k.rotation == keys[0].rotation;
+        }
+
+        for (size_t i = 0; i < keys.size() && !(constTrans && i > 0); ++i) {
+            transTimes.push_back(keys[i].time);
+            transValues.push_back(keys[i].translation);
+        }
+
+        glm::quat prev;
+        for (size_t i = 0; i < keys.size() && !(constRot && i > 0); ++i) {
+            // store each rotation in the hemisphere of the previous one, so
+            // interpolation between neighbours always takes the short way
+            glm::quat q = keys[i].rotation;
+            if (i > 0 && glm::dot(prev, q) < 0) {
+                q = -q;
+            }
+            rotTimes.push_back(keys[i].time);
+            rotValues.push_back(q);
+            prev = q;
+        }
+
+        transOffsets[j + 1] = transTimes.size();
+        rotOffsets[j + 1] = rotTimes.size();
+        if (!keys.empty()) {
+            duration = std::max(duration, keys.back().time);
+        }
+    }
+}
+
+// getter for joint count
+size_t AnimationClip::getJointCount() const {
+    return jointCount;
+}
+
+// getter for duration
+float AnimationClip::getDuration() const {
+    return duration;
+}
+
+// does the clip have any compiled keys?
+bool AnimationClip::isEmpty() const {
+    return transTimes.empty() && rotTimes.empty();
+}
+
+/// ANIMATION SAMPLER FUNCTIONS:
+
+// find k in [first, last) with times[k] <= t < times[k + 1], starting at the cursor
+static uint32_t findKey(const float* times, uint32_t first, uint32_t last, float t, uint32_t cursor) {
+    if (cursor < first || cursor >= last) {
+        cursor = first;
+    }
+    // the common case while playing: same key or the next one
+    if (times[cursor] <= t) {
+        if (cursor + 1 >= last || t < times[cursor + 1]) {
+            return cursor;
+        }
+        if (cursor + 2 >= last || t < times[cursor + 2]) {
+            return cursor + 1;
+        }
+    }
+    const float* it = std::upper_bound(times + first, times + last, t);
+    return it == times + first ? first : (uint32_t) (it - times) - 1;
+}
+
+// spherical interpolation; a and b are already in the same hemisphere
+static glm::quat slerp(const glm::quat &a, const glm::quat &b, float s) {
+    float cosTheta = glm::dot(a, b);
+    if (cosTheta > 0.9995f) {
+        // nearly parallel: normalized lerp is accurate and avoids dividing by sin(~0)
+        return glm::normalize(a * (1 - s) + b * s);
+    }
+    float theta = std::acos(glm::clamp(cosTheta, -1.f, 1.f));
+    float sinTheta = std::sin(theta);
+    return a * (std::sin((1 - s) * theta) / sinTheta) + b * (std::sin(s * theta) / sinTheta);
+}
+
+AnimationSampler::AnimationSampler() :
+    clip(nullptr)
+{}
+
+// set the clip to sample
+void AnimationSampler::setClip(const AnimationClip* c) {
+    clip = c;
+    size_t n = clip != nullptr ? clip->getJointCount() : 0;
+    transCursor.assign(n, 0);
+    rotCursor.assign(n, 0);
+}
+
+// local translation and rotation of every joint at time t
+void AnimationSampler::sample(float t, glm::vec3* translations, glm::quat* rotations) {
+    if (clip == nullptr) {
+        return;
+    }
+
+    for (size_t j = 0; j < clip->jointCount; ++j) {
+        uint32_t first = clip->transOffsets[j];
+        uint32_t last = clip->transOffsets[j + 1];
+        if (first != last) {
+            uint32_t k = findKey(clip->transTimes.data(), first, last, t, transCursor[j]);
+            transCursor[j] = k;
+            const float* times = clip->transTimes.data();
+            if (k + 1 < last && t > times[k]) {
+                float s = (t - times[k]) / (times[k + 1] - times[k]);
+                translations[j] = glm::mix(clip->transValues[k], clip->transValues[k + 1], s);
+            } else {
+                translations[j] = clip->transValues[k];
+            }
+        }
+
+        first = clip->rotOffsets[j];
+        last = clip->rotOffsets[j + 1];
+        if (first != last) {
+            uint32_t k = findKey(clip->rotTimes.data(), first, last, t, rotCursor[j]);
+            rotCursor[j] = k;
+            const float* times = clip->rotTimes.data();
+            if (k + 1 < last && t > times[k]) {
+                float s = (t - times[k]) / (times[k + 1] - times[k]);
+                rotations[j] = slerp(clip->rotValues[k], clip->rotValues[k + 1], s);
+            } else {
+                rotations[j] = clip->rotValues[k];
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <la.h>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <cstdint>
+
+/// ANIMATION CLIP CLASS:
+/// per-joint translation and rotation channels over time. Keys are recorded per
+/// joint, then compiled into flat arrays: for each kind of channel, every
+/// joint's key times and values are stored back to back (times in one array,
+/// values in another) with an offset table, and constant channels keep one key.
+
+class AnimationClip {
+private:
+    size_t jointCount;
+    float duration;
+
+    // keys as recorded, before compile()
+    struct Key {
+        float time;
+        glm::vec3 translation;
+        glm::quat rotation;
+    };
+    std::vector<std::vector<Key>> recorded;
+
+    // compiled channels: joint j's keys are [offsets[j], offsets[j + 1])
+    std::vector<uint32_t> transOffsets;
+    std::vector<float> transTimes;
+    std::vector<glm::vec3> transValues;
+
+    std::vector<uint32_t> rotOffsets;
+    std::vector<float> rotTimes;
+    std::vector<glm::quat> rotValues;
+
+    friend class AnimationSampler;
+
+public:
+    // an empty clip
+    AnimationClip();
+
+    // drop all keys and set the number of joints animated
+    void reset(size_t joints);
+
+    // record a key for one joint (local translation and rotation)
+    void addKey(size_t joint, float time, const glm::vec3 &translation, const glm::quat &rotation);
+
+    // sort the recorded keys and build the flat channel arrays
+    void compile();
+
+    // getter for joint count
+    size_t getJointCount() const;
+
+    // getter for duration (time of the last key)
+    float getDuration() const;
+
+    // does the clip have any compiled keys?
+    bool isEmpty() const;
+};
+
+/// ANIMATION SAMPLER CLASS:
+/// evaluates every channel of a clip at a time t in one pass over the flat
+/// arrays. Each channel remembers the key it used last, so playback moving
+/// forward finds the next key in O(1); jumps fall back to a binary search.
+
+class AnimationSampler {
+private:
+    const AnimationClip* clip;
+    std::vector<uint32_t> transCursor;
+    std::vector<uint32_t> rotCursor;
+
+public:
+    AnimationSampler();
+
+    // set the clip to sample (it must stay alive and compiled)
+    void setClip(const AnimationClip* c);
+
+    // local translation and rotation of every joint at time t
+    void sample(float t, glm::vec3* translations, glm::quat* rotations);
+};
+
+#endif // ANIMATION_H
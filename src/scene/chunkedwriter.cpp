@@ -0,0 +1,34 @@
+#include "chunkedwriter.h"
+#include <parallel.h>
+#include <algorithm>
+#include <vector>
+
+// write vertices, then faces, formatted a batch of chunks at a time
+bool chunkedwriter::write(QIODevice &device, size_t vertCount, const Formatter &vertices,
+                          size_t faceCount, const Formatter &faces) {
+    size_t vertChunks = (vertCount + CHUNK - 1) / CHUNK;
+    size_t faceChunks = (faceCount + CHUNK - 1) / CHUNK;
+    size_t total = vertChunks + faceChunks;
+    std::vector<std::string> texts(2 * parallel::threadCount());
+
+    bool ok = true;
+    for (size_t first = 0; ok && first < total; first += texts.size()) {
+        size_t count = std::min(texts.size(), total - first);
+        parallel::forRange(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                size_t c = first + i;
+                if (c < vertChunks) {
+                    vertices(c * CHUNK, std::min(vertCount, (c + 1) * CHUNK), texts[i]);
+                } else {
+                    c -= vertChunks;
+                    faces(c * CHUNK, std::min(faceCount, (c + 1) * CHUNK), texts[i]);
+                }
+            }
+        });
+        for (size_t i = 0; ok && i < count; ++i) {
+            qint64 bytes = (qint64) texts[i].size();
+            ok = device.write(texts[i].data(), bytes) == bytes;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef CHUNKEDWRITER_H
+#define CHUNKEDWRITER_H
+
+#include <QIODevice>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/// Parallel chunked writer shared by the mesh exporters.
+///
+/// The vertex and face lists are cut into CHUNK-sized chunks; a batch of a
+/// few chunks per thread is formatted in parallel into chunk-local buffers,
+/// and the buffers are then written in order, so memory stays bounded
+/// however big the mesh is. A writer only supplies the formatter of one
+/// chunk of each list.
+
+namespace chunkedwriter {
+    // vertices or faces formatted per task
+    static const size_t CHUNK = 1 << 16;
+
+    // replace text with the records of items [begin, end)
+    typedef std::function<void(size_t begin, size_t end, std::string &text)> Formatter;
+
+    // write vertCount vertices, then faceCount faces, to an open device
+    bool write(QIODevice &device, size_t vertCount, const Formatter &vertices,
+               size_t faceCount, const Formatter &faces);
+}
+
+#endif // CHUNKEDWRITER_H
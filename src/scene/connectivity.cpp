@@ -0,0 +1,125 @@
+#include "connectivity.h"
+#include <parallel.h>
+#include <atomic>
+#include <memory>
+
+// buckets up to this size are grouped by a linear scan instead of a sort
+static const uint32_t SMALL_BUCKET = 16;
+
+// pair up the half-edges of one run with the same (min, max) vertices
+static void pairRun(const uint64_t* run, size_t count, uint32_t lo,
+                    const std::vector<uint32_t> &corners,
+                    connectivity::Links &links, connectivity::Report &report) {
+    uint32_t hi = (uint32_t) (run[0] >> 32);
+    uint32_t a = (uint32_t) run[0];
+    if (count == 1 && lo != hi) {
+        report.boundaryEdges++;
+    } else if (count == 2 && lo != hi && corners[a] != corners[(uint32_t) run[1]]) {
+        // two half-edges running opposite ways: twins
+        uint32_t b = (uint32_t) run[1];
+        links.sym[a] = b;
+        links.sym[b] = a;
+    } else {
+        report.nonManifoldEdges++;
+    }
+}
+
+void connectivity::build(const std::vector<uint32_t> &faceOffsets,
+                         const std::vector<uint32_t> &corners,
+                         size_t vertexCount, Links &links) {
+    size_t n = corners.size();
+    size_t faceCount = faceOffsets.empty() ? 0 : faceOffsets.size() - 1;
+
+    links.next.resize(n);
+    links.face.resize(n);
+    links.sym.assign(n, NONE);
+    links.report = Report();
+
+    // next and face links, each half-edge's smaller vertex, and the histogram
+    // of smaller vertices (the counting pass of the sort)
+    std::unique_ptr<std::atomic<uint32_t>[]> cursor(new std::atomic<uint32_t>[vertexCount + 1]());
+    std::vector<uint32_t> lows(n);
+    parallel::forRange(faceCount, 4096, [&](size_t first, size_t last) {
+        for (size_t f = first; f < last; ++f) {
+            uint32_t begin = faceOffsets[f];
+            uint32_t end = faceOffsets[f + 1];
+            for (uint32_t h = begin; h < end; ++h) {
+                links.next[h] = h + 1 < end ? h + 1 : begin;
+                links.face[h] = (uint32_t) f;
+
+                uint32_t from = corners[h == begin ? end - 1 : h - 1];
+                uint32_t to = corners[h];
+                lows[h] = std::min(from, to);
+                cursor[lows[h]].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    // bucket v holds the half-edges whose smaller vertex is v
+    std::vector<uint32_t> bucketStart(vertexCount + 1);
+    uint32_t sum = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        bucketStart[v] = sum;
+        sum += cursor[v].load(std::memory_order_relaxed);
+        cursor[v].store(bucketStart[v], std::memory_order_relaxed);
+    }
+    bucketStart[vertexCount] = sum;
+
+    // scatter (larger vertex, half-edge) pairs into the buckets
+    std::vector<uint64_t> buckets(n);
+    parallel::forRange(faceCount, 4096, [&](size_t first, size_t last) {
+        for (size_t f = first; f < last; ++f) {
+            uint32_t begin = faceOffsets[f];
+            uint32_t end = faceOffsets[f + 1];
+            for (uint32_t h = begin; h < end; ++h) {
+                uint32_t from = corners[h == begin ? end - 1 : h - 1];
+                uint32_t hi = std::max(from, corners[h]);
+                uint32_t slot = cursor[lows[h]].fetch_add(1, std::memory_order_relaxed);
+                buckets[slot] = ((uint64_t) hi << 32) | h;
+            }
+        }
+    });
+
+    // inside a bucket, half-edges of the same edge share the larger vertex;
+    // buckets hold about as many entries as the vertex has edges, so most are tiny
+    size_t blocks = std::max<size_t>(1, std::min<size_t>(parallel::threadCount(), vertexCount / 4096));
+    std::vector<Report> reports(blocks);
+    parallel::forRange(blocks, 1, [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t b = firstBlock; b < lastBlock; ++b) {
+            Report &report = reports[b];
+            size_t vBegin = vertexCount * b / blocks;
+            size_t vEnd = vertexCount * (b + 1) / blocks;
+            for (size_t v = vBegin; v < vEnd; ++v) {
+                uint64_t* bucket = buckets.data() + bucketStart[v];
+                uint32_t count = bucketStart[v + 1] - bucketStart[v];
+                if (count > SMALL_BUCKET) {
+                    // a high-valence vertex: sort by larger vertex, then half-edge
+                    std::sort(bucket, bucket + count);
+                } else {
+                    // insertion sort, same order
+                    for (uint32_t i = 1; i < count; ++i) {
+                        uint64_t e = bucket[i];
+                        uint32_t j = i;
+                        for (; j > 0 && bucket[j - 1] > e; --j) {
+                            bucket[j] = bucket[j - 1];
+                        }
+                        bucket[j] = e;
+                    }
+                }
+                for (uint32_t i = 0; i < count; ) {
+                    uint32_t j = i + 1;
+                    while (j < count && (bucket[j] >> 32) == (bucket[i] >> 32)) {
+                        j++;
+                    }
+                    pairRun(bucket + i, j - i, (uint32_t) v, corners, links, report);
+                    i = j;
+                }
+            }
+        }
+    });
+
+    for (const Report &r : reports) {
+        links.report.boundaryEdges += r.boundaryEdges;
+        links.report.nonManifoldEdges += r.nonManifoldEdges;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Half-edge connectivity from indexed faces.
+///
+/// Half-edge h is corner h of the face list: it belongs to the face owning the
+/// corner, points to the corner's vertex and comes from the previous corner's.
+/// next and face links come straight from the face offsets. sym links come
+/// from a radix sort of the packed (min vertex, max vertex) edge keys whose
+/// leading digit is the whole min vertex: one parallel counting pass and one
+/// scatter put every half-edge in the bucket of its smaller vertex, and the
+/// few entries of each bucket are then ordered by the max vertex, after which
+/// the two halves of each edge sit next to each other. Linear in the corners.
+///
+/// An edge used by a single half-edge is a boundary edge. An edge used by
+/// more than two half-edges, by two running the same way (a flipped face) or
+/// from a vertex back to itself is non-manifold. Neither gets sym links.
+
+namespace connectivity {
+    // no half-edge (boundary or non-manifold sym)
+    static const uint32_t NONE = ~0u;
+
+    struct Report {
+        size_t boundaryEdges;
+        size_t nonManifoldEdges;
+
+        Report() : boundaryEdges(0), nonManifoldEdges(0) {}
+    };
+
+    struct Links {
+        std::vector<uint32_t> next;  // next half-edge around the same face
+        std::vector<uint32_t> sym;   // the opposite half-edge, or NONE
+        std::vector<uint32_t> face;  // face of each half-edge
+        Report report;
+    };
+
+    // faceOffsets has one entry per face plus a trailing corner count, and
+    // every corner is a vertex index below vertexCount
+    void build(const std::vector<uint32_t> &faceOffsets,
+               const std::vector<uint32_t> &corners,
+               size_t vertexCount, Links &links);
+}
+
+#endif // CONNECTIVITY_H
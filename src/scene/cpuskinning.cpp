@@ -0,0 +1,255 @@
+#include "cpuskinning.h"
+#include "parallel.h"
+#include <simd.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/// Each vertex blends the palette rows of its influences into one 3x4 matrix
+/// (three multiply-adds of four floats per influence) and then applies it to
+/// the position and normal. Unbound vertices and out-of-range joints use an
+/// identity entry appended to a private copy of the palette, so the kernels
+/// never branch on them.
+
+typedef void (*SkinFn)(const float* pos, const float* nor, const SkinWeights* w,
+                       size_t begin, size_t end, const float* palette, uint16_t identity,
+                       float* outPos, float* outNor);
+
+// joint and weight of influence k, with the identity standing in for missing ones
+static inline void influence(const SkinWeights &sw, int k, uint16_t identity,
+                             uint16_t &joint, float &weight) {
+    if (!sw.isBound()) {
+        joint = identity;
+        weight = k == 0 ? 1.f : 0.f;
+        return;
+    }
+    joint = sw.joints[k] < identity ? sw.joints[k] : identity;
+    weight = sw.weight(k);
+}
+
+static void skinScalar(const float* pos, const float* nor, const SkinWeights* w,
+                       size_t begin, size_t end, const float* palette, uint16_t identity,
+                       float* outPos, float* outNor) {
+    for (size_t v = begin; v < end; ++v) {
+        float m[12] = {0};
+        for (int k = 0; k < SkinWeights::MAX_INFLUENCES; ++k) {
+            uint16_t joint;
+            float weight;
+            influence(w[v], k, identity, joint, weight);
+            if (weight == 0) {
+                continue;
+            }
+            const float* rows = palette + 12 * (size_t) joint;
+            for (int i = 0; i < 12; ++i) {
+                m[i] += weight * rows[i];
+            }
+        }
+
+        const float* p = pos + 4 * v;
+        float* op = outPos + 4 * v;
+        for (int r = 0; r < 3; ++r) {
+            op[r] = m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3];
+        }
+        op[3] = 1;
+
+        if (nor != nullptr) {
+            const float* n = nor + 4 * v;
+            float* on = outNor + 4 * v;
+            for (int r = 0; r < 3; ++r) {
+                on[r] = m[4 * r] * n[0] + m[4 * r + 1] * n[1] + m[4 * r + 2] * n[2];
+            }
+            float len = std::sqrt(on[0] * on[0] + on[1] * on[1] + on[2] * on[2]);
+            float inv = len > 0 ? 1.f / len : 0.f;
+            on[0] *= inv;
+            on[1] *= inv;
+            on[2] *= inv;
+            on[3] = 0;
+        }
+    }
+}
+
+#ifdef MM_SIMD_X86
+
+// AVX2: two vertices per iteration, one per 128-bit lane
+MM_TARGET_AVX2
+static void skinAVX2(const float* pos, const float* nor, const SkinWeights* w,
+                     size_t begin, size_t end, const float* palette, uint16_t identity,
+                     float* outPos, float* outNor) {
+    const __m256 wOne = _mm256_setr_ps(0, 0, 0, 1, 0, 0, 0, 1);
+    const __m256 xyzMask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t v = begin;
+    for (; v + 2 <= end; v += 2) {
+        __m256 m0 = zero, m1 = zero, m2 = zero;
+        for (int k = 0; k < SkinWeights::MAX_INFLUENCES; ++k) {
+            uint16_t ja, jb;
+            float wa, wb;
+            influence(w[v], k, identity, ja, wa);
+            influence(w[v + 1], k, identity, jb, wb);
+            if (wa == 0 && wb == 0) {
+                continue;
+            }
+            const float* ra = palette + 12 * (size_t) ja;
+            const float* rb = palette + 12 * (size_t) jb;
+            __m256 weight = _mm256_setr_m128(_mm_set1_ps(wa), _mm_set1_ps(wb));
+            m0 = _mm256_add_ps(m0, _mm256_mul_ps(weight, _mm256_setr_m128(_mm_loadu_ps(ra), _mm_loadu_ps(rb))));
+            m1 = _mm256_add_ps(m1, _mm256_mul_ps(weight, _mm256_setr_m128(_mm_loadu_ps(ra + 4), _mm_loadu_ps(rb + 4))));
+            m2 = _mm256_add_ps(m2, _mm256_mul_ps(weight, _mm256_setr_m128(_mm_loadu_ps(ra + 8), _mm_loadu_ps(rb + 8))));
+        }
+
+        // position with w = 1: dot each row with it, then gather the sums as xyz
+        __m256 p = _mm256_or_ps(_mm256_and_ps(_mm256_loadu_ps(pos + 4 * v), xyzMask), wOne);
+        __m256 xy = _mm256_hadd_ps(_mm256_mul_ps(m0, p), _mm256_mul_ps(m1, p));
+        __m256 z0 = _mm256_hadd_ps(_mm256_mul_ps(m2, p), zero);
+        __m256 op = _mm256_hadd_ps(xy, z0);
+        _mm256_storeu_ps(outPos + 4 * v, _mm256_or_ps(op, wOne));
+
+        if (nor != nullptr) {
+            __m256 n = _mm256_and_ps(_mm256_loadu_ps(nor + 4 * v), xyzMask);
+            __m256 nxy = _mm256_hadd_ps(_mm256_mul_ps(m0, n), _mm256_mul_ps(m1, n));
+            __m256 nz0 = _mm256_hadd_ps(_mm256_mul_ps(m2, n), zero);
+            __m256 on = _mm256_hadd_ps(nxy, nz0);
+
+            __m256 sq = _mm256_mul_ps(on, on);
+            sq = _mm256_hadd_ps(sq, sq);
+            sq = _mm256_hadd_ps(sq, sq);
+            __m256 len = _mm256_sqrt_ps(sq);
+            __m256 nonZero = _mm256_cmp_ps(len, zero, _CMP_GT_OQ);
+            on = _mm256_and_ps(_mm256_div_ps(on, len), nonZero);
+            _mm256_storeu_ps(outNor + 4 * v, on);
+        }
+    }
+
+    // odd vertex out
+    skinScalar(pos, nor, w, v, end, palette, identity, outPos, outNor);
+}
+
+#endif
+
+void skinning::packPalette(const float* matrices, size_t jointCount, float* rows) {
+    for (size_t j = 0; j < jointCount; ++j) {
+        const float* m = matrices + 16 * j;
+        float* r = rows + 12 * j;
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                r[4 * row + col] = m[4 * col + row];
+            }
+        }
+    }
+}
+
+void skinning::skinLinear(const float* positions, const float* normals,
+                          const SkinWeights* weights, size_t vertCount,
+                          const float* palette, size_t jointCount,
+                          float* outPositions, float* outNormals) {
+#ifdef MM_SIMD_X86
+    static const SkinFn fn = simd::hasAVX2() ? skinAVX2 : skinScalar;
+#else
+    static const SkinFn fn = skinScalar;
+#endif
+
+    // the palette plus one identity entry for unbound vertices
+    if (jointCount > 65535) {
+        jointCount = 65535;
+    }
+    std::vector<float> table(12 * (jointCount + 1), 0.f);
+    if (jointCount != 0) {
+        std::memcpy(table.data(), palette, 12 * jointCount * sizeof(float));
+    }
+    float* id = &table[12 * jointCount];
+    id[0] = id[5] = id[10] = 1;
+    uint16_t identity = (uint16_t) jointCount;
+
+    if (outNormals == nullptr) {
+        normals = nullptr;
+    }
+
+    parallel::forRange(vertCount, 4096, [&](size_t begin, size_t end) {
+        fn(positions, normals, weights, begin, end, table.data(), identity, outPositions, outNormals);
+    });
+}
+
+// rotate v by the unit quaternion q (xyzw)
+static inline void rotate(const float* q, const float* v, float* out) {
+    // t = q.xyz x v + q.w * v, out = v + 2 * q.xyz x t
+    float t[3] = {q[1] * v[2] - q[2] * v[1] + q[3] * v[0],
+                  q[2] * v[0] - q[0] * v[2] + q[3] * v[1],
+                  q[0] * v[1] - q[1] * v[0] + q[3] * v[2]};
+    out[0] = v[0] + 2 * (q[1] * t[2] - q[2] * t[1]);
+    out[1] = v[1] + 2 * (q[2] * t[0] - q[0] * t[2]);
+    out[2] = v[2] + 2 * (q[0] * t[1] - q[1] * t[0]);
+}
+
+void skinning::skinDualQuat(const float* positions, const float* normals,
+                            const SkinWeights* weights, size_t vertCount,
+                            const float* palette, size_t jointCount,
+                            float* outPositions, float* outNormals) {
+    if (outNormals == nullptr) {
+        normals = nullptr;
+    }
+
+    parallel::forRange(vertCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            // blend the dual quaternions; a quaternion and its negation are the
+            // same rotation, so flip those facing away from the first
+            const SkinWeights &sw = weights[v];
+            const float* first = nullptr;
+            float real[4] = {0, 0, 0, 0};
+            float dual[4] = {0, 0, 0, 0};
+            for (int k = 0; k < SkinWeights::MAX_INFLUENCES; ++k) {
+                float w = sw.weight(k);
+                if (w == 0 || sw.joints[k] >= jointCount) {
+                    continue;
+                }
+                const float* r = palette + 8 * (size_t) sw.joints[k];
+                if (first == nullptr) {
+                    first = r;
+                }
+                if (r[0] * first[0] + r[1] * first[1] + r[2] * first[2] + r[3] * first[3] < 0) {
+                    w = -w;
+                }
+                for (int i = 0; i < 4; ++i) {
+                    real[i] += w * r[i];
+                    dual[i] += w * r[4 + i];
+                }
+            }
+
+            const float* p = positions + 4 * v;
+            float* op = outPositions + 4 * v;
+            float len = std::sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+            if (first == nullptr || !(len > 0)) {
+                // unbound: rest position and normal
+                std::memcpy(op, p, 3 * sizeof(float));
+                op[3] = 1;
+                if (normals != nullptr) {
+                    std::memcpy(outNormals + 4 * v, normals + 4 * v, 3 * sizeof(float));
+                    outNormals[4 * v + 3] = 0;
+                }
+                continue;
+            }
+            for (int i = 0; i < 4; ++i) {
+                real[i] /= len;
+                dual[i] /= len;
+            }
+
+            // translation = 2 * dual * conjugate(real)
+            float trans[3] = {
+                2 * (real[3] * dual[0] - dual[3] * real[0] + real[1] * dual[2] - real[2] * dual[1]),
+                2 * (real[3] * dual[1] - dual[3] * real[1] + real[2] * dual[0] - real[0] * dual[2]),
+                2 * (real[3] * dual[2] - dual[3] * real[2] + real[0] * dual[1] - real[1] * dual[0])
+            };
+            rotate(real, p, op);
+            op[0] += trans[0];
+            op[1] += trans[1];
+            op[2] += trans[2];
+            op[3] = 1;
+
+            if (normals != nullptr) {
+                float* on = outNormals + 4 * v;
+                rotate(real, normals + 4 * v, on);
+                on[3] = 0;
+            }
+        }
+    });
+}
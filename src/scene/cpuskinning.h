@@ -0,0 +1,37 @@
+#ifndef CPUSKINNING_H
+#define CPUSKINNING_H
+
+#include "skinweights.h"
+#include <cstddef>
+
+/// CPU linear blend and dual quaternion skinning.
+///
+/// The same deformations as skeleton.vert.glsl and skeleton_dq.vert.glsl, for
+/// posed export and batch baking without a GL context. The linear palette
+/// holds the top three rows of each joint's skin matrix (overall
+/// transformation * bind matrix), 12 floats per joint; the dual quaternion
+/// palette holds the real and dual part of each skin transformation as xyzw
+/// quaternions, 8 floats per joint; both exactly as uploaded to the shaders.
+/// Positions and normals are xyzw quadruples; posed normals are renormalized,
+/// and vertices with no weights (or only out-of-range joints) keep their rest
+/// position and normal. Vertices are processed in parallel, linear blending
+/// two at a time with AVX2 when available.
+
+namespace skinning {
+    // pack column-major 4x4 skin matrices (16 floats each) into palette rows
+    void packPalette(const float* matrices, size_t jointCount, float* rows);
+
+    // pose vertCount vertices; normals / outNormals may be null to skip normals
+    void skinLinear(const float* positions, const float* normals,
+                    const SkinWeights* weights, size_t vertCount,
+                    const float* palette, size_t jointCount,
+                    float* outPositions, float* outNormals);
+
+    // the same with dual quaternion blending
+    void skinDualQuat(const float* positions, const float* normals,
+                      const SkinWeights* weights, size_t vertCount,
+                      const float* palette, size_t jointCount,
+                      float* outPositions, float* outNormals);
+}
+
+#endif // CPUSKINNING_H
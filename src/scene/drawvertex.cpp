@@ -60,7 +60,7 @@ GLenum drawHE::drawMode() {
 // create halfedge selection
 void drawHE::create() {
     std::vector<GLuint> idx = {0, 1};
-    std::vector<glm::vec4> pos = {he->getSymHE()->getVert()->getCoord(),
+    std::vector<glm::vec4> pos = {he->getStartVert()->getCoord(),
                                   he->getVert()->getCoord()};
     std::vector<glm::vec4> col = {glm::vec4(1, 0, 0, 1), glm::vec4(1, 1, 0, 1)};
 
@@ -0,0 +1,556 @@
+#include "glbreader.h"
+#include <parallel.h>
+#include <backgroundtask.h>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+static const uint32_t GLB_MAGIC = 0x46546C67;   // "glTF"
+static const uint32_t CHUNK_JSON = 0x4E4F534A;  // "JSON"
+static const uint32_t CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+// accessor component types
+enum ComponentType {
+    BYTE = 5120,
+    UNSIGNED_BYTE = 5121,
+    SHORT = 5122,
+    UNSIGNED_SHORT = 5123,
+    UNSIGNED_INT = 5125,
+    FLOAT = 5126
+};
+
+// the only primitive mode that makes faces
+static const int TRIANGLES = 4;
+
+// an accessor resolved to memory in the BIN chunk
+struct View {
+    const uint8_t* data;
+    size_t count;
+    size_t stride;      // bytes from one element to the next
+    int componentType;
+    int components;     // 1 for SCALAR, 3 for VEC3, 16 for MAT4, ...
+    bool normalized;
+};
+
+static size_t componentSize(int type) {
+    switch (type) {
+    case BYTE: case UNSIGNED_BYTE: return 1;
+    case SHORT: case UNSIGNED_SHORT: return 2;
+    case UNSIGNED_INT: case FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+static int componentCount(const QString &type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4" || type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+// find accessor index in the BIN chunk; false if it's missing, sparse, in
+// another buffer or out of bounds
+static bool resolveAccessor(const QJsonObject &gltf, int index, const uint8_t* bin, size_t binSize, View &view) {
+    QJsonArray accessors = gltf["accessors"].toArray();
+    if (index < 0 || index >= accessors.size()) {
+        return false;
+    }
+    QJsonObject accessor = accessors[index].toObject();
+    QJsonArray bufferViews = gltf["bufferViews"].toArray();
+    int viewIndex = accessor["bufferView"].toInt(-1);
+    if (viewIndex < 0 || viewIndex >= bufferViews.size() || accessor.contains("sparse")) {
+        return false;
+    }
+    QJsonObject bufferView = bufferViews[viewIndex].toObject();
+    if (bufferView["buffer"].toInt(-1) != 0) {
+        // only the file's own BIN chunk, no external buffers
+        return false;
+    }
+
+    view.componentType = accessor["componentType"].toInt();
+    view.components = componentCount(accessor["type"].toString());
+    view.normalized = accessor["normalized"].toBool(false);
+    size_t elementSize = componentSize(view.componentType) * view.components;
+    double count = accessor["count"].toDouble(-1);
+    if (elementSize == 0 || count < 0) {
+        return false;
+    }
+    view.count = (size_t) count;
+    view.stride = (size_t) bufferView["byteStride"].toDouble(0);
+    if (view.stride == 0) {
+        view.stride = elementSize;
+    }
+
+    // sizes as doubles are exact far beyond any file size
+    double viewOffset = bufferView["byteOffset"].toDouble(0);
+    double viewLength = bufferView["byteLength"].toDouble(-1);
+    double offset = accessor["byteOffset"].toDouble(0);
+    if (viewOffset < 0 || viewLength < 0 || offset < 0 || viewOffset + viewLength > (double) binSize) {
+        return false;
+    }
+    if (view.count > 0 && offset + (double) view.stride * (view.count - 1) + elementSize > viewLength) {
+        return false;
+    }
+    view.data = bin + (size_t) viewOffset + (size_t) offset;
+    return true;
+}
+
+// component c of element i; normalized integers map to [0, 1] or [-1, 1]
+static float readFloat(const View &view, size_t i, int c) {
+    const uint8_t* p = view.data + i * view.stride + c * componentSize(view.componentType);
+    switch (view.componentType) {
+    case FLOAT: { float v; std::memcpy(&v, p, 4); return v; }
+    case UNSIGNED_BYTE: return view.normalized ? *p / 255.f : *p;
+    case UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return view.normalized ? v / 65535.f : v; }
+    case BYTE: { int8_t v; std::memcpy(&v, p, 1); return view.normalized ? std::max(v / 127.f, -1.f) : v; }
+    case SHORT: { int16_t v; std::memcpy(&v, p, 2); return view.normalized ? std::max(v / 32767.f, -1.f) : v; }
+    case UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return (float) v; }
+    default: return 0;
+    }
+}
+
+// component c of element i as an index; ~0u if it isn't an unsigned integer
+static uint32_t readIndex(const View &view, size_t i, int c) {
+    const uint8_t* p = view.data + i * view.stride + c * componentSize(view.componentType);
+    switch (view.componentType) {
+    case UNSIGNED_BYTE: return *p;
+    case UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+    case UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    default: return ~0u;
+    }
+}
+
+/// SKELETON:
+
+static glm::mat4 localMatrix(const QJsonObject &node) {
+    if (node.contains("matrix")) {
+        QJsonArray m = node["matrix"].toArray();
+        glm::mat4 out;
+        if (m.size() == 16) {
+            // column-major, like glm
+            for (int i = 0; i < 16; ++i) {
+                out[i / 4][i % 4] = (float) m[i].toDouble();
+            }
+        }
+        return out;
+    }
+    QJsonArray t = node["translation"].toArray();
+    QJsonArray r = node["rotation"].toArray();
+    QJsonArray s = node["scale"].toArray();
+    glm::vec3 translation(0);
+    glm::quat rotation(1, 0, 0, 0);
+    glm::vec3 scale(1);
+    if (t.size() == 3) {
+        translation = glm::vec3((float) t[0].toDouble(), (float) t[1].toDouble(), (float) t[2].toDouble());
+    }
+    if (r.size() == 4) {
+        // stored x, y, z, w
+        rotation = glm::quat((float) r[3].toDouble(), (float) r[0].toDouble(),
+                             (float) r[1].toDouble(), (float) r[2].toDouble());
+    }
+    if (s.size() == 3) {
+        scale = glm::vec3((float) s[0].toDouble(), (float) s[1].toDouble(), (float) s[2].toDouble());
+    }
+    return glm::translate(glm::mat4(), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(), scale);
+}
+
+// translation and rotation of a matrix, dropping any scale
+static void decompose(const glm::mat4 &m, glm::vec3 &translation, glm::quat &rotation) {
+    translation = glm::vec3(m[3]);
+    glm::mat3 r(glm::normalize(glm::vec3(m[0])),
+                glm::normalize(glm::vec3(m[1])),
+                glm::normalize(glm::vec3(m[2])));
+    rotation = glm::normalize(glm::quat_cast(r));
+}
+
+// the joints of a skin in parent-first order; jointOf maps each slot of the
+// skin's joint list to its joint
+static bool readSkeleton(const QJsonObject &gltf, const QJsonObject &skin, const uint8_t* bin, size_t binSize,
+                         glbreader::SkeletonData &skeleton, std::vector<int> &jointOf) {
+    QJsonArray nodes = gltf["nodes"].toArray();
+    int nodeCount = nodes.size();
+
+    std::vector<int> parent(nodeCount, -1);
+    for (int n = 0; n < nodeCount; ++n) {
+        QJsonArray children = nodes[n].toObject()["children"].toArray();
+        for (int i = 0; i < children.size(); ++i) {
+            int child = children[i].toInt(-1);
+            if (child < 0 || child >= nodeCount || child == n || parent[child] != -1) {
+                return false;
+            }
+            parent[child] = n;
+        }
+    }
+
+    // world matrices, depth first from the roots in node order
+    std::vector<glm::mat4> world(nodeCount);
+    std::vector<int> order;
+    order.reserve(nodeCount);
+    std::vector<int> stack;
+    for (int root = nodeCount - 1; root >= 0; --root) {
+        if (parent[root] == -1) {
+            stack.push_back(root);
+        }
+    }
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        QJsonObject node = nodes[n].toObject();
+        world[n] = parent[n] >= 0 ? world[parent[n]] * localMatrix(node) : localMatrix(node);
+        order.push_back(n);
+        QJsonArray children = node["children"].toArray();
+        for (int i = children.size() - 1; i >= 0; --i) {
+            stack.push_back(children[i].toInt());
+        }
+    }
+    if ((int) order.size() != nodeCount) {
+        // a cycle
+        return false;
+    }
+
+    QJsonArray skinJoints = skin["joints"].toArray();
+    std::vector<int> slotOfNode(nodeCount, -1);
+    for (int s = 0; s < skinJoints.size(); ++s) {
+        int n = skinJoints[s].toInt(-1);
+        if (n < 0 || n >= nodeCount || slotOfNode[n] != -1) {
+            return false;
+        }
+        slotOfNode[n] = s;
+    }
+
+    // identity unless the skin has inverse bind matrices
+    std::vector<glm::mat4> inverseBinds(skinJoints.size());
+    if (skin.contains("inverseBindMatrices")) {
+        View view;
+        if (!resolveAccessor(gltf, skin["inverseBindMatrices"].toInt(-1), bin, binSize, view)
+                || view.componentType != FLOAT || view.components != 16
+                || view.count < inverseBinds.size()) {
+            return false;
+        }
+        for (size_t s = 0; s < inverseBinds.size(); ++s) {
+            std::memcpy(&inverseBinds[s][0][0], view.data + s * view.stride, 16 * sizeof(float));
+        }
+    }
+
+    // in depth-first order every joint comes after the joints above it
+    std::vector<int> jointOfNode(nodeCount, -1);
+    jointOf.assign(skinJoints.size(), -1);
+    skeleton.joints.clear();
+    int roots = 0;
+    for (int n : order) {
+        int slot = slotOfNode[n];
+        if (slot < 0) {
+            continue;
+        }
+        int p = parent[n];
+        while (p >= 0 && jointOfNode[p] < 0) {
+            p = parent[p];
+        }
+
+        glbreader::JointData joint;
+        joint.name = nodes[n].toObject()["name"].toString(QString("joint%1").arg(slot));
+        joint.parent = p >= 0 ? jointOfNode[p] : -1;
+        decompose(p >= 0 ? glm::inverse(world[p]) * world[n] : world[n], joint.translation, joint.rotation);
+        joint.inverseBind = inverseBinds[slot];
+        roots += joint.parent < 0;
+
+        jointOfNode[n] = jointOf[slot] = (int) skeleton.joints.size();
+        skeleton.joints.push_back(joint);
+    }
+
+    // the skeleton is shown as one tree, so several roots get a common parent
+    if (roots > 1) {
+        glbreader::JointData root;
+        root.name = "root";
+        root.parent = -1;
+        root.translation = glm::vec3(0);
+        root.rotation = glm::quat(1, 0, 0, 0);
+        root.inverseBind = glm::mat4();
+        for (glbreader::JointData &joint : skeleton.joints) {
+            joint.parent = joint.parent < 0 ? 0 : joint.parent + 1;
+        }
+        skeleton.joints.insert(skeleton.joints.begin(), root);
+        for (int &j : jointOf) {
+            j++;
+        }
+    }
+    return true;
+}
+
+/// MESH:
+
+// has the load this read belongs to been cancelled?
+static bool cancelled(BackgroundTask* task) {
+    return task != nullptr && task->isCancelled();
+}
+
+// bit pattern of a position, for welding
+struct PositionKey {
+    uint32_t bits[3];
+
+    bool operator==(const PositionKey &other) const {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey &key) const {
+        uint64_t h = key.bits[0] * 0x9E3779B97F4A7C15ULL;
+        h ^= (h >> 29) + key.bits[1] * 0xC2B2AE3D27D4EB4FULL;
+        h ^= (h >> 32) + key.bits[2] * 0x165667B19E3779F9ULL;
+        return (size_t) (h ^ (h >> 31));
+    }
+};
+
+static bool readMesh(const QJsonObject &gltf, const QJsonObject &mesh, const std::vector<int> &jointOf,
+                     const uint8_t* bin, size_t binSize, MeshArrays &arrays, BackgroundTask* task) {
+    // material colors are only used if some material has one
+    QJsonArray materials = gltf["materials"].toArray();
+    bool colors = false;
+    for (int m = 0; m < materials.size(); ++m) {
+        colors = colors || materials[m].toObject()["pbrMetallicRoughness"].toObject().contains("baseColorFactor");
+    }
+    bool skinned = !jointOf.empty();
+
+    // every primitive's vertices and triangles, one after the other
+    std::vector<glm::vec4> positions;
+    std::vector<SkinWeights> weights;
+    std::vector<uint32_t> triangles;
+    std::vector<glm::vec4> triangleColors;
+
+    QJsonArray primitives = mesh["primitives"].toArray();
+    for (int i = 0; i < primitives.size(); ++i) {
+        if (cancelled(task)) {
+            return false;
+        }
+        QJsonObject primitive = primitives[i].toObject();
+        if (primitive["mode"].toInt(TRIANGLES) != TRIANGLES) {
+            continue;
+        }
+        QJsonObject attributes = primitive["attributes"].toObject();
+        View pos;
+        if (!resolveAccessor(gltf, attributes["POSITION"].toInt(-1), bin, binSize, pos)
+                || pos.componentType != FLOAT || pos.components != 3) {
+            return false;
+        }
+        size_t base = positions.size();
+        positions.resize(base + pos.count);
+        parallel::forRange(pos.count, 1 << 14, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                std::memcpy(&positions[base + v][0], pos.data + v * pos.stride, 3 * sizeof(float));
+                positions[base + v][3] = 1;
+            }
+        });
+
+        // vertices of a primitive without weights stay unbound
+        if (skinned) {
+            weights.resize(base + pos.count);
+        }
+        if (skinned && attributes.contains("JOINTS_0") && attributes.contains("WEIGHTS_0")) {
+            View joints;
+            View ws;
+            if (!resolveAccessor(gltf, attributes["JOINTS_0"].toInt(-1), bin, binSize, joints)
+                    || !resolveAccessor(gltf, attributes["WEIGHTS_0"].toInt(-1), bin, binSize, ws)
+                    || joints.components != 4 || ws.components != 4
+                    || joints.count != pos.count || ws.count != pos.count) {
+                return false;
+            }
+            parallel::forRange(pos.count, 1 << 14, [&](size_t begin, size_t end) {
+                for (size_t v = begin; v < end; ++v) {
+                    int jts[4];
+                    float w[4];
+                    for (int c = 0; c < 4; ++c) {
+                        uint32_t slot = readIndex(joints, v, c);
+                        jts[c] = slot < jointOf.size() ? jointOf[slot] : -1;
+                        w[c] = readFloat(ws, v, c);
+                    }
+                    weights[base + v].set(jts, w, 4);
+                }
+            });
+        }
+
+        size_t first = triangles.size();
+        if (primitive.contains("indices")) {
+            View indices;
+            if (!resolveAccessor(gltf, primitive["indices"].toInt(-1), bin, binSize, indices)
+                    || indices.components != 1 || componentSize(indices.componentType) == 0
+                    || indices.componentType == FLOAT) {
+                return false;
+            }
+            size_t n = indices.count - indices.count % 3;
+            triangles.resize(first + n);
+            if (indices.componentType == UNSIGNED_INT && indices.stride == sizeof(uint32_t)) {
+                std::memcpy(&triangles[first], indices.data, n * sizeof(uint32_t));
+            } else {
+                for (size_t t = 0; t < n; ++t) {
+                    triangles[first + t] = readIndex(indices, t, 0);
+                }
+            }
+        } else {
+            // unindexed: every three vertices make a triangle
+            size_t n = pos.count - pos.count % 3;
+            triangles.resize(first + n);
+            for (size_t t = 0; t < n; ++t) {
+                triangles[first + t] = (uint32_t) t;
+            }
+        }
+        for (size_t t = first; t < triangles.size(); ++t) {
+            if (triangles[t] >= pos.count) {
+                return false;
+            }
+            triangles[t] += (uint32_t) base;
+        }
+
+        if (colors) {
+            glm::vec4 color(1);
+            int m = primitive["material"].toInt(-1);
+            if (m >= 0 && m < materials.size()) {
+                QJsonArray factor = materials[m].toObject()["pbrMetallicRoughness"].toObject()["baseColorFactor"].toArray();
+                if (factor.size() == 4) {
+                    color = glm::vec4((float) factor[0].toDouble(), (float) factor[1].toDouble(),
+                                      (float) factor[2].toDouble(), 1.f);
+                }
+            }
+            triangleColors.insert(triangleColors.end(), (triangles.size() - first) / 3, color);
+        }
+    }
+
+    // weld the copies glTF makes of vertices along seams
+    std::vector<uint32_t> remap(positions.size());
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+    welded.reserve(positions.size());
+    arrays.positions.clear();
+    arrays.skinWeights.clear();
+    for (size_t v = 0; v < positions.size(); ++v) {
+        if (v % (1 << 16) == 0 && cancelled(task)) {
+            return false;
+        }
+        PositionKey key;
+        std::memcpy(key.bits, &positions[v][0], sizeof(key.bits));
+        auto found = welded.emplace(key, (uint32_t) arrays.positions.size());
+        if (found.second) {
+            arrays.positions.push_back(positions[v]);
+            if (skinned) {
+                arrays.skinWeights.push_back(weights[v]);
+            }
+        }
+        remap[v] = found.first->second;
+    }
+
+    // triangles that welding collapsed are dropped
+    arrays.faceOffsets.clear();
+    arrays.corners.clear();
+    arrays.faceColors.clear();
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+        if (t % (3 << 16) == 0 && cancelled(task)) {
+            return false;
+        }
+        uint32_t a = remap[triangles[t]];
+        uint32_t b = remap[triangles[t + 1]];
+        uint32_t c = remap[triangles[t + 2]];
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+        arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+        arrays.corners.push_back(a);
+        arrays.corners.push_back(b);
+        arrays.corners.push_back(c);
+        if (colors) {
+            arrays.faceColors.push_back(triangleColors[t / 3]);
+        }
+    }
+    arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+    return true;
+}
+
+static bool parseGltf(const QJsonObject &gltf, const uint8_t* bin, size_t binSize,
+                      MeshArrays &arrays, glbreader::SkeletonData &skeleton, BackgroundTask* task) {
+    QJsonArray nodes = gltf["nodes"].toArray();
+    QJsonArray meshes = gltf["meshes"].toArray();
+    QJsonArray skins = gltf["skins"].toArray();
+
+    // the first skinned mesh, else the first mesh on a node, else the first mesh
+    int meshIndex = -1;
+    int skinIndex = -1;
+    for (int n = 0; n < nodes.size() && skinIndex < 0; ++n) {
+        QJsonObject node = nodes[n].toObject();
+        if (node.contains("mesh") && node.contains("skin")) {
+            meshIndex = node["mesh"].toInt(-1);
+            skinIndex = node["skin"].toInt(-1);
+        }
+    }
+    for (int n = 0; n < nodes.size() && meshIndex < 0; ++n) {
+        meshIndex = nodes[n].toObject()["mesh"].toInt(-1);
+    }
+    if (meshIndex < 0 && !meshes.isEmpty()) {
+        meshIndex = 0;
+    }
+    if (meshIndex < 0 || meshIndex >= meshes.size() || skinIndex >= skins.size()) {
+        return false;
+    }
+
+    // the weights refer to the skeleton, so it comes first
+    std::vector<int> jointOf;
+    skeleton.joints.clear();
+    if (skinIndex >= 0 && !readSkeleton(gltf, skins[skinIndex].toObject(), bin, binSize, skeleton, jointOf)) {
+        return false;
+    }
+    if (task != nullptr) {
+        task->setProgress(30);
+    }
+    return readMesh(gltf, meshes[meshIndex].toObject(), jointOf, bin, binSize, arrays, task);
+}
+
+bool glbreader::read(const QString &path, MeshArrays &arrays, SkeletonData &skeleton, BackgroundTask* task) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    if (size < 20) {
+        return false;
+    }
+    const uchar* data = file.map(0, size);
+    if (data == nullptr) {
+        return false;
+    }
+
+    // 12-byte header, then the JSON chunk and (usually) the BIN chunk
+    bool ok = false;
+    uint32_t header[3];
+    uint32_t chunk[2];
+    std::memcpy(header, data, sizeof(header));
+    std::memcpy(chunk, data + 12, sizeof(chunk));
+    // a declared length past the end of the file (or short of the first chunk
+    // header) means a truncated or broken file; every chunk is then checked as
+    // start + 8 + chunk length <= length, with the subtractions kept from wrapping
+    size_t length = header[2];
+    if (header[0] == GLB_MAGIC && header[1] == 2 && length >= 20 && length <= (size_t) size
+            && chunk[1] == CHUNK_JSON && chunk[0] <= length - 20) {
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(
+                    QByteArray::fromRawData((const char*) data + 20, (int) chunk[0]), &error);
+
+        const uint8_t* bin = nullptr;
+        size_t binSize = 0;
+        size_t offset = 20 + chunk[0];
+        if (offset + 8 <= length) {
+            std::memcpy(chunk, data + offset, sizeof(chunk));
+            if (chunk[1] == CHUNK_BIN && chunk[0] <= length - offset - 8) {
+                bin = data + offset + 8;
+                binSize = chunk[0];
+            }
+        }
+        ok = error.error == QJsonParseError::NoError && doc.isObject() && !cancelled(task)
+                && parseGltf(doc.object(), bin, binSize, arrays, skeleton, task);
+    }
+    file.unmap((uchar*) data);
+    return ok;
+}
@@ -0,0 +1,48 @@
+#ifndef GLBREADER_H
+#define GLBREADER_H
+
+#include "mesharrays.h"
+#include <la.h>
+#include <glm/gtc/quaternion.hpp>
+#include <QString>
+#include <vector>
+
+class BackgroundTask;
+
+/// Binary glTF 2.0 (.glb) reader for a skinned mesh and its skeleton.
+///
+/// The file is memory-mapped; the JSON chunk is parsed with QJsonDocument and
+/// every accessor is read straight out of the mapped BIN chunk through its
+/// buffer view (tightly packed float positions and uint32 indices with
+/// memcpy). The mesh is the one on the first node that has both a mesh and a
+/// skin (or the first mesh at all); all of its triangle primitives are
+/// merged, vertices at bit-identical positions are welded (glTF splits them
+/// along UV and normal seams), and JOINTS_0 / WEIGHTS_0 become per-vertex skin
+/// weights indexing the returned joints. The joints are the skin's nodes with
+/// their rest translation and rotation relative to the nearest joint above
+/// them (scale is dropped) and the skin's inverse bind matrices; when the
+/// skin has several roots, a "root" joint at the origin is added above them.
+/// Faces take their material's base color factor if any material has one.
+/// Given the task it runs on, the read stops early (and fails) once the task
+/// is cancelled.
+
+namespace glbreader {
+    struct JointData {
+        QString name;
+        int parent;             // index of the parent joint, -1 for the root
+        glm::vec3 translation;  // relative to the parent
+        glm::quat rotation;     // relative to the parent
+        glm::mat4 inverseBind;
+    };
+
+    struct SkeletonData {
+        // parents come before their children
+        std::vector<JointData> joints;
+    };
+
+    // read the skinned mesh of a .glb file; skeleton is left empty if the mesh
+    // has no skin
+    bool read(const QString &path, MeshArrays &arrays, SkeletonData &skeleton, BackgroundTask* task = nullptr);
+}
+
+#endif // GLBREADER_H
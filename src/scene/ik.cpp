@@ -0,0 +1,193 @@
+#include "ik.h"
+#include <algorithm>
+#include <cmath>
+
+// the shortest rotation taking direction a onto direction b (unit vectors)
+glm::quat ik::rotationBetween(const glm::vec3 &a, const glm::vec3 &b) {
+    float d = glm::dot(a, b);
+    glm::vec3 c = glm::cross(a, b);
+    if (d > -0.9f) {
+        // half-way quaternion: (1 + cos, sin * axis) normalizes to the half angle
+        return glm::normalize(glm::quat(1 + d, c.x, c.y, c.z));
+    }
+    // nearly opposite: 1 + d loses its precision, so go through the angle
+    float s = glm::length(c);
+    glm::vec3 axis;
+    if (s > 1e-6f) {
+        axis = c / s;
+    } else {
+        // exactly opposite: any axis perpendicular to a
+        axis = glm::cross(glm::vec3(1, 0, 0), a);
+        if (glm::dot(axis, axis) < 1e-6f) {
+            axis = glm::cross(glm::vec3(0, 1, 0), a);
+        }
+        axis = glm::normalize(axis);
+    }
+    return glm::angleAxis(std::atan2(s, d), axis);
+}
+
+// unit vector from a to b, or zero if they coincide
+static glm::vec3 direction(const glm::vec3 &a, const glm::vec3 &b) {
+    glm::vec3 v = b - a;
+    float len2 = glm::dot(v, v);
+    return len2 > 1e-12f ? v / std::sqrt(len2) : glm::vec3(0);
+}
+
+ik::Result ik::solveCCD(glm::vec3* positions, glm::quat* rotations, int count,
+                        const glm::vec3 &target, const Settings &settings) {
+    Result result = {0, 0};
+    if (count < 2) {
+        result.error = count == 1 ? glm::length(target - positions[0]) : 0;
+        return result;
+    }
+    int last = count - 1;
+    float tol2 = settings.tolerance * settings.tolerance;
+
+    for (; result.iterations < settings.maxIterations; ++result.iterations) {
+        glm::vec3 miss = target - positions[last];
+        if (glm::dot(miss, miss) <= tol2) {
+            break;
+        }
+        for (int i = last - 1; i >= 0; --i) {
+            glm::vec3 toEffector = direction(positions[i], positions[last]);
+            glm::vec3 toTarget = direction(positions[i], target);
+            if (toEffector == glm::vec3(0) || toTarget == glm::vec3(0)) {
+                continue;
+            }
+            glm::quat q = rotationBetween(toEffector, toTarget);
+
+            // swing everything below joint i about it
+            rotations[i] = glm::normalize(q * rotations[i]);
+            for (int j = i + 1; j < count; ++j) {
+                positions[j] = positions[i] + q * (positions[j] - positions[i]);
+                rotations[j] = q * rotations[j];
+            }
+        }
+    }
+    result.error = glm::length(target - positions[last]);
+    return result;
+}
+
+ik::Result ik::solveFABRIK(glm::vec3* positions, glm::quat* rotations, int count,
+                           const glm::vec3 &target, const Settings &settings) {
+    Result result = {0, 0};
+    if (count < 2) {
+        result.error = count == 1 ? glm::length(target - positions[0]) : 0;
+        return result;
+    }
+    int last = count - 1;
+
+    // bone lengths and the pose before solving (to recover rotations from)
+    float lengths[MAX_CHAIN];
+    glm::vec3 before[MAX_CHAIN];
+    float reach = 0;
+    for (int i = 0; i < count; ++i) {
+        before[i] = positions[i];
+        if (i < last) {
+            lengths[i] = glm::length(positions[i + 1] - positions[i]);
+            reach += lengths[i];
+        }
+    }
+
+    glm::vec3 root = positions[0];
+    float tol2 = settings.tolerance * settings.tolerance;
+    if (glm::length(target - root) >= reach) {
+        // out of reach: stretch the chain straight at the target
+        glm::vec3 dir = direction(root, target);
+        for (int i = 1; i < count; ++i) {
+            positions[i] = positions[i - 1] + dir * lengths[i - 1];
+        }
+        result.iterations = 1;
+    } else {
+        for (; result.iterations < settings.maxIterations; ++result.iterations) {
+            glm::vec3 miss = target - positions[last];
+            if (glm::dot(miss, miss) <= tol2) {
+                break;
+            }
+            // backward: pin the effector to the target
+            positions[last] = target;
+            for (int i = last - 1; i >= 0; --i) {
+                positions[i] = positions[i + 1] + direction(positions[i + 1], positions[i]) * lengths[i];
+            }
+            // forward: pin the root back in place
+            positions[0] = root;
+            for (int i = 1; i < count; ++i) {
+                positions[i] = positions[i - 1] + direction(positions[i - 1], positions[i]) * lengths[i - 1];
+            }
+        }
+    }
+
+    // each joint turns by the rotation that takes its old bone onto its new bone;
+    // the effector has no bone of its own and turns with its parent
+    glm::quat q(1, 0, 0, 0);
+    for (int i = 0; i < last; ++i) {
+        glm::vec3 oldDir = direction(before[i], before[i + 1]);
+        glm::vec3 newDir = direction(positions[i], positions[i + 1]);
+        if (oldDir != glm::vec3(0) && newDir != glm::vec3(0)) {
+            q = rotationBetween(oldDir, newDir);
+        }
+        rotations[i] = glm::normalize(q * rotations[i]);
+    }
+    rotations[last] = glm::normalize(q * rotations[last]);
+
+    result.error = glm::length(target - positions[last]);
+    return result;
+}
+
+/// IK HANDLE FUNCTIONS:
+
+// a handle on the effector bending at most length joints above it
+IKHandle::IKHandle(Joint* effector, int length) {
+    length = std::min(length, ik::MAX_CHAIN - 1);
+    for (Joint* jt = effector; jt != nullptr && (int) chain.size() <= length; jt = jt->getParent()) {
+        chain.push_back(jt);
+    }
+    std::reverse(chain.begin(), chain.end());
+    target = glm::vec3(effector->getWorldPosition());
+}
+
+// getter for the end effector
+Joint* IKHandle::getEffector() const {
+    return chain.back();
+}
+
+// getter for the target
+glm::vec3 IKHandle::getTarget() const {
+    return target;
+}
+
+// setter for the target
+void IKHandle::setTarget(const glm::vec3 &t) {
+    target = t;
+}
+
+// pose the chain so the effector reaches for the target
+ik::Result IKHandle::solve(ik::Solver solver, const ik::Settings &settings) {
+    int n = (int) chain.size();
+    positions.resize(n);
+    rotations.resize(n);
+
+    // joints only rotate and translate, so the world rotation is the
+    // rotation part of the overall transformation
+    for (int i = 0; i < n; ++i) {
+        glm::mat4 world = chain[i]->getOverallTransformation();
+        positions[i] = glm::vec3(world[3]);
+        rotations[i] = glm::quat_cast(glm::mat3(world));
+    }
+
+    ik::Result result = solver == ik::FABRIK
+            ? ik::solveFABRIK(positions.data(), rotations.data(), n, target, settings)
+            : ik::solveCCD(positions.data(), rotations.data(), n, target, settings);
+
+    // local rotation = parent's world rotation^-1 * world rotation; the chain's
+    // root keeps its parent, whose world rotation the solve didn't touch
+    Joint* rootParent = chain[0]->getParent();
+    glm::quat parentRot = rootParent != nullptr
+            ? glm::quat_cast(glm::mat3(rootParent->getOverallTransformation()))
+            : glm::quat(1, 0, 0, 0);
+    for (int i = 0; i < n; ++i) {
+        chain[i]->setQuat(glm::normalize(glm::inverse(parentRot) * rotations[i]));
+        parentRot = rotations[i];
+    }
+    return result;
+}
@@ -0,0 +1,80 @@
+#ifndef IK_H
+#define IK_H
+
+#include "joint.h"
+#include <la.h>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+/// Inverse kinematics.
+///
+/// The solvers work on a chain pulled out of the hierarchy into flat arrays of
+/// world positions and world rotations, root first and end effector last, and
+/// move the end effector towards a target without changing any bone length:
+///  - CCD rotates one joint at a time, from the effector's parent up to the
+///    root, so that the effector points at the target.
+///  - FABRIK moves the joint positions back from the target and forward from
+///    the root, then recovers each joint's rotation from its bone direction.
+/// Both stop as soon as the effector is within the tolerance of the target, or
+/// after the iteration cap.
+
+namespace ik {
+    enum Solver { CCD, FABRIK };
+
+    // longest chain the solvers take (chains are a handful of joints,
+    // so the solvers keep their scratch space on the stack)
+    static const int MAX_CHAIN = 32;
+
+    struct Settings {
+        int maxIterations;
+        float tolerance;    // distance from the target that counts as reached
+
+        Settings() : maxIterations(16), tolerance(1e-3f) {}
+    };
+
+    struct Result {
+        int iterations;
+        float error;        // final distance from the effector to the target
+    };
+
+    // solve a chain of count (<= MAX_CHAIN) joints in place
+    Result solveCCD(glm::vec3* positions, glm::quat* rotations, int count,
+                    const glm::vec3 &target, const Settings &settings);
+    Result solveFABRIK(glm::vec3* positions, glm::quat* rotations, int count,
+                       const glm::vec3 &target, const Settings &settings);
+
+    // the shortest rotation taking direction a onto direction b (unit vectors)
+    glm::quat rotationBetween(const glm::vec3 &a, const glm::vec3 &b);
+}
+
+/// IK HANDLE CLASS:
+/// an end effector joint, the chain of ancestors it can bend and a target.
+/// solve() reads the chain's world transformations once, runs a solver on
+/// the flat copies and writes one local quaternion back into each joint.
+
+class IKHandle {
+private:
+    std::vector<Joint*> chain;      // root of the chain first, effector last
+    glm::vec3 target;
+
+    // scratch arrays reused between solves
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+
+public:
+    // a handle on the effector bending at most length joints above it
+    // (fewer if the root comes first); the target starts at the effector
+    IKHandle(Joint* effector, int length);
+
+    // getter for the end effector
+    Joint* getEffector() const;
+
+    // getter and setter for the target
+    glm::vec3 getTarget() const;
+    void setTarget(const glm::vec3 &t);
+
+    // pose the chain so the effector reaches for the target
+    ik::Result solve(ik::Solver solver, const ik::Settings &settings = ik::Settings());
+};
+
+#endif // IK_H
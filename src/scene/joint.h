@@ -3,10 +3,10 @@
 
 #include <QString>
 #include <QTreeWidgetItem>
+#include <QSet>
 #include <la.h>
-#include "drawable.h"
 
-class Joint : public Drawable, public QTreeWidgetItem {
+class Joint : public QTreeWidgetItem {
 
 private:
     // the name of this joint which will be displayed in the QTreeWidget of joints
@@ -28,6 +28,12 @@ private:
     // the time a mesh is bound to the joint's skeleton
     glm::mat4 bindMatrix;
 
+    // cached local and overall transformations, recomputed lazily when dirty
+    mutable glm::mat4 localTransform;
+    mutable glm::mat4 worldTransform;
+    mutable bool localDirty;
+    mutable bool worldDirty;
+
     // has the joint been selected in GUI?
     bool selected;
 
@@ -39,7 +45,7 @@ public:
     static int idCount;
 
     // constructor
-    Joint(QString str, Joint* prt, glm::vec4 pos, glm::quat quat, GLWidget277 *context);
+    Joint(QString str, Joint* prt, glm::vec4 pos, glm::quat quat);
 
     // add child to the set of children
     void addChild(Joint *child);
@@ -49,6 +55,7 @@ public:
 
     // set bind matrix
     void setBindMatrix();
+    void setBindMatrix(const glm::mat4 &bind);
 
     // set quat
     void setQuat(const glm::quat quat);
@@ -59,6 +66,9 @@ public:
     // the joint has been selected
     void setSelected(const bool pressed);
 
+    // getter for name
+    QString getName() const;
+
     // getter for parent
     Joint* getParent() const;
 
@@ -79,7 +89,7 @@ public:
     int getID();
 
     // reset id
-    void resetID();
+    static void resetID();
 
     // returns a mat4 that represents the concatenation of a joint's position and rotation
     glm::mat4 getLocalTransformation() const;
@@ -88,12 +98,12 @@ public:
     // with the transformations of its chain of parent joints
     glm::mat4 getOverallTransformation() const;
 
-    // change draw mode
-    virtual GLenum drawMode() override;
-
-    // create joint drawing
-    virtual void create() override;
+    // flag the overall transformation of this joint and all its descendants as stale
+    void invalidateWorld();
 
+    // recompute every stale transformation of a skeleton in one pass;
+    // joints must come after their parents (as loaded)
+    static void updateTransforms(const std::vector<Joint*> &skeleton);
 };
 
 #endif // JOINT_H
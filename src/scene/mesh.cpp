@@ -1,13 +1,21 @@
 #include "mesh.h"
+#include "normals.h"
 #include <iostream>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 // constructor
-Mesh::Mesh(GLWidget277 *context) : Drawable(context)
+Mesh::Mesh(GLWidget277 *context) : Drawable(context),
+    cacheOptimized(true)
 {}
 
 Mesh::~Mesh() {
+    // the chunks own GPU buffers of their own, freed before they go
+    clearChunks();
+
     for (Vertex* v : vertices) {
         delete v;
     }
@@ -36,6 +44,11 @@ void Mesh::setHEs(const std::vector<HalfEdge*> hes) {
     halfedges = hes;
 }
 
+// turn the vertex cache optimization of the uploaded index buffer on or off
+void Mesh::setCacheOptimization(bool optimize) {
+    cacheOptimized = optimize;
+}
+
 // get vertices
 std::vector<Vertex*> Mesh::getVerts() const {
     return vertices;
@@ -51,9 +64,100 @@ std::vector<HalfEdge*> Mesh::getHEs() const {
     return halfedges;
 }
 
+// flatten the half-edge structure into index arrays
+void Mesh::getArrays(MeshArrays &arrays) const {
+    // number the vertices by their position in the vertex list
+    std::unordered_map<const Vertex*, uint32_t> vertIdx;
+    vertIdx.reserve(vertices.size());
+
+    arrays.positions.clear();
+    arrays.positions.reserve(vertices.size());
+    arrays.skinWeights.clear();
+    arrays.skinWeights.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertIdx[vertices[i]] = (uint32_t) i;
+        arrays.positions.push_back(vertices[i]->getCoord());
+        arrays.skinWeights.push_back(vertices[i]->getSkinWeights());
+    }
+
+    arrays.faceOffsets.clear();
+    arrays.faceOffsets.reserve(faces.size() + 1);
+    arrays.faceColors.clear();
+    arrays.faceColors.reserve(faces.size());
+    arrays.corners.clear();
+    arrays.corners.reserve(halfedges.size());
+
+    for (Face* f : faces) {
+        arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+        arrays.faceColors.push_back(f->getColor());
+
+        // loop around face and add the vertex indices
+        HalfEdge* start = f->getHE();
+        HalfEdge* e = start;
+        do {
+            arrays.corners.push_back(vertIdx[e->getVert()]);
+            e = e->getNextHE();
+        } while (e != start);
+    }
+    arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+}
+
+// replace the half-edge structure with one built from index arrays
+connectivity::Report Mesh::setArrays(const MeshArrays &arrays) {
+    connectivity::Links links;
+    connectivity::build(arrays.faceOffsets, arrays.corners, arrays.positions.size(), links);
+    setArrays(arrays, links);
+    return links.report;
+}
+
+// replace the half-edge structure with one built from index arrays and links
+// that were built from them before
+void Mesh::setArrays(const MeshArrays &arrays, const connectivity::Links &links) {
+    // the elements are list widget items with running ids, so they're made in order
+    std::vector<Vertex*> verts;
+    verts.reserve(arrays.positions.size());
+    bool skinned = arrays.skinWeights.size() == arrays.positions.size();
+    for (size_t v = 0; v < arrays.positions.size(); ++v) {
+        verts.push_back(new Vertex(arrays.positions[v]));
+        if (skinned) {
+            verts.back()->setSkinWeights(arrays.skinWeights[v]);
+        }
+    }
+
+    std::vector<Face*> fs;
+    size_t faceCount = arrays.faceCount();
+    fs.reserve(faceCount);
+    for (size_t f = 0; f < faceCount; ++f) {
+        fs.push_back(new Face(f < arrays.faceColors.size() ? arrays.faceColors[f]
+                                                            : glm::vec4(1, 1, 1, 1)));
+    }
+
+    std::vector<HalfEdge*> hes;
+    hes.reserve(arrays.corners.size());
+    for (size_t h = 0; h < arrays.corners.size(); ++h) {
+        hes.push_back(new HalfEdge(fs[links.face[h]], verts[arrays.corners[h]]));
+    }
+
+    for (size_t h = 0; h < hes.size(); ++h) {
+        HalfEdge* he = hes[h];
+        he->setNextHE(hes[links.next[h]]);
+        if (links.sym[h] != connectivity::NONE) {
+            he->setSymHE(hes[links.sym[h]]);
+        }
+        he->getVert()->setEdge(he);
+    }
+    for (size_t f = 0; f < faceCount; ++f) {
+        fs[f]->setHE(hes[arrays.faceOffsets[f]]);
+    }
+
+    vertices = verts;
+    faces = fs;
+    halfedges = hes;
+}
+
 // split edge
 void Mesh::splitEdge(HalfEdge* he) {
-    glm::vec4 start = he->getSymHE()->getVert()->getCoord();
+    glm::vec4 start = he->getStartVert()->getCoord();
     glm::vec4 end = he->getVert()->getCoord();
 
     glm::vec4 newPos = glm::vec4((start[0] + end[0]) / 2,
@@ -396,25 +500,38 @@ void Mesh::subdivide(std::vector<Face*> &addedFaces,
     // set of halfedges which we've already gone through
     QSet<HalfEdge*> completedHEs;
 
+    // vertices on open boundaries (edges with a face on one side only)
+    std::set<Vertex*> boundaryVerts;
+
     // go through each half edge
     for (HalfEdge* he : halfedges) {
+        HalfEdge* sym = he->getSymHE();
         // only do edges which we have not yet gone through!
-        if(!completedHEs.contains(he) && !completedHEs.contains(he->getSymHE())) {
+        if(!completedHEs.contains(he) && (sym == nullptr || !completedHEs.contains(sym))) {
 
             completedHEs.insert(he);
-            completedHEs.insert(he->getSymHE());
+            if (sym != nullptr) {
+                completedHEs.insert(sym);
+            }
 
             // get v1, v2, f1, and f2
             // vertices at each end
-            glm::vec4 v1 = he->getSymHE()->getVert()->getCoord();
+            Vertex* startV = he->getStartVert();
+            glm::vec4 v1 = startV->getCoord();
             glm::vec4 v2 = he->getVert()->getCoord();
 
-            // centroids
-            glm::vec4 f1 = faceToCentroid[he->getFace()]->getCoord();
-            glm::vec4 f2 = faceToCentroid[he->getSymHE()->getFace()]->getCoord();
-
-            glm::vec4 midPos = v1 + v2 + f1 + f2;
-            midPos /= 4;
+            // a boundary edge is split at its middle, an inner edge also
+            // averages in the centroids on both sides
+            glm::vec4 midPos;
+            if (sym == nullptr) {
+                midPos = (v1 + v2) / 2.f;
+                boundaryVerts.insert(startV);
+                boundaryVerts.insert(he->getVert());
+            } else {
+                glm::vec4 f1 = faceToCentroid[he->getFace()]->getCoord();
+                glm::vec4 f2 = faceToCentroid[sym->getFace()]->getCoord();
+                midPos = (v1 + v2 + f1 + f2) / 4.f;
+            }
 
             // create midpoint vertex from calculated position
             Vertex* midVert = new Vertex(midPos);
@@ -426,7 +543,7 @@ void Mesh::subdivide(std::vector<Face*> &addedFaces,
                 if (i == 0) {
                     currVert = he->getVert();
                 } else {
-                    currVert= he->getSymHE()->getVert();
+                    currVert = startV;
                 }
 
                 std::vector<Vertex*> currMids = std::vector<Vertex*>();
@@ -443,12 +560,12 @@ void Mesh::subdivide(std::vector<Face*> &addedFaces,
             }
 
             // map current midpoint to the faces it belongs to
-            for (int i = 0; i < 2; ++i) {
+            for (int i = 0; i < (sym != nullptr ? 2 : 1); ++i) {
                 Face* currFace;
                 if (i == 0) {
                     currFace = he->getFace();
                 } else {
-                    currFace= he->getSymHE()->getFace();
+                    currFace = sym->getFace();
                 }
 
                 QSet<Vertex*> currMids = QSet<Vertex*>();
@@ -465,38 +582,36 @@ void Mesh::subdivide(std::vector<Face*> &addedFaces,
             }
 
             // create new HEs pointing towards the original vertices
+            // (only on the side that has a face for a boundary edge)
             HalfEdge* newHE1 = new HalfEdge(he->getFace(), he->getVert());
-            HalfEdge* newHE2 = new HalfEdge(he->getSymHE()->getFace(), he->getSymHE()->getVert());
-
-            // get the current half edge's next HE
             HalfEdge* next1 = he->getNextHE();
-            HalfEdge* next2 = he->getSymHE()->getNextHE();
-
-            // set old HEs to point to the midpoints
             he->setVert(midVert);
-            he->getSymHE()->setVert(midVert);
-
-            // set old HEs to have the new HEs as their next HEs
             he->setNextHE(newHE1);
-            he->getSymHE()->setNextHE(newHE2);
-
-            // set new HEs to have the next HEs of the old HEs
             newHE1->setNextHE(next1);
-            newHE2->setNextHE(next2);
-
-            // set sym pointers
-            newHE1->setSymHE(he->getSymHE());
-            newHE2->setSymHE(he);
-
-            // add them to the vectors
             midpoints.push_back(midVert);
             newHEs.push_back(newHE1);
-            newHEs.push_back(newHE2);
+
+            if (sym != nullptr) {
+                HalfEdge* newHE2 = new HalfEdge(sym->getFace(), sym->getVert());
+                HalfEdge* next2 = sym->getNextHE();
+                sym->setVert(midVert);
+                sym->setNextHE(newHE2);
+                newHE2->setNextHE(next2);
+
+                // set sym pointers
+                newHE1->setSymHE(sym);
+                newHE2->setSymHE(he);
+                newHEs.push_back(newHE2);
+            }
         }
     }
 
     // STEP 5: SMOOTH VERTICES
+    // (boundary vertices stay where they are, so open borders don't shrink)
     for (Vertex* v : vertices) {
+        if (boundaryVerts.count(v) != 0) {
+            continue;
+        }
         if (v->getID() == 28) {
             int x = 0;
         }
@@ -573,14 +688,15 @@ void Mesh::extrude(Face* face,
     }
 
     // STEP 2: calculate face normal
-    glm::vec4 p1 = faceVerts.at(0)->getCoord();
-    glm::vec4 p2 = faceVerts.at(1)->getCoord();
-    glm::vec4 p3 = faceVerts.at(2)->getCoord();
-    glm::vec4 side1 = p2 - p1;
-    glm::vec4 side2 = p3 - p2;
-    glm::vec3 cross = glm::normalize(glm::cross(glm::vec3(side1[0], side1[1], side1[2]),
-            glm::vec3(side2[0], side2[1], side2[2])));
-    glm::vec4 norm = glm::vec4(cross[0], cross[1], cross[2], 0);
+    std::vector<glm::vec4> facePos;
+    std::vector<uint32_t> faceCorners;
+    for (Vertex* v : faceVerts) {
+        faceCorners.push_back((uint32_t) facePos.size());
+        facePos.push_back(v->getCoord());
+    }
+    uint32_t faceOffsets[2] = {0, (uint32_t) faceCorners.size()};
+    glm::vec4 norm;
+    normals::faceNormals(&facePos[0][0], faceOffsets, faceCorners.data(), 1, &norm[0]);
 
     // STEP 3: create new vertices which have been extruded along normal
     std::vector<Vertex*> extrudedVerts = std::vector<Vertex*>();
@@ -618,9 +734,11 @@ void Mesh::extrude(Face* face,
         // set face HE pointer
         newFace->setHE(newHE1);
 
-        // set sym pointers
+        // set sym pointers (an extruded boundary edge stays a boundary on the outside)
         curr->setSymHE(newHE1);
-        currSym->setSymHE(newHE2);
+        if (currSym != nullptr) {
+            currSym->setSymHE(newHE2);
+        }
 
         // add to vectors
         newFaces.push_back(newFace);
@@ -688,137 +806,186 @@ void Mesh::extrude(Face* face,
 
 
 
-// get mesh positions
-void setup(std::vector<Face*> &faces,
-           std::vector<GLuint> &idx,
-           std::vector<glm::vec4> &positions,
-           std::vector<glm::vec4> &normals,
-           std::vector<glm::vec4> &colors,
-           std::vector<glm::ivec2> &joints,
-           std::vector<glm::vec2> &influences) {
+// spread the lower 10 bits of x so there are two zero bits between each
+static uint32_t expandBits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
 
-    // set up startID for each face for triangulization
-    int startID = 0;
+// destroy and free the chunks
+void Mesh::clearChunks() {
+    for (MeshChunk* chunk : chunks) {
+        chunk->destroy();
+        delete chunk;
+    }
+    chunks.clear();
+    faceToChunk.clear();
+}
 
-    // go through the faces
-    for (Face* f : faces) {
-        // get start edge
-        HalfEdge* start = f->getHE();
+void Mesh::destroy() {
+    Drawable::destroy();
+    clearChunks();
+}
 
-        // get the positions on the face, for normalization
-        std::vector<glm::vec4> facePos;
+void Mesh::create() {
+    /// split the mesh into chunks of at most MeshChunk::MAX_VERTS corners (or
+    /// of one face that has more):
+    /// faces are sorted along a Morton (Z-order) curve through their centroids,
+    /// so consecutive runs of faces are close together in space
+    clearChunks();
+
+    MeshArrays arrays;
+    getArrays(arrays);
+    size_t faceCount = arrays.faceCount();
+    if (faceCount == 0) {
+        return;
+    }
+
+    // centroids and their bounding box
+    std::vector<glm::vec3> centroids(faceCount);
+    glm::vec3 lo(HUGE_VALF);
+    glm::vec3 hi(-HUGE_VALF);
+    for (size_t f = 0; f < faceCount; ++f) {
+        glm::vec3 c(0);
+        for (uint32_t i = arrays.faceOffsets[f]; i < arrays.faceOffsets[f + 1]; ++i) {
+            c += glm::vec3(arrays.positions[arrays.corners[i]]);
+        }
+        c /= (float) (arrays.faceOffsets[f + 1] - arrays.faceOffsets[f]);
+        centroids[f] = c;
+        lo = glm::min(lo, c);
+        hi = glm::max(hi, c);
+    }
+
+    // morton code of each face
+    glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+    std::vector<std::pair<uint32_t, uint32_t>> order(faceCount);
+    for (size_t f = 0; f < faceCount; ++f) {
+        glm::vec3 q = (centroids[f] - lo) / extent * 1023.f;
+        uint32_t code = (expandBits((uint32_t) q.x) << 2)
+                      | (expandBits((uint32_t) q.y) << 1)
+                      | expandBits((uint32_t) q.z);
+        order[f] = std::make_pair(code, (uint32_t) f);
+    }
+    std::sort(order.begin(), order.end());
+
+    // cut the curve into chunks
+    std::vector<Face*> chunkFaces;
+    size_t chunkCorners = 0;
+    for (size_t i = 0; i <= faceCount; ++i) {
+        size_t corners = 0;
+        if (i < faceCount) {
+            uint32_t f = order[i].second;
+            corners = arrays.faceOffsets[f + 1] - arrays.faceOffsets[f];
+        }
 
-        // get face vertices
-        std::vector<Vertex*> faceVert;
+        // a face with more corners than fit in a chunk gets one of its own
+        // (with 32-bit indices); no chunk is ever left empty
+        if (!chunkFaces.empty() && (i == faceCount || chunkCorners + corners > MeshChunk::MAX_VERTS)) {
+            MeshChunk* chunk = new MeshChunk(mp_context);
+            chunk->setFaces(chunkFaces);
+            chunk->setCacheOptimization(cacheOptimized);
+            chunk->create();
+            for (Face* f : chunkFaces) {
+                faceToChunk[f] = chunk;
+            }
+            chunks.push_back(chunk);
+            chunkFaces.clear();
+            chunkCorners = 0;
+        }
 
-        // push back first position
-        positions.push_back(start->getVert()->getCoord());
-        facePos.push_back(start->getVert()->getCoord());
-        faceVert.push_back(start->getVert());
+        if (i < faceCount) {
+            chunkFaces.push_back(faces[order[i].second]);
+            chunkCorners += corners;
+        }
+    }
+}
 
-        // count number of vertices on face
-        int verts = 1;
+// get chunks
+const std::vector<MeshChunk*> &Mesh::getChunks() const {
+    return chunks;
+}
 
-        // loop around face and add the vertex positions
-        for (HalfEdge* e = start->getNextHE(); e != start; e = e->getNextHE()) {
-            positions.push_back(e->getVert()->getCoord());
-            facePos.push_back(e->getVert()->getCoord());
-            faceVert.push_back(e->getVert());
-            verts++;
+// re-upload only the chunks drawing the given faces
+void Mesh::updateFaces(const std::set<Face*> &changed) {
+    std::set<MeshChunk*> dirty;
+    for (Face* f : changed) {
+        auto found = faceToChunk.find(f);
+        if (found == faceToChunk.end()) {
+            // a face we have never uploaded: the topology changed, start over
+            destroy();
+            create();
+            return;
         }
+        dirty.insert(found->second);
+    }
 
-        for (Vertex* v : faceVert) {
-            std::vector<Joint*> jts = v->getJoints();
-            std::vector<float> inf = v->getInfluence();
-            if (jts.size() != 0) {
-                joints.push_back(glm::ivec2(jts.at(0)->getID(), jts.at(1)->getID()));
-                influences.push_back(glm::vec2(inf.at(0), inf.at(1)));
-            }
-        }
+    for (MeshChunk* chunk : dirty) {
+        chunk->destroy();
+        chunk->create();
+    }
+}
 
-        // set triangulization indices
-        for (int i = 0; i < verts - 2; ++i) {
-            idx.push_back(startID);
-            idx.push_back(startID + i + 1);
-            idx.push_back(startID + i + 2);
-        }
-        // increment startID to have number of vertices of last face indexed
-        startID += verts;
-
-        for (int i = 0; i < verts; ++i) {
-            // set color for each vertex on the face
-            colors.push_back(f->getColor());
-
-            // calculate normal per vertex
-            glm::vec4 p1;
-            glm::vec4 p2;
-            glm::vec4 p3;
-            if (i == 0) {
-                p1 = facePos.at(i + verts - 1);
-                p2 = facePos.at(i);
-                p3 = facePos.at(i + 1);
-            } else if (i % verts == verts - 1) {
-                p1 = facePos.at(i - 1);
-                p2 = facePos.at(i);
-                p3 = facePos.at(i - verts + 1);
-            } else {
-                p1 = facePos.at(i - 1);
-                p2 = facePos.at(i);
-                p3 = facePos.at(i + 1);
-            }
-            glm::vec4 side1 = p2 - p1;
-            glm::vec4 side2 = p3 - p2;
-            glm::vec3 cross = glm::normalize(glm::cross(glm::vec3(side1[0], side1[1], side1[2]),
-                    glm::vec3(side2[0], side2[1], side2[2])));
-            glm::vec4 norm = glm::vec4(cross[0], cross[1], cross[2], 0);
-            normals.push_back(norm);
+// a vertex moved: re-upload the chunks of the faces around it
+void Mesh::updateVertex(Vertex* v) {
+    std::set<Face*> changed;
+
+    // walk around the vertex: (HE into v) > next (out of v) > sym (into v again)
+    HalfEdge* start = v->getEdge();
+    HalfEdge* he = start;
+    bool valid = start != nullptr && start->getVert() == v;
+    for (size_t steps = 0; valid; ++steps) {
+        changed.insert(he->getFace());
+        he = he->getNextHE()->getSymHE();
+        if (he == start) {
+            break;
         }
+        // open boundary or stale pointers: can't trust the walk
+        valid = he != nullptr && he->getVert() == v && steps < halfedges.size();
+    }
+
+    if (valid) {
+        updateFaces(changed);
+    } else {
+        destroy();
+        create();
     }
 }
 
-void Mesh::create() {
-    std::vector<GLuint> mesh_idx;
-    std::vector<glm::vec4> mesh_vert_pos;
-    std::vector<glm::vec4> mesh_vert_nor;
-    std::vector<glm::vec4> mesh_vert_col;
-    std::vector<glm::ivec2> mesh_vert_jt;
-    std::vector<glm::vec2> mesh_vert_inf;
-
-    setup(faces, mesh_idx, mesh_vert_pos, mesh_vert_nor, mesh_vert_col, mesh_vert_jt, mesh_vert_inf);
-
-    count = mesh_idx.size();
-
-    // Create a VBO on our GPU and store its handle in bufIdx
-    generateIdx();
-    // Tell OpenGL that we want to perform subsequent operations on the VBO referred to by bufIdx
-    // and that it will be treated as an element array buffer (since it will contain triangle indices)
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
-    // Pass the data stored in cyl_idx into the bound buffer, reading a number of bytes equal to
-    // CYL_IDX_COUNT multiplied by the size of a GLuint. This data is sent to the GPU to be read by shader programs.
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_idx.size() * sizeof(GLuint), mesh_idx.data(), GL_STATIC_DRAW);
-
-    // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
-    // array buffers rather than element array buffers, as they store vertex attributes like position.
-    generatePos();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_pos.size() * sizeof(glm::vec4), mesh_vert_pos.data(), GL_STATIC_DRAW);
-
-    generateCol();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_col.size() * sizeof(glm::vec4), mesh_vert_col.data(), GL_STATIC_DRAW);
-
-    generateNor();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_nor.size() * sizeof(glm::vec4), mesh_vert_nor.data(), GL_STATIC_DRAW);
-
-    generateJtID();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJtID);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_jt.size() * sizeof(glm::ivec2), mesh_vert_jt.data(), GL_STATIC_DRAW);
-
-    generateJtInf();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJtInf);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_inf.size() * sizeof(glm::vec2), mesh_vert_inf.data(), GL_STATIC_DRAW);
+// a face changed color: re-upload its chunk
+void Mesh::updateFace(Face* f) {
+    updateFaces({f});
 }
 
+// replace the drawn positions of every vertex
+bool Mesh::uploadPositions(const glm::vec4* positions, size_t count) {
+    if (count != vertices.size()) {
+        return false;
+    }
 
+    // chunks (re)created since the last upload need their vertices' indices
+    bool lookup = false;
+    for (MeshChunk* chunk : chunks) {
+        lookup = lookup || !chunk->hasSourceIDs();
+    }
+    if (lookup) {
+        std::unordered_map<const Vertex*, uint32_t> vertIdx;
+        vertIdx.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            vertIdx[vertices[i]] = (uint32_t) i;
+        }
+        for (MeshChunk* chunk : chunks) {
+            if (!chunk->hasSourceIDs()) {
+                chunk->setSourceIDs(vertIdx);
+            }
+        }
+    }
 
+    for (MeshChunk* chunk : chunks) {
+        chunk->uploadPositions(positions, positionStaging);
+    }
+    return true;
+}
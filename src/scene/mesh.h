@@ -3,7 +3,12 @@
 
 #include "drawable.h"
 #include "vertex.h"
+#include "mesharrays.h"
+#include "meshchunk.h"
+#include "connectivity.h"
 #include <la.h>
+#include <set>
+#include <unordered_map>
 
 class Mesh : public Drawable {
 
@@ -12,6 +17,20 @@ private:
     std::vector<Face*> faces;
     std::vector<HalfEdge*> halfedges;
 
+    // reorder the index buffer for the GPU vertex cache in create()?
+    bool cacheOptimized;
+
+    // the mesh is drawn in spatially coherent chunks with 16-bit indices (32-bit
+    // for a face too big for those)
+    std::vector<MeshChunk*> chunks;
+    std::unordered_map<Face*, MeshChunk*> faceToChunk;
+
+    // destroy and free the chunks
+    void clearChunks();
+
+    // scratch space for uploadPositions()
+    std::vector<glm::vec4> positionStaging;
+
 public:
     // constructor
     Mesh(GLWidget277* mp_context);
@@ -30,12 +49,28 @@ public:
     // get half edges
     std::vector<HalfEdge*> getHEs() const;
 
+    // turn the vertex cache optimization of the uploaded index buffer on or off
+    // (run on every create(), i.e. after each topology change and before upload)
+    void setCacheOptimization(bool optimize);
+
     // get vertices
     std::vector<Vertex*> getVerts() const;
 
     // get faces
     std::vector<Face*> getFaces() const;
 
+    // flatten the half-edge structure into index arrays
+    // (vertex i of the arrays is getVerts().at(i))
+    void getArrays(MeshArrays &arrays) const;
+
+    // replace the half-edge structure with one built from index arrays
+    // (faces without a color in the arrays are white); boundary and
+    // non-manifold edges are left without a sym and counted in the report
+    connectivity::Report setArrays(const MeshArrays &arrays);
+
+    // the same with links already built from the arrays (e.g. read from a cache)
+    void setArrays(const MeshArrays &arrays, const connectivity::Links &links);
+
     // split edge
     void splitEdge(HalfEdge* he);
 
@@ -53,8 +88,29 @@ public:
                  std::vector<Face *> &addedFaces,
                  std::vector<HalfEdge *> &addedHEs);
 
-    // create function
+    // get the chunks the mesh is drawn with
+    const std::vector<MeshChunk*> &getChunks() const;
+
+    // re-upload only the chunks drawing the given faces
+    void updateFaces(const std::set<Face*> &changed);
+
+    // a vertex moved: re-upload the chunks of the faces around it
+    void updateVertex(Vertex* v);
+
+    // a face changed color: re-upload its chunk
+    void updateFace(Face* f);
+
+    // replace the drawn positions of every vertex (vertex i is getVerts().at(i))
+    // without touching the half-edge structure, e.g. to play back a point cache;
+    // false if count isn't the vertex count. Normals stay as they are, and the
+    // next create() or edit draws the vertices where they really are again
+    bool uploadPositions(const glm::vec4* positions, size_t count);
+
+    // create function: splits the faces into chunks and uploads them
     virtual void create() override;
+
+    // frees the chunks too
+    virtual void destroy() override;
 };
 
 #endif // MESH_H
@@ -0,0 +1,48 @@
+#ifndef MESHARRAYS_H
+#define MESHARRAYS_H
+
+#include "skinweights.h"
+#include <la.h>
+#include <vector>
+#include <cstdint>
+
+/// MESH ARRAYS:
+/// flat, index-based copy of a polygon mesh. This is what the bulk kernels,
+/// importers and exporters work on instead of walking the half-edge pointers.
+
+struct MeshArrays {
+    // one position per vertex
+    std::vector<glm::vec4> positions;
+
+    // first corner of each face, plus one trailing entry holding the corner count
+    std::vector<uint32_t> faceOffsets;
+
+    // vertex index of each face corner, in half-edge order
+    std::vector<uint32_t> corners;
+
+    // one color per face
+    std::vector<glm::vec4> faceColors;
+
+    // one set of skin weights per vertex (or none at all)
+    std::vector<SkinWeights> skinWeights;
+
+    // one unit normal per vertex, w = 0 (or none at all; only exports fill it)
+    std::vector<glm::vec4> normals;
+
+    // number of faces
+    size_t faceCount() const {
+        return faceOffsets.empty() ? 0 : faceOffsets.size() - 1;
+    }
+
+    // raw float views of the positions (xyzw quadruples)
+    const float* positionData() const {
+        return positions.empty() ? nullptr : &positions[0][0];
+    }
+
+    // are there vertex normals to go with the positions?
+    bool hasNormals() const {
+        return !normals.empty() && normals.size() == positions.size();
+    }
+};
+
+#endif // MESHARRAYS_H
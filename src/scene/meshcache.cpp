@@ -0,0 +1,132 @@
+#include "meshcache.h"
+#include <sectionfile.h>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+static const char MAGIC[8] = {'M', 'M', 'M', 'E', 'S', 'H', 0, 0};
+
+// stamp of a file on disk
+meshcache::SourceStamp meshcache::stamp(const QString &path) {
+    QFileInfo info(path);
+    SourceStamp s;
+    s.bytes = (uint64_t) info.size();
+    s.modified = info.lastModified().toMSecsSinceEpoch();
+    return s;
+}
+
+// where the cache of an imported file lives
+QString meshcache::cachePath(const QString &sourcePath) {
+    // the user's cache directory, not the source's (which may be read-only or
+    // shared); the name only has to tell sources apart, since the stamp inside
+    // tells versions of one source apart
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dir.isEmpty()) {
+        dir = QDir::tempPath();
+    }
+    dir += "/meshes";
+    QDir().mkpath(dir);
+    QByteArray key = QCryptographicHash::hash(QFileInfo(sourcePath).absoluteFilePath().toUtf8(),
+                                              QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(key) + ".mmesh";
+}
+
+// write arrays and their links
+bool meshcache::save(const QString &path, const MeshArrays &arrays,
+                     const connectivity::Links &links, const SourceStamp* source) {
+    uint64_t report[2] = {links.report.boundaryEdges, links.report.nonManifoldEdges};
+
+    SectionWriter writer;
+    writer.add(POSITIONS, arrays.positions.data(), arrays.positions.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    writer.add(FACE_OFFSETS, arrays.faceOffsets.data(), arrays.faceOffsets.size() * sizeof(uint32_t), sizeof(uint32_t));
+    writer.add(CORNERS, arrays.corners.data(), arrays.corners.size() * sizeof(uint32_t), sizeof(uint32_t));
+    writer.add(NEXT, links.next.data(), links.next.size() * sizeof(uint32_t), sizeof(uint32_t));
+    writer.add(SYM, links.sym.data(), links.sym.size() * sizeof(uint32_t), sizeof(uint32_t));
+    writer.add(FACE_COLORS, arrays.faceColors.data(), arrays.faceColors.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    writer.add(SKIN_WEIGHTS, arrays.skinWeights.data(), arrays.skinWeights.size() * sizeof(SkinWeights), sizeof(SkinWeights));
+    writer.add(REPORT, report, sizeof(report), sizeof(uint64_t));
+    if (source != nullptr) {
+        writer.add(SOURCE, source, sizeof(SourceStamp), sizeof(SourceStamp));
+    }
+    return writer.write(path, MAGIC, VERSION);
+}
+
+// read a file written by save()
+bool meshcache::load(const QString &path, MeshArrays &arrays,
+                     connectivity::Links &links, const SourceStamp* source) {
+    SectionReader reader;
+    if (!reader.open(path, MAGIC, VERSION)) {
+        return false;
+    }
+
+    if (source != nullptr) {
+        std::vector<SourceStamp> stamps;
+        if (!reader.read(SOURCE, stamps) || stamps.size() != 1
+                || stamps[0].bytes != source->bytes || stamps[0].modified != source->modified) {
+            return false;
+        }
+    }
+
+    std::vector<uint64_t> report;
+    if (!reader.read(POSITIONS, arrays.positions)
+            || !reader.read(FACE_OFFSETS, arrays.faceOffsets)
+            || !reader.read(CORNERS, arrays.corners)
+            || !reader.read(NEXT, links.next)
+            || !reader.read(SYM, links.sym)
+            || !reader.read(FACE_COLORS, arrays.faceColors)
+            || !reader.read(SKIN_WEIGHTS, arrays.skinWeights)
+            || !reader.read(REPORT, report) || report.size() != 2) {
+        return false;
+    }
+    links.report.boundaryEdges = report[0];
+    links.report.nonManifoldEdges = report[1];
+
+    // the checksums rule out damage, not a writer bug: make sure every index
+    // is in range before anything dereferences it
+    return validate(arrays, links);
+}
+
+// check every index of arrays and links, and derive links.face from the offsets
+bool meshcache::validate(const MeshArrays &arrays, connectivity::Links &links) {
+    size_t vertCount = arrays.positions.size();
+    size_t heCount = arrays.corners.size();
+    size_t faceCount = arrays.faceCount();
+    if (arrays.faceOffsets.empty() || arrays.faceOffsets[0] != 0
+            || arrays.faceOffsets.back() != heCount
+            || links.next.size() != heCount || links.sym.size() != heCount
+            || (!arrays.faceColors.empty() && arrays.faceColors.size() != faceCount)
+            || (!arrays.skinWeights.empty() && arrays.skinWeights.size() != vertCount)) {
+        return false;
+    }
+
+    // the face of each half-edge is implied by the offsets
+    links.face.resize(heCount);
+    for (size_t f = 0; f < faceCount; ++f) {
+        uint32_t begin = arrays.faceOffsets[f];
+        uint32_t end = arrays.faceOffsets[f + 1];
+        if (end <= begin || end > heCount) {
+            return false;
+        }
+        for (uint32_t h = begin; h < end; ++h) {
+            links.face[h] = (uint32_t) f;
+        }
+    }
+    for (size_t h = 0; h < heCount; ++h) {
+        if (arrays.corners[h] >= vertCount || links.next[h] >= heCount
+                || (links.sym[h] >= heCount && links.sym[h] != connectivity::NONE)) {
+            return false;
+        }
+    }
+    // next stays in its face and sym pairs half-edges both ways, or walking
+    // the links of a damaged file would run off into other faces or loop
+    for (size_t h = 0; h < heCount; ++h) {
+        uint32_t sym = links.sym[h];
+        if (links.face[links.next[h]] != links.face[h]
+                || (sym != connectivity::NONE && (sym == h || links.sym[sym] != h))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "mesharrays.h"
+#include "connectivity.h"
+#include <QString>
+
+/// Native binary mesh format (.mmesh).
+///
+/// A section file holding the mesh arrays (positions, face offsets, corners,
+/// face colors, skin weights) together with the next/sym links built from
+/// them, so loading is a memory map, a checksum and a few memcpys: no text
+/// parsing and no connectivity pass. Imported files are cached in the user's
+/// cache directory under a hash of the source's absolute path, stamped with
+/// the source's size and modification time; a stale or damaged cache is
+/// simply ignored and rewritten.
+
+namespace meshcache {
+    static const uint32_t VERSION = 1;
+
+    enum Section : uint32_t {
+        POSITIONS = 1,      // glm::vec4 per vertex
+        FACE_OFFSETS,       // uint32 per face, plus the corner count
+        CORNERS,            // uint32 vertex index per corner
+        NEXT,               // uint32 per half-edge
+        SYM,                // uint32 per half-edge, connectivity::NONE on boundaries
+        FACE_COLORS,        // glm::vec4 per face
+        SKIN_WEIGHTS,       // SkinWeights per vertex
+        REPORT,             // boundary and non-manifold edge counts (2 x uint64)
+        SOURCE              // SourceStamp of the file the mesh was imported from
+    };
+
+    // identifies the version of a source file a cache was made from
+    struct SourceStamp {
+        uint64_t bytes;
+        int64_t modified;   // ms since the epoch
+    };
+
+    // stamp of a file on disk
+    SourceStamp stamp(const QString &path);
+
+    // where the cache of an imported file lives
+    QString cachePath(const QString &sourcePath);
+
+    // write arrays and their links; source (if given) is stamped into the file
+    bool save(const QString &path, const MeshArrays &arrays,
+              const connectivity::Links &links, const SourceStamp* source = nullptr);
+
+    // read a file written by save(); with a source stamp, only a cache made
+    // from exactly that source is accepted
+    bool load(const QString &path, MeshArrays &arrays,
+              connectivity::Links &links, const SourceStamp* source = nullptr);
+
+    // check that every index of arrays and links (next and sym) is in range,
+    // that next stays in its face and that sym is symmetric, and derive
+    // links.face from the face offsets
+    bool validate(const MeshArrays &arrays, connectivity::Links &links);
+}
+
+#endif // MESHCACHE_H
@@ -0,0 +1,303 @@
+#include "meshchunk.h"
+#include "mesharrays.h"
+#include "normals.h"
+#include "vertexcache.h"
+#include <unordered_map>
+#include <algorithm>
+
+// constructor
+MeshChunk::MeshChunk(GLWidget277 *context) : Drawable(context),
+    cacheOptimized(true),
+    wideIndices(false),
+    boundsMin(0),
+    boundsMax(0),
+    restVertices(false)
+{}
+
+MeshChunk::~MeshChunk() {
+}
+
+// set faces
+void MeshChunk::setFaces(const std::vector<Face*> &fs) {
+    faces = fs;
+}
+
+// get faces
+const std::vector<Face*> &MeshChunk::getFaces() const {
+    return faces;
+}
+
+// set vertex cache optimization
+void MeshChunk::setCacheOptimization(bool optimize) {
+    cacheOptimized = optimize;
+}
+
+// getters for the bounding box
+glm::vec3 MeshChunk::getBoundsMin() const {
+    return boundsMin;
+}
+
+glm::vec3 MeshChunk::getBoundsMax() const {
+    return boundsMax;
+}
+
+// getter for the influencing joint ids
+const std::vector<int> &MeshChunk::getJointIDs() const {
+    return jointIDs;
+}
+
+// have the mesh indices of the GPU vertices been looked up since the last create()?
+bool MeshChunk::hasSourceIDs() const {
+    return sourceIDs.size() == sourceVerts.size();
+}
+
+// look up the mesh index of the vertex each GPU vertex was made from
+void MeshChunk::setSourceIDs(const std::unordered_map<const Vertex*, uint32_t> &vertIdx) {
+    sourceIDs.resize(sourceVerts.size());
+    for (size_t i = 0; i < sourceVerts.size(); ++i) {
+        auto found = vertIdx.find(sourceVerts[i]);
+        sourceIDs[i] = found != vertIdx.end() ? found->second : 0;
+    }
+}
+
+// replace the GPU vertex positions with the given positions of the mesh vertices
+void MeshChunk::uploadPositions(const glm::vec4* meshPositions, std::vector<glm::vec4> &staging) {
+    staging.resize(sourceIDs.size());
+    for (size_t i = 0; i < sourceIDs.size(); ++i) {
+        staging[i] = meshPositions[sourceIDs[i]];
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, 0, staging.size() * sizeof(glm::vec4), staging.data());
+}
+
+// getter for whether some vertices keep (part of) their rest position
+bool MeshChunk::hasRestVertices() const {
+    return restVertices;
+}
+
+// chunks use GLushort indices unless they have too many vertices for them
+GLenum MeshChunk::indexType() {
+    return wideIndices ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+}
+
+// flatten a list of faces into index arrays over the vertices they use
+static void flattenFaces(const std::vector<Face*> &faces,
+                         MeshArrays &arrays,
+                         std::vector<Vertex*> &verts) {
+    std::unordered_map<const Vertex*, uint32_t> vertIdx;
+
+    arrays.faceOffsets.reserve(faces.size() + 1);
+    arrays.faceColors.reserve(faces.size());
+
+    for (Face* f : faces) {
+        arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+        arrays.faceColors.push_back(f->getColor());
+
+        HalfEdge* start = f->getHE();
+        HalfEdge* e = start;
+        do {
+            Vertex* v = e->getVert();
+            auto found = vertIdx.find(v);
+            if (found == vertIdx.end()) {
+                found = vertIdx.insert(std::make_pair(v, (uint32_t) verts.size())).first;
+                verts.push_back(v);
+                arrays.positions.push_back(v->getCoord());
+            }
+            arrays.corners.push_back(found->second);
+            e = e->getNextHE();
+        } while (e != start);
+    }
+    arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+}
+
+// get mesh positions
+void setup(const std::vector<Vertex*> &vertices,
+           const MeshArrays &arrays,
+           bool optimize,
+           std::vector<GLuint> &idx,
+           std::vector<glm::vec4> &positions,
+           std::vector<glm::vec4> &vertNormals,
+           std::vector<glm::vec4> &colors,
+           std::vector<SkinWeights> &skins,
+           std::vector<Vertex*> &sources) {
+
+    size_t faceCount = arrays.faceCount();
+    size_t cornerCount = arrays.corners.size();
+
+    // corner normals for all the faces in one pass
+    std::vector<glm::vec4> cornerNor(cornerCount);
+    if (cornerCount != 0) {
+        normals::cornerNormals(arrays.positionData(),
+                               arrays.faceOffsets.data(),
+                               arrays.corners.data(),
+                               faceCount,
+                               &cornerNor[0][0]);
+    }
+
+    /// welding: corners that share a vertex, a face color and a normal
+    /// (e.g. neighbouring faces of a flat, subdivided region) become one GPU vertex,
+    /// otherwise the vertex cache never gets a chance to reuse anything.
+    /// for each mesh vertex we keep a linked list of the GPU vertices made from it.
+    std::vector<int> firstGPUVert(vertices.size(), -1);
+    std::vector<int> nextGPUVert;
+    std::vector<GLuint> cornerToGPU(cornerCount);
+
+    positions.reserve(cornerCount);
+    vertNormals.reserve(cornerCount);
+    colors.reserve(cornerCount);
+    nextGPUVert.reserve(cornerCount);
+
+    for (size_t f = 0; f < faceCount; ++f) {
+        const glm::vec4 &col = arrays.faceColors[f];
+        for (uint32_t c = arrays.faceOffsets[f]; c < arrays.faceOffsets[f + 1]; ++c) {
+            uint32_t v = arrays.corners[c];
+            const glm::vec4 &nor = cornerNor[c];
+
+            int match = firstGPUVert[v];
+            while (match != -1 && (colors[match] != col || vertNormals[match] != nor)) {
+                match = nextGPUVert[match];
+            }
+
+            if (match == -1) {
+                match = (int) positions.size();
+                positions.push_back(arrays.positions[v]);
+                vertNormals.push_back(nor);
+                colors.push_back(col);
+                nextGPUVert.push_back(firstGPUVert[v]);
+                firstGPUVert[v] = match;
+                skins.push_back(vertices[v]->getSkinWeights());
+                sources.push_back(vertices[v]);
+            }
+            cornerToGPU[c] = match;
+        }
+    }
+
+    // set triangulization indices (a fan around the first corner of each face)
+    idx.reserve(3 * (cornerCount - std::min(cornerCount, 2 * faceCount)));
+    for (size_t f = 0; f < faceCount; ++f) {
+        uint32_t startID = arrays.faceOffsets[f];
+        int verts = arrays.faceOffsets[f + 1] - startID;
+        for (int i = 0; i < verts - 2; ++i) {
+            idx.push_back(cornerToGPU[startID]);
+            idx.push_back(cornerToGPU[startID + i + 1]);
+            idx.push_back(cornerToGPU[startID + i + 2]);
+        }
+    }
+
+    // reorder for the post-transform cache, then renumber vertices in fetch order
+    if (optimize && !idx.empty()) {
+        vertexcache::optimizeTriangles(idx.data(), idx.size(), positions.size());
+
+        std::vector<uint32_t> remap;
+        size_t used = vertexcache::optimizeFetch(idx.data(), idx.size(), positions.size(), remap);
+        vertexcache::remapVertices(positions, remap, used);
+        vertexcache::remapVertices(vertNormals, remap, used);
+        vertexcache::remapVertices(colors, remap, used);
+        vertexcache::remapVertices(skins, remap, used);
+        vertexcache::remapVertices(sources, remap, used);
+    }
+}
+
+void MeshChunk::create() {
+    MeshArrays arrays;
+    std::vector<Vertex*> verts;
+    flattenFaces(faces, arrays, verts);
+
+    // the mesh indices of the new GPU vertices are looked up again when needed
+    sourceVerts.clear();
+    sourceIDs.clear();
+
+    // bounding box for culling
+    if (!arrays.positions.empty()) {
+        boundsMin = glm::vec3(arrays.positions[0]);
+        boundsMax = boundsMin;
+        for (const glm::vec4 &p : arrays.positions) {
+            boundsMin = glm::min(boundsMin, glm::vec3(p));
+            boundsMax = glm::max(boundsMax, glm::vec3(p));
+        }
+    }
+
+    // joints the skinned chunk can be moved by, so its posed bounds can be found
+    // (the weights of a vertex sum to less than 65535 only if some of it stays at rest)
+    jointIDs.clear();
+    restVertices = false;
+    for (Vertex* v : verts) {
+        const SkinWeights &skin = v->getSkinWeights();
+        uint32_t total = 0;
+        for (int i = 0; i < SkinWeights::MAX_INFLUENCES; ++i) {
+            if (skin.weights[i] != 0) {
+                jointIDs.push_back(skin.joints[i]);
+                total += skin.weights[i];
+            }
+        }
+        restVertices = restVertices || total < 65535;
+    }
+    std::sort(jointIDs.begin(), jointIDs.end());
+    jointIDs.erase(std::unique(jointIDs.begin(), jointIDs.end()), jointIDs.end());
+
+    std::vector<GLuint> idx;
+    std::vector<glm::vec4> mesh_vert_pos;
+    std::vector<glm::vec4> mesh_vert_nor;
+    std::vector<glm::vec4> mesh_vert_col;
+    std::vector<SkinWeights> mesh_vert_skin;
+
+    setup(verts, arrays, cacheOptimized, idx, mesh_vert_pos, mesh_vert_nor, mesh_vert_col, mesh_vert_skin, sourceVerts);
+
+    // joint indices and weights go to separate buffers, 4 GLushorts per vertex each
+    std::vector<GLushort> mesh_vert_jt(4 * mesh_vert_skin.size());
+    std::vector<GLushort> mesh_vert_inf(4 * mesh_vert_skin.size());
+    for (size_t i = 0; i < mesh_vert_skin.size(); ++i) {
+        for (int k = 0; k < 4; ++k) {
+            mesh_vert_jt[4 * i + k] = mesh_vert_skin[i].joints[k];
+            mesh_vert_inf[4 * i + k] = mesh_vert_skin[i].weights[k];
+        }
+    }
+
+    // Mesh::create() keeps every chunk under MAX_VERTS corners, and welding only
+    // merges them, except for a chunk of one face with more corners than that
+    wideIndices = mesh_vert_pos.size() > MAX_VERTS;
+    std::vector<GLushort> mesh_idx;
+    if (!wideIndices) {
+        mesh_idx.assign(idx.begin(), idx.end());
+    }
+
+    count = idx.size();
+
+    // Create a VBO on our GPU and store its handle in bufIdx
+    generateIdx();
+    // Tell OpenGL that we want to perform subsequent operations on the VBO referred to by bufIdx
+    // and that it will be treated as an element array buffer (since it will contain triangle indices)
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    // Pass the data stored in mesh_idx into the bound buffer, reading a number of bytes equal to
+    // the index count multiplied by the size of a GLushort (or GLuint). This data is sent to the GPU to be read by shader programs.
+    if (wideIndices) {
+        mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+    } else {
+        mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_idx.size() * sizeof(GLushort), mesh_idx.data(), GL_STATIC_DRAW);
+    }
+
+    // The next few sets of function calls are basically the same as above, except bufPos and bufNor are
+    // array buffers rather than element array buffers, as they store vertex attributes like position.
+    generatePos();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_pos.size() * sizeof(glm::vec4), mesh_vert_pos.data(), GL_STATIC_DRAW);
+
+    generateCol();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_col.size() * sizeof(glm::vec4), mesh_vert_col.data(), GL_STATIC_DRAW);
+
+    generateNor();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_nor.size() * sizeof(glm::vec4), mesh_vert_nor.data(), GL_STATIC_DRAW);
+
+    generateJtID();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJtID);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_jt.size() * sizeof(GLushort), mesh_vert_jt.data(), GL_STATIC_DRAW);
+
+    generateJtInf();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJtInf);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh_vert_inf.size() * sizeof(GLushort), mesh_vert_inf.data(), GL_STATIC_DRAW);
+}
+
+
+
@@ -0,0 +1,88 @@
+#ifndef MESHCHUNK_H
+#define MESHCHUNK_H
+
+#include "drawable.h"
+#include "vertex.h"
+#include <la.h>
+#include <unordered_map>
+
+/// MESH CHUNK CLASS:
+/// a spatially coherent group of faces of a Mesh, uploaded as its own set of
+/// buffers with 16-bit indices (32-bit for the lone face that has more
+/// corners than those can index). Chunks are built by Mesh::create() and can
+/// be rebuilt one at a time when only part of the mesh is edited.
+
+class MeshChunk : public Drawable {
+public:
+    // at most this many GPU vertices fit in 16-bit indices
+    static const size_t MAX_VERTS = 65536;
+
+private:
+    // the faces drawn by this chunk
+    std::vector<Face*> faces;
+
+    // reorder the index buffer for the GPU vertex cache?
+    bool cacheOptimized;
+
+    // more than MAX_VERTS GPU vertices, so GLuint indices (as of the last create())
+    bool wideIndices;
+
+    // bounding box of the chunk's vertices (as of the last create())
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // ids of the joints that influence the chunk's vertices
+    std::vector<int> jointIDs;
+
+    // does any vertex (partly) stay at its rest position when skinned?
+    bool restVertices;
+
+    // the mesh vertex each GPU vertex was made from, and its index in the mesh
+    // (looked up by the mesh only when positions are streamed in)
+    std::vector<Vertex*> sourceVerts;
+    std::vector<uint32_t> sourceIDs;
+
+public:
+    // constructor
+    MeshChunk(GLWidget277* mp_context);
+
+    ~MeshChunk();
+
+    // set faces
+    void setFaces(const std::vector<Face*> &fs);
+
+    // get faces
+    const std::vector<Face*> &getFaces() const;
+
+    // set vertex cache optimization
+    void setCacheOptimization(bool optimize);
+
+    // getters for the bounding box
+    glm::vec3 getBoundsMin() const;
+    glm::vec3 getBoundsMax() const;
+
+    // getter for the influencing joint ids
+    const std::vector<int> &getJointIDs() const;
+
+    // getter for whether unbound or not fully weighted vertices keep (part of)
+    // their rest position when skinned
+    bool hasRestVertices() const;
+
+    // have the mesh indices of the GPU vertices been looked up since the last create()?
+    bool hasSourceIDs() const;
+
+    // look up the mesh index of the vertex each GPU vertex was made from
+    void setSourceIDs(const std::unordered_map<const Vertex*, uint32_t> &vertIdx);
+
+    // replace the GPU vertex positions (one glBufferSubData) with the given
+    // positions of all the mesh's vertices; staging is scratch space
+    void uploadPositions(const glm::vec4* meshPositions, std::vector<glm::vec4> &staging);
+
+    // chunks use GLushort indices unless they have too many vertices for them
+    virtual GLenum indexType() override;
+
+    // create function
+    virtual void create() override;
+};
+
+#endif // MESHCHUNK_H
@@ -0,0 +1,339 @@
+#include "normals.h"
+#include <simd.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/// TRIPLET KERNELS:
+/// every normal we need is cross(b - a, c - b) for some triple of positions:
+///     -- corner normals: a = previous corner, b = corner, c = next corner
+///     -- face normals: a = first corner, b and c walk the triangle fan
+///        (summing these gives the Newell normal of the polygon)
+/// so there is a single vectorized kernel over arrays of (a, b, c) indices.
+
+// number of triplets gathered before calling the kernel
+static const size_t BLOCK = 1024;
+
+typedef void (*TripletFn)(const float* pos,
+                          const uint32_t* ia, const uint32_t* ib, const uint32_t* ic,
+                          size_t n, float* out, bool unit);
+
+typedef void (*NormalizeFn)(float* v, size_t n);
+
+static inline void crossOne(const float* pos, uint32_t ia, uint32_t ib, uint32_t ic,
+                            float* out, bool unit) {
+    const float* a = pos + 4 * (size_t) ia;
+    const float* b = pos + 4 * (size_t) ib;
+    const float* c = pos + 4 * (size_t) ic;
+    float e1x = b[0] - a[0], e1y = b[1] - a[1], e1z = b[2] - a[2];
+    float e2x = c[0] - b[0], e2y = c[1] - b[1], e2z = c[2] - b[2];
+    float nx = e1y * e2z - e1z * e2y;
+    float ny = e1z * e2x - e1x * e2z;
+    float nz = e1x * e2y - e1y * e2x;
+    if (unit) {
+        float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+        float inv = len > 0 ? 1.f / len : 0.f;
+        nx *= inv;
+        ny *= inv;
+        nz *= inv;
+    }
+    out[0] = nx;
+    out[1] = ny;
+    out[2] = nz;
+    out[3] = 0;
+}
+
+static void crossScalar(const float* pos,
+                        const uint32_t* ia, const uint32_t* ib, const uint32_t* ic,
+                        size_t n, float* out, bool unit) {
+    for (size_t i = 0; i < n; ++i) {
+        crossOne(pos, ia[i], ib[i], ic[i], out + 4 * i, unit);
+    }
+}
+
+static void normalizeScalar(float* v, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        float* p = v + 4 * i;
+        float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        float inv = len > 0 ? 1.f / len : 0.f;
+        p[0] *= inv;
+        p[1] *= inv;
+        p[2] *= inv;
+        p[3] = 0;
+    }
+}
+
+#ifdef MM_SIMD_X86
+
+// SSE4.1: four triplets per iteration, AoS loads transposed into SoA registers
+MM_TARGET_SSE41
+static void crossSSE41(const float* pos,
+                       const uint32_t* ia, const uint32_t* ib, const uint32_t* ic,
+                       size_t n, float* out, bool unit) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 ax = _mm_loadu_ps(pos + 4 * (size_t) ia[i]);
+        __m128 ay = _mm_loadu_ps(pos + 4 * (size_t) ia[i + 1]);
+        __m128 az = _mm_loadu_ps(pos + 4 * (size_t) ia[i + 2]);
+        __m128 aw = _mm_loadu_ps(pos + 4 * (size_t) ia[i + 3]);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+
+        __m128 bx = _mm_loadu_ps(pos + 4 * (size_t) ib[i]);
+        __m128 by = _mm_loadu_ps(pos + 4 * (size_t) ib[i + 1]);
+        __m128 bz = _mm_loadu_ps(pos + 4 * (size_t) ib[i + 2]);
+        __m128 bw = _mm_loadu_ps(pos + 4 * (size_t) ib[i + 3]);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 cx = _mm_loadu_ps(pos + 4 * (size_t) ic[i]);
+        __m128 cy = _mm_loadu_ps(pos + 4 * (size_t) ic[i + 1]);
+        __m128 cz = _mm_loadu_ps(pos + 4 * (size_t) ic[i + 2]);
+        __m128 cw = _mm_loadu_ps(pos + 4 * (size_t) ic[i + 3]);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+        __m128 e1x = _mm_sub_ps(bx, ax), e1y = _mm_sub_ps(by, ay), e1z = _mm_sub_ps(bz, az);
+        __m128 e2x = _mm_sub_ps(cx, bx), e2y = _mm_sub_ps(cy, by), e2z = _mm_sub_ps(cz, bz);
+
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+        __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+        __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+        if (unit) {
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)),
+                                     _mm_mul_ps(nz, nz));
+            __m128 nonzero = _mm_cmpgt_ps(len2, _mm_setzero_ps());
+            __m128 inv = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(len2)), nonzero);
+            nx = _mm_mul_ps(nx, inv);
+            ny = _mm_mul_ps(ny, inv);
+            nz = _mm_mul_ps(nz, inv);
+        }
+
+        __m128 nw = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+        _mm_storeu_ps(out + 4 * i, nx);
+        _mm_storeu_ps(out + 4 * i + 4, ny);
+        _mm_storeu_ps(out + 4 * i + 8, nz);
+        _mm_storeu_ps(out + 4 * i + 12, nw);
+    }
+    crossScalar(pos, ia + i, ib + i, ic + i, n - i, out + 4 * i, unit);
+}
+
+MM_TARGET_SSE41
+static void normalizeSSE41(float* v, size_t n) {
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < n; ++i) {
+        __m128 p = _mm_loadu_ps(v + 4 * i);
+        __m128 len2 = _mm_dp_ps(p, p, 0x7F);
+        __m128 nonzero = _mm_cmpgt_ps(len2, zero);
+        __m128 r = _mm_and_ps(_mm_div_ps(p, _mm_sqrt_ps(len2)), nonzero);
+        _mm_storeu_ps(v + 4 * i, _mm_blend_ps(r, zero, 0x8));
+    }
+}
+
+// AVX2: eight triplets per iteration, positions fetched with gathers
+MM_TARGET_AVX2
+static void crossAVX2(const float* pos,
+                      const uint32_t* ia, const uint32_t* ib, const uint32_t* ic,
+                      size_t n, float* out, bool unit) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*) (ia + i)), 2);
+        __m256i vb = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*) (ib + i)), 2);
+        __m256i vc = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*) (ic + i)), 2);
+
+        __m256 ax = _mm256_i32gather_ps(pos, va, 4);
+        __m256 ay = _mm256_i32gather_ps(pos + 1, va, 4);
+        __m256 az = _mm256_i32gather_ps(pos + 2, va, 4);
+        __m256 bx = _mm256_i32gather_ps(pos, vb, 4);
+        __m256 by = _mm256_i32gather_ps(pos + 1, vb, 4);
+        __m256 bz = _mm256_i32gather_ps(pos + 2, vb, 4);
+        __m256 cx = _mm256_i32gather_ps(pos, vc, 4);
+        __m256 cy = _mm256_i32gather_ps(pos + 1, vc, 4);
+        __m256 cz = _mm256_i32gather_ps(pos + 2, vc, 4);
+
+        __m256 e1x = _mm256_sub_ps(bx, ax), e1y = _mm256_sub_ps(by, ay), e1z = _mm256_sub_ps(bz, az);
+        __m256 e2x = _mm256_sub_ps(cx, bx), e2y = _mm256_sub_ps(cy, by), e2z = _mm256_sub_ps(cz, bz);
+
+        __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+        __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+        __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+
+        if (unit) {
+            __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)),
+                                        _mm256_mul_ps(nz, nz));
+            __m256 nonzero = _mm256_cmp_ps(len2, _mm256_setzero_ps(), _CMP_GT_OQ);
+            __m256 inv = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(len2)),
+                                       nonzero);
+            nx = _mm256_mul_ps(nx, inv);
+            ny = _mm256_mul_ps(ny, inv);
+            nz = _mm256_mul_ps(nz, inv);
+        }
+
+        // transpose the eight SoA results back to xyzw quadruples
+        __m256 nw = _mm256_setzero_ps();
+        __m256 t0 = _mm256_unpacklo_ps(nx, ny);
+        __m256 t1 = _mm256_unpackhi_ps(nx, ny);
+        __m256 t2 = _mm256_unpacklo_ps(nz, nw);
+        __m256 t3 = _mm256_unpackhi_ps(nz, nw);
+        __m256 v0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        __m256 v1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        __m256 v2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        __m256 v3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+        _mm256_storeu_ps(out + 4 * i, _mm256_permute2f128_ps(v0, v1, 0x20));
+        _mm256_storeu_ps(out + 4 * i + 8, _mm256_permute2f128_ps(v2, v3, 0x20));
+        _mm256_storeu_ps(out + 4 * i + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+        _mm256_storeu_ps(out + 4 * i + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+    }
+    crossScalar(pos, ia + i, ib + i, ic + i, n - i, out + 4 * i, unit);
+}
+
+MM_TARGET_AVX2
+static void normalizeAVX2(float* v, size_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m256 p = _mm256_loadu_ps(v + 4 * i);
+        __m256 len2 = _mm256_dp_ps(p, p, 0x7F);
+        __m256 nonzero = _mm256_cmp_ps(len2, zero, _CMP_GT_OQ);
+        __m256 r = _mm256_and_ps(_mm256_div_ps(p, _mm256_sqrt_ps(len2)), nonzero);
+        _mm256_storeu_ps(v + 4 * i, _mm256_blend_ps(r, zero, 0x88));
+    }
+    normalizeScalar(v + 4 * i, n - i);
+}
+
+#endif // MM_SIMD_X86
+
+// pick the widest kernel the CPU supports, once
+static TripletFn tripletKernel() {
+#ifdef MM_SIMD_X86
+    static const TripletFn fn = simd::hasAVX2() ? crossAVX2
+                              : simd::hasSSE41() ? crossSSE41
+                              : crossScalar;
+    return fn;
+#else
+    return crossScalar;
+#endif
+}
+
+static NormalizeFn normalizeKernel() {
+#ifdef MM_SIMD_X86
+    static const NormalizeFn fn = simd::hasAVX2() ? normalizeAVX2
+                                : simd::hasSSE41() ? normalizeSSE41
+                                : normalizeScalar;
+    return fn;
+#else
+    return normalizeScalar;
+#endif
+}
+
+// area vector (twice the area, along the normal) of every face
+static void faceAreaVectors(const float* positions,
+                            const uint32_t* faceOffsets,
+                            const uint32_t* corners,
+                            size_t faceCount,
+                            float* out) {
+    TripletFn kernel = tripletKernel();
+    uint32_t ia[BLOCK], ib[BLOCK], ic[BLOCK];
+    float tri[4 * BLOCK];
+
+    std::memset(out, 0, faceCount * 4 * sizeof(float));
+
+    // owner of each gathered triangle, so the block can be summed per face
+    uint32_t owner[BLOCK];
+    size_t fill = 0;
+
+    for (size_t f = 0; f < faceCount; ++f) {
+        uint32_t first = faceOffsets[f];
+        uint32_t last = faceOffsets[f + 1];
+        // fan triangulation: (c0, ci, ci+1) for i in [1, n - 2]
+        for (uint32_t i = first + 1; i + 1 < last; ++i) {
+            ia[fill] = corners[first];
+            ib[fill] = corners[i];
+            ic[fill] = corners[i + 1];
+            owner[fill] = (uint32_t) f;
+            if (++fill == BLOCK) {
+                kernel(positions, ia, ib, ic, fill, tri, false);
+                for (size_t t = 0; t < fill; ++t) {
+                    float* n = out + 4 * (size_t) owner[t];
+                    n[0] += tri[4 * t];
+                    n[1] += tri[4 * t + 1];
+                    n[2] += tri[4 * t + 2];
+                }
+                fill = 0;
+            }
+        }
+    }
+    kernel(positions, ia, ib, ic, fill, tri, false);
+    for (size_t t = 0; t < fill; ++t) {
+        float* n = out + 4 * (size_t) owner[t];
+        n[0] += tri[4 * t];
+        n[1] += tri[4 * t + 1];
+        n[2] += tri[4 * t + 2];
+    }
+}
+
+void normals::cornerNormals(const float* positions,
+                            const uint32_t* faceOffsets,
+                            const uint32_t* corners,
+                            size_t faceCount,
+                            float* out) {
+    TripletFn kernel = tripletKernel();
+    uint32_t ia[BLOCK], ib[BLOCK], ic[BLOCK];
+
+    // corners are emitted in order, so a block always lands at out[flushed]
+    size_t flushed = 0;
+    size_t fill = 0;
+
+    for (size_t f = 0; f < faceCount; ++f) {
+        uint32_t first = faceOffsets[f];
+        uint32_t last = faceOffsets[f + 1];
+        for (uint32_t i = first; i < last; ++i) {
+            uint32_t prev = (i == first) ? last - 1 : i - 1;
+            uint32_t next = (i + 1 == last) ? first : i + 1;
+            ia[fill] = corners[prev];
+            ib[fill] = corners[i];
+            ic[fill] = corners[next];
+            if (++fill == BLOCK) {
+                kernel(positions, ia, ib, ic, fill, out + 4 * flushed, true);
+                flushed += fill;
+                fill = 0;
+            }
+        }
+    }
+    kernel(positions, ia, ib, ic, fill, out + 4 * flushed, true);
+}
+
+void normals::faceNormals(const float* positions,
+                          const uint32_t* faceOffsets,
+                          const uint32_t* corners,
+                          size_t faceCount,
+                          float* out) {
+    faceAreaVectors(positions, faceOffsets, corners, faceCount, out);
+    normalize(out, faceCount);
+}
+
+void normals::vertexNormals(const float* positions,
+                            size_t vertCount,
+                            const uint32_t* faceOffsets,
+                            const uint32_t* corners,
+                            size_t faceCount,
+                            float* out) {
+    // unnormalized face normals are already weighted by area
+    std::vector<float> area(4 * faceCount);
+    faceAreaVectors(positions, faceOffsets, corners, faceCount, area.data());
+
+    std::memset(out, 0, vertCount * 4 * sizeof(float));
+    for (size_t f = 0; f < faceCount; ++f) {
+        const float* a = area.data() + 4 * f;
+        for (uint32_t i = faceOffsets[f]; i < faceOffsets[f + 1]; ++i) {
+            float* n = out + 4 * (size_t) corners[i];
+            n[0] += a[0];
+            n[1] += a[1];
+            n[2] += a[2];
+        }
+    }
+    normalize(out, vertCount);
+}
+
+void normals::normalize(float* vectors, size_t n) {
+    normalizeKernel()(vectors, n);
+}
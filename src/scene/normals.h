@@ -0,0 +1,43 @@
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Bulk normal kernels over flat mesh arrays.
+///
+/// Positions and normals are tightly packed xyzw quadruples (the glm::vec4
+/// layout used by the GPU buffers); output normals always have w = 0.
+/// Faces are described by faceOffsets (faceCount + 1 entries, the corners of
+/// face f are [faceOffsets[f], faceOffsets[f + 1])) and corners, which holds
+/// the position index of every face corner.
+/// Degenerate normals come out as zero vectors instead of NaNs.
+
+namespace normals {
+    // unit normal of every corner: normalize(cross(curr - prev, next - curr))
+    void cornerNormals(const float* positions,
+                       const uint32_t* faceOffsets,
+                       const uint32_t* corners,
+                       size_t faceCount,
+                       float* out);
+
+    // unit normal of every face (Newell normal, robust for non-planar n-gons)
+    void faceNormals(const float* positions,
+                     const uint32_t* faceOffsets,
+                     const uint32_t* corners,
+                     size_t faceCount,
+                     float* out);
+
+    // area-weighted unit normal of every vertex
+    void vertexNormals(const float* positions,
+                       size_t vertCount,
+                       const uint32_t* faceOffsets,
+                       const uint32_t* corners,
+                       size_t faceCount,
+                       float* out);
+
+    // normalize n xyzw vectors in place, w is set to 0
+    void normalize(float* vectors, size_t n);
+}
+
+#endif // NORMALS_H
@@ -0,0 +1,317 @@
+#include "objreader.h"
+#include <parallel.h>
+#include <QFile>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// the smallest chunk worth giving its own thread
+static const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// exact powers of ten as doubles
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c) {
+    return (unsigned) (c - '0') < 10u;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool objreader::parseFloat(const char* &p, const char* end, float &value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        ++s;
+    }
+
+    // up to 19 significant digits fit in the mantissa; the rest only scale it
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; s < end && isDigit(*s); ++s) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && isDigit(*s); ++s) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return false;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool negativeExp = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExp = *e == '-';
+            ++e;
+        }
+        if (e < end && isDigit(*e)) {
+            int exp = 0;
+            for (; e < end && isDigit(*e); ++e) {
+                if (exp < 1000) {
+                    exp = exp * 10 + (*e - '0');
+                }
+            }
+            exponent += negativeExp ? -exp : exp;
+            s = e;
+        }
+    }
+
+    // the mantissa and 10^|exponent| (up to 22) are exact doubles, so one
+    // multiplication or division rounds correctly
+    double v = (double) mantissa;
+    if (exponent >= 0) {
+        v = exponent <= 22 ? v * POW10[exponent] : v * std::pow(10.0, exponent);
+    } else {
+        v = exponent >= -22 ? v / POW10[-exponent] : v * std::pow(10.0, exponent);
+    }
+    value = (float) (negative ? -v : v);
+    p = s;
+    return true;
+}
+
+bool objreader::parseInt(const char* &p, const char* end, long long &value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        ++s;
+    }
+    if (s >= end || !isDigit(*s)) {
+        return false;
+    }
+    long long v = 0;
+    for (; s < end && isDigit(*s); ++s) {
+        if (v < (1LL << 40)) {
+            v = v * 10 + (*s - '0');
+        }
+    }
+    value = negative ? -v : v;
+    p = s;
+    return true;
+}
+
+// the output of one chunk of lines
+struct ObjChunk {
+    std::vector<float> positions;
+    std::vector<uint32_t> faceSizes;
+
+    // absolute 0-based vertex indices, except at the slots listed in relative,
+    // which hold (as int32) a vertex number counted from the chunk's first vertex
+    std::vector<uint32_t> corners;
+    std::vector<uint32_t> relative;
+
+    bool badIndex;
+
+    ObjChunk() : badIndex(false) {}
+};
+
+static void parseChunk(const char* p, const char* end, ObjChunk &chunk) {
+    while (p < end) {
+        const char* eol = (const char*) std::memchr(p, '\n', end - p);
+        if (eol == nullptr) {
+            eol = end;
+        }
+        while (p < eol && isBlank(*p)) {
+            ++p;
+        }
+
+        if (eol - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+            // v x y z [w]: missing coordinates read as 0
+            p += 1;
+            for (int i = 0; i < 3; ++i) {
+                while (p < eol && isBlank(*p)) {
+                    ++p;
+                }
+                float x = 0;
+                objreader::parseFloat(p, eol, x);
+                chunk.positions.push_back(x);
+            }
+        } else if (eol - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+            // f v[/vt[/vn]] ...: only the vertex index matters
+            p += 1;
+            size_t first = chunk.corners.size();
+            size_t vertsSoFar = chunk.positions.size() / 3;
+            while (true) {
+                while (p < eol && isBlank(*p)) {
+                    ++p;
+                }
+                if (p >= eol || *p == '#') {
+                    break;
+                }
+                long long index;
+                if (objreader::parseInt(p, eol, index)) {
+                    // indices that don't fit a uint32 (or, relative, an int32)
+                    // can't name a vertex, and must not wrap around to one
+                    if (index == 0 || index > (long long) UINT32_MAX
+                            || (index < 0 && (long long) vertsSoFar + index < (long long) INT32_MIN)) {
+                        chunk.badIndex = true;
+                    } else if (index > 0) {
+                        chunk.corners.push_back((uint32_t) (index - 1));
+                    } else {
+                        // relative to the vertices read so far
+                        chunk.relative.push_back((uint32_t) chunk.corners.size());
+                        chunk.corners.push_back((uint32_t) (int32_t) ((long long) vertsSoFar + index));
+                    }
+                }
+                // skip /vt/vn (or whatever else is left of the token)
+                while (p < eol && !isBlank(*p)) {
+                    ++p;
+                }
+            }
+
+            size_t count = chunk.corners.size() - first;
+            if (count >= 3) {
+                chunk.faceSizes.push_back((uint32_t) count);
+            } else {
+                // points and lines aren't faces
+                chunk.corners.resize(first);
+                while (!chunk.relative.empty() && chunk.relative.back() >= first) {
+                    chunk.relative.pop_back();
+                }
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+bool objreader::parse(const char* data, size_t size, ObjData &out) {
+    out.positions.clear();
+    out.faceOffsets.assign(1, 0);
+    out.corners.clear();
+
+    // cut the text into chunks that start right after a newline
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(parallel::threadCount(),
+                                                             size / MIN_CHUNK_BYTES));
+    std::vector<size_t> bounds(chunkCount + 1, size);
+    bounds[0] = 0;
+    for (size_t c = 1; c < chunkCount; ++c) {
+        size_t at = std::max(bounds[c - 1], size / chunkCount * c);
+        const char* nl = at < size ? (const char*) std::memchr(data + at, '\n', size - at) : nullptr;
+        bounds[c] = nl != nullptr ? (size_t) (nl - data) + 1 : size;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    parallel::forRange(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            parseChunk(data + bounds[c], data + bounds[c + 1], chunks[c]);
+        }
+    });
+
+    // where each chunk's output goes in the merged arrays
+    std::vector<size_t> vertBase(chunkCount + 1, 0);
+    std::vector<size_t> faceBase(chunkCount + 1, 0);
+    std::vector<size_t> cornerBase(chunkCount + 1, 0);
+    for (size_t c = 0; c < chunkCount; ++c) {
+        if (chunks[c].badIndex) {
+            return false;
+        }
+        vertBase[c + 1] = vertBase[c] + chunks[c].positions.size() / 3;
+        faceBase[c + 1] = faceBase[c] + chunks[c].faceSizes.size();
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+    }
+    size_t vertexCount = vertBase[chunkCount];
+
+    out.positions.resize(vertexCount * 3);
+    out.faceOffsets.resize(faceBase[chunkCount] + 1);
+    out.corners.resize(cornerBase[chunkCount]);
+    out.faceOffsets.back() = (uint32_t) cornerBase[chunkCount];
+
+    std::vector<char> valid(chunkCount, 1);
+    parallel::forRange(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            ObjChunk &chunk = chunks[c];
+            if (!chunk.positions.empty()) {
+                std::memcpy(&out.positions[vertBase[c] * 3], chunk.positions.data(),
+                            chunk.positions.size() * sizeof(float));
+            }
+
+            // resolve relative indices now that the chunk's first vertex is known
+            for (uint32_t slot : chunk.relative) {
+                long long index = (long long) vertBase[c] + (int32_t) chunk.corners[slot];
+                chunk.corners[slot] = index < 0 ? ~0u : (uint32_t) index;
+            }
+
+            uint32_t* corners = out.corners.data() + cornerBase[c];
+            for (size_t i = 0; i < chunk.corners.size(); ++i) {
+                uint32_t v = chunk.corners[i];
+                valid[c] &= v < vertexCount;
+                corners[i] = v;
+            }
+
+            uint32_t* offsets = out.faceOffsets.data() + faceBase[c];
+            uint32_t offset = (uint32_t) cornerBase[c];
+            for (size_t f = 0; f < chunk.faceSizes.size(); ++f) {
+                offsets[f] = offset;
+                offset += chunk.faceSizes[f];
+            }
+
+            // free the chunk as soon as it's merged
+            ObjChunk().positions.swap(chunk.positions);
+            ObjChunk().corners.swap(chunk.corners);
+        }
+    });
+
+    for (char ok : valid) {
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool objreader::read(const QString &path, MeshArrays &arrays) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    ObjData data;
+    qint64 size = file.size();
+    if (size > 0) {
+        const uchar* mapped = file.map(0, size);
+        if (mapped == nullptr) {
+            return false;
+        }
+        bool ok = parse((const char*) mapped, (size_t) size, data);
+        file.unmap((uchar*) mapped);
+        if (!ok) {
+            return false;
+        }
+    } else {
+        parse(nullptr, 0, data);
+    }
+
+    size_t n = data.vertexCount();
+    arrays.positions.resize(n);
+    const float* xyz = data.positions.data();
+    parallel::forRange(n, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            arrays.positions[v] = glm::vec4(xyz[3 * v], xyz[3 * v + 1], xyz[3 * v + 2], 1);
+        }
+    });
+    arrays.faceOffsets.swap(data.faceOffsets);
+    arrays.corners.swap(data.corners);
+    arrays.faceColors.clear();
+    return true;
+}
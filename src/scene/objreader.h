@@ -0,0 +1,46 @@
+#ifndef OBJREADER_H
+#define OBJREADER_H
+
+#include "mesharrays.h"
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Wavefront OBJ reader.
+///
+/// The file is memory-mapped and cut into chunks at line boundaries; every
+/// chunk is parsed on its own thread with hand-rolled number parsing into
+/// chunk-local arrays, and the chunks are then stitched together with prefix
+/// sums over their vertex, face and corner counts. Only "v" positions and the
+/// vertex part of "f" corners are read (texture coordinates, normals, groups
+/// and materials are skipped); negative (relative) indices are supported.
+
+namespace objreader {
+    struct ObjData {
+        // x, y, z of each vertex
+        std::vector<float> positions;
+
+        // first corner of each face, plus one trailing entry holding the corner count
+        std::vector<uint32_t> faceOffsets;
+
+        // 0-based vertex index of each face corner
+        std::vector<uint32_t> corners;
+
+        size_t vertexCount() const { return positions.size() / 3; }
+        size_t faceCount() const { return faceOffsets.empty() ? 0 : faceOffsets.size() - 1; }
+    };
+
+    // parse OBJ text; false if a face refers to a vertex that doesn't exist
+    bool parse(const char* data, size_t size, ObjData &out);
+
+    // parse a single number at p (no leading whitespace), advancing p past it;
+    // false if there is no number at p
+    bool parseFloat(const char* &p, const char* end, float &value);
+    bool parseInt(const char* &p, const char* end, long long &value);
+
+    // map and parse an OBJ file into flat mesh arrays (faces get no colors)
+    bool read(const QString &path, MeshArrays &arrays);
+}
+
+#endif // OBJREADER_H
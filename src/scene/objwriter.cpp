@@ -0,0 +1,228 @@
+#include "objwriter.h"
+#include "chunkedwriter.h"
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+// powers of ten that are exact in a double
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// decimal exponents handled by the fast path; anything else goes to snprintf
+static const int MIN_EXP = -12;
+static const int MAX_EXP = 12;
+
+// 10^(MIN_EXP + i), the lower bound of each decade of the fast path
+static const double DECADES[] = {
+    1e-12, 1e-11, 1e-10, 1e-9, 1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1,
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13
+};
+
+// x rounded to count significant digits, x in the decade of 10^e; the
+// result is those digits as an integer, scaled by 10^(e - count + 1)
+static uint64_t roundDigits(double x, int e, int count) {
+    int shift = count - 1 - e;
+    double scaled = shift >= 0 ? x * POW10[shift] : x / POW10[-shift];
+    return (uint64_t) (scaled + 0.5);
+}
+
+// does digits * 10^exponent read back as value?
+static bool roundTrips(uint64_t digits, int exponent, float value) {
+    // one correctly rounded operation on exact operands
+    double d = exponent >= 0 ? (double) digits * POW10[exponent] : (double) digits / POW10[-exponent];
+    return (float) d == value;
+}
+
+// write value as the shortest decimal that parses back to it
+size_t objwriter::formatFloat(float value, char* out) {
+    if (value == 0.f) {
+        out[0] = '0';
+        return 1;
+    }
+    double x = std::fabs((double) value);
+    if (!std::isfinite(value) || x < DECADES[0] || x >= DECADES[MAX_EXP - MIN_EXP + 1]) {
+        return (size_t) std::snprintf(out, MAX_FLOAT_CHARS, "%.9g", value);
+    }
+    int e = MIN_EXP + (int) (std::upper_bound(DECADES, DECADES + (MAX_EXP - MIN_EXP + 2), x) - DECADES) - 1;
+
+    // the digits that round-trip only ever grow with the digit count, and 9
+    // significant digits always do, so binary search the shortest count
+    float target = (float) x;
+    int lo = 1;
+    int hi = 9;
+    bool hiTested = false;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (roundTrips(roundDigits(x, e, mid), e - mid + 1, target)) {
+            hi = mid;
+            hiTested = true;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    uint64_t digits = roundDigits(x, e, lo);
+    int exponent = e - lo + 1;
+    if (!hiTested && !roundTrips(digits, exponent, target)) {
+        // the scaled rounding came out one off in the last place
+        return (size_t) std::snprintf(out, MAX_FLOAT_CHARS, "%.9g", value);
+    }
+    while (digits % 10 == 0) {
+        digits /= 10;
+        exponent++;
+    }
+
+    // digits, most significant last
+    char buf[20];
+    int n = 0;
+    do {
+        buf[n++] = (char) ('0' + digits % 10);
+        digits /= 10;
+    } while (digits != 0);
+
+    char* p = out;
+    if (value < 0) {
+        *p++ = '-';
+    }
+    if (exponent >= 0) {
+        // integer: the digits, then zeros
+        while (n > 0) {
+            *p++ = buf[--n];
+        }
+        for (int i = 0; i < exponent; ++i) {
+            *p++ = '0';
+        }
+    } else if (n > -exponent) {
+        // the point falls inside the digits
+        while (n > 0) {
+            if (n == -exponent) {
+                *p++ = '.';
+            }
+            *p++ = buf[--n];
+        }
+    } else {
+        // 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = 0; i < -exponent - n; ++i) {
+            *p++ = '0';
+        }
+        while (n > 0) {
+            *p++ = buf[--n];
+        }
+    }
+    return (size_t) (p - out);
+}
+
+// write value in decimal
+size_t objwriter::formatUInt(uint32_t value, char* out) {
+    char buf[MAX_UINT_CHARS];
+    int n = 0;
+    do {
+        buf[n++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    for (int i = 0; i < n; ++i) {
+        out[i] = buf[n - 1 - i];
+    }
+    return (size_t) n;
+}
+
+// "v x y z" lines of vertices [begin, end), each followed by a
+// "vn x y z" line if normals is set
+static void formatVertices(const MeshArrays &arrays, size_t begin, size_t end, bool normals, std::string &text) {
+    size_t lineChars = 3 * (objwriter::MAX_FLOAT_CHARS + 1) + 3;
+    text.resize((end - begin) * (normals ? 2 * lineChars : lineChars));
+    char* start = &text[0];
+    char* p = start;
+    for (size_t v = begin; v < end; ++v) {
+        const glm::vec4 &pos = arrays.positions[v];
+        *p++ = 'v';
+        for (int i = 0; i < 3; ++i) {
+            *p++ = ' ';
+            p += objwriter::formatFloat(pos[i], p);
+        }
+        *p++ = '\n';
+        if (normals) {
+            const glm::vec4 &nor = arrays.normals[v];
+            *p++ = 'v';
+            *p++ = 'n';
+            for (int i = 0; i < 3; ++i) {
+                *p++ = ' ';
+                p += objwriter::formatFloat(nor[i], p);
+            }
+            *p++ = '\n';
+        }
+    }
+    text.resize(p - start);
+}
+
+// "f a b c ..." lines of faces [begin, end) ("f a//a b//b ..." if normals
+// is set), each run of equal colors preceded by a "# color r g b" line if
+// colors is set
+static void formatFaces(const MeshArrays &arrays, size_t begin, size_t end, bool normals, bool colors,
+                        std::string &text) {
+    size_t corners = arrays.faceOffsets[end] - arrays.faceOffsets[begin];
+    size_t cornerChars = normals ? 2 * objwriter::MAX_UINT_CHARS + 3 : objwriter::MAX_UINT_CHARS + 1;
+    size_t colorChars = colors ? 8 + 3 * (objwriter::MAX_FLOAT_CHARS + 1) : 0;
+    text.resize(corners * cornerChars + (end - begin) * (2 + colorChars));
+    char* start = &text[0];
+    char* p = start;
+    for (size_t f = begin; f < end; ++f) {
+        // compared with the previous face, not the previous face of this
+        // chunk, so the output doesn't depend on the chunking
+        if (colors && (f == 0 || arrays.faceColors[f] != arrays.faceColors[f - 1])) {
+            const glm::vec4 &c = arrays.faceColors[f];
+            const char tag[] = "# color";
+            std::copy(tag, tag + 7, p);
+            p += 7;
+            for (int i = 0; i < 3; ++i) {
+                *p++ = ' ';
+                p += objwriter::formatFloat(c[i], p);
+            }
+            *p++ = '\n';
+        }
+        *p++ = 'f';
+        for (uint32_t h = arrays.faceOffsets[f]; h < arrays.faceOffsets[f + 1]; ++h) {
+            *p++ = ' ';
+            // OBJ indices are 1-based; a vertex's normal has its index
+            uint32_t index = arrays.corners[h] + 1;
+            p += objwriter::formatUInt(index, p);
+            if (normals) {
+                *p++ = '/';
+                *p++ = '/';
+                p += objwriter::formatUInt(index, p);
+            }
+        }
+        *p++ = '\n';
+    }
+    text.resize(p - start);
+}
+
+// write arrays to an OBJ file
+bool objwriter::write(const QString &path, const MeshArrays &arrays, bool faceColors) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    size_t vertCount = arrays.positions.size();
+    size_t faceCount = arrays.faceCount();
+    bool colors = faceColors && arrays.faceColors.size() == faceCount;
+    bool normals = arrays.hasNormals();
+
+    std::string header = "# " + std::to_string(vertCount) + " vertices, "
+            + std::to_string(faceCount) + " faces\n";
+    bool ok = file.write(header.data(), (qint64) header.size()) == (qint64) header.size();
+    ok = ok && chunkedwriter::write(file, vertCount,
+        [&](size_t begin, size_t end, std::string &text) {
+            formatVertices(arrays, begin, end, normals, text);
+        }, faceCount,
+        [&](size_t begin, size_t end, std::string &text) {
+            formatFaces(arrays, begin, end, normals, colors, text);
+        });
+    file.close();
+    return ok && file.error() == QFileDevice::NoError;
+}
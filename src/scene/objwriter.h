@@ -0,0 +1,41 @@
+#ifndef OBJWRITER_H
+#define OBJWRITER_H
+
+#include "mesharrays.h"
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+
+/// Wavefront OBJ writer.
+///
+/// Streams flat mesh arrays to disk through chunkedwriter: chunks of the
+/// vertex and face lists are formatted in parallel into chunk-local text
+/// buffers and written in order, so memory stays bounded however big the
+/// mesh is.
+/// Numbers are formatted by hand: floats as the shortest decimal that reads
+/// back as the same float, indices with a plain digit loop.
+///
+/// Vertex normals, when the arrays have them, go out as a "vn" line after
+/// each "v" line, and faces then refer to them as "f a//a b//b ...".
+/// Face colors are optional and go out as "# color r g b" comment lines
+/// before the first face of every run of faces sharing a color; any OBJ
+/// reader (ours included) skips them.
+
+namespace objwriter {
+    // longest output of formatFloat() / formatUInt()
+    static const size_t MAX_FLOAT_CHARS = 24;
+    static const size_t MAX_UINT_CHARS = 10;
+
+    // write value as the shortest decimal that parses back to it; returns
+    // the number of characters written (no terminator)
+    size_t formatFloat(float value, char* out);
+
+    // write value in decimal; returns the number of characters written
+    size_t formatUInt(uint32_t value, char* out);
+
+    // write arrays to an OBJ file, with their vertex normals if they have
+    // them and face colors as comments if asked
+    bool write(const QString &path, const MeshArrays &arrays, bool faceColors);
+}
+
+#endif // OBJWRITER_H
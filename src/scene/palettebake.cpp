@@ -0,0 +1,251 @@
+#include "palettebake.h"
+#include <cmath>
+#include <cstring>
+
+// header of a palette cache file; the frames follow it as raw vec4s
+struct PaletteCacheHeader {
+    char magic[4];          // "MMPB"
+    uint32_t version;
+    uint32_t jointCount;
+    uint32_t frameCount;
+    uint32_t texelsPerJoint;
+    float rate;
+};
+
+static const char CACHE_MAGIC[4] = {'M', 'M', 'P', 'B'};
+static const uint32_t CACHE_VERSION = 1;
+
+// an empty bake
+BakedPalettes::BakedPalettes() :
+    jointCount(0),
+    frameCount(0),
+    texelsPerJoint(LINEAR_TEXELS),
+    rate(0),
+    frames(nullptr)
+{}
+
+// write the palette entry of one joint's skin matrix
+void BakedPalettes::packSkinMatrix(const glm::mat4 &skin, bool dualQuat, glm::vec4* out) {
+    if (dualQuat) {
+        // joints only rotate and translate, so skin is rigid:
+        // real = its rotation, dual = 1/2 * translation * real
+        glm::quat real = glm::normalize(glm::quat_cast(glm::mat3(skin)));
+        glm::quat dual = 0.5f * (glm::quat(0, skin[3][0], skin[3][1], skin[3][2]) * real);
+        out[0] = glm::vec4(real.x, real.y, real.z, real.w);
+        out[1] = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+    } else {
+        // the bottom row of an affine matrix is always (0, 0, 0, 1)
+        glm::mat4 rows = glm::transpose(skin);
+        out[0] = rows[0];
+        out[1] = rows[1];
+        out[2] = rows[2];
+    }
+}
+
+// sample the clip at a fixed rate and store the palette of every frame
+void BakedPalettes::bake(const AnimationClip &clip, const std::vector<Joint*> &skeleton,
+                         float framesPerSecond, bool dualQuat,
+                         std::vector<IKHandle>* handles, ik::Solver solver) {
+    clear();
+    size_t n = skeleton.size();
+    if (n == 0 || clip.getJointCount() != n || framesPerSecond <= 0) {
+        return;
+    }
+
+    jointCount = n;
+    texelsPerJoint = dualQuat ? DUAL_QUAT_TEXELS : LINEAR_TEXELS;
+    rate = framesPerSecond;
+    frameCount = (int) std::floor(clip.getDuration() * rate) + 1;
+
+    // flat copies of everything the frames need: parent indices (parents come
+    // before their children), bind matrices and the current local pose
+    std::vector<int> parents(n);
+    std::vector<glm::mat4> binds(n);
+    std::vector<glm::vec3> restTranslations(n);
+    std::vector<glm::quat> restRotations(n);
+    for (size_t i = 0; i < n; ++i) {
+        Joint* parent = skeleton[i]->getParent();
+        parents[i] = parent != nullptr ? parent->getID() : -1;
+        binds[i] = skeleton[i]->getBindMatrix();
+        restTranslations[i] = glm::vec3(skeleton[i]->getLocalPosition());
+        restRotations[i] = skeleton[i]->getQuaternion();
+    }
+
+    std::vector<glm::vec3> translations(n);
+    std::vector<glm::quat> rotations(n);
+    std::vector<glm::mat4> world(n);
+    baked.resize((size_t) frameCount * n * texelsPerJoint);
+
+    // IK reads and writes the joints, so it can't run on the flat copies
+    bool solveIK = handles != nullptr && !handles->empty();
+
+    // frames are sampled in order, so the sampler's cursors only ever step forward
+    AnimationSampler sampler;
+    sampler.setClip(&clip);
+    for (int f = 0; f < frameCount; ++f) {
+        translations = restTranslations;
+        rotations = restRotations;
+        sampler.sample(f / rate, translations.data(), rotations.data());
+
+        glm::vec4* out = baked.data() + (size_t) f * n * texelsPerJoint;
+        if (solveIK) {
+            for (size_t i = 0; i < n; ++i) {
+                skeleton[i]->setPosition(glm::vec4(translations[i], 1));
+                skeleton[i]->setQuat(rotations[i]);
+            }
+            for (IKHandle &handle : *handles) {
+                handle.solve(solver);
+            }
+            Joint::updateTransforms(skeleton);
+            for (size_t i = 0; i < n; ++i) {
+                packSkinMatrix(skeleton[i]->getOverallTransformation() * binds[i], dualQuat,
+                               out + i * texelsPerJoint);
+            }
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            glm::mat4 local = glm::mat4_cast(rotations[i]);
+            local[3] = glm::vec4(translations[i], 1);
+            world[i] = parents[i] >= 0 ? world[parents[i]] * local : local;
+            packSkinMatrix(world[i] * binds[i], dualQuat, out + i * texelsPerJoint);
+        }
+    }
+    frames = baked.data();
+
+    if (solveIK) {
+        // back to the pose the joints were in
+        for (size_t i = 0; i < n; ++i) {
+            skeleton[i]->setPosition(glm::vec4(restTranslations[i], 1));
+            skeleton[i]->setQuat(restRotations[i]);
+        }
+        Joint::updateTransforms(skeleton);
+    }
+}
+
+// write the frames to a cache file
+bool BakedPalettes::save(const QString &path) const {
+    if (isEmpty()) {
+        return false;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    PaletteCacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.jointCount = (uint32_t) jointCount;
+    header.frameCount = (uint32_t) frameCount;
+    header.texelsPerJoint = (uint32_t) texelsPerJoint;
+    header.rate = rate;
+
+    qint64 bytes = (qint64) (getTexelCount() * sizeof(glm::vec4));
+    return file.write((const char*) &header, sizeof(header)) == (qint64) sizeof(header)
+        && file.write((const char*) frames, bytes) == bytes;
+}
+
+// memory-map a cache file written by save()
+bool BakedPalettes::map(const QString &path) {
+    clear();
+    cacheFile.setFileName(path);
+    if (!cacheFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    PaletteCacheHeader header;
+    if (cacheFile.read((char*) &header, sizeof(header)) != (qint64) sizeof(header)
+            || std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+            || header.version != CACHE_VERSION
+            || (header.texelsPerJoint != LINEAR_TEXELS && header.texelsPerJoint != DUAL_QUAT_TEXELS)
+            || header.jointCount == 0 || header.frameCount == 0 || !(header.rate > 0)) {
+        cacheFile.close();
+        return false;
+    }
+
+    qint64 bytes = (qint64) header.frameCount * header.jointCount * header.texelsPerJoint
+                 * (qint64) sizeof(glm::vec4);
+    if (cacheFile.size() < (qint64) sizeof(header) + bytes) {
+        cacheFile.close();
+        return false;
+    }
+
+    // the header is 24 bytes, so the mapped vec4s are 8-byte aligned at worst,
+    // which is plenty for the float loads glm does
+    uchar* mapped = cacheFile.map(sizeof(header), bytes);
+    if (mapped == nullptr) {
+        cacheFile.close();
+        return false;
+    }
+
+    jointCount = header.jointCount;
+    frameCount = (int) header.frameCount;
+    texelsPerJoint = (int) header.texelsPerJoint;
+    rate = header.rate;
+    frames = (const glm::vec4*) mapped;
+    return true;
+}
+
+// drop the frames (and unmap the cache file)
+void BakedPalettes::clear() {
+    if (cacheFile.isOpen()) {
+        // closing the file releases its mappings
+        cacheFile.close();
+    }
+    baked.clear();
+    baked.shrink_to_fit();
+    frames = nullptr;
+    jointCount = 0;
+    frameCount = 0;
+    rate = 0;
+}
+
+// does the bake fit a skeleton of this many joints, skinned this way?
+bool BakedPalettes::matches(size_t joints, bool dualQuat) const {
+    return !isEmpty() && jointCount == joints
+        && texelsPerJoint == (dualQuat ? DUAL_QUAT_TEXELS : LINEAR_TEXELS);
+}
+
+// the frame showing time t (looping over the baked range)
+int BakedPalettes::frameAt(float t) const {
+    if (isEmpty()) {
+        return 0;
+    }
+    int f = (int) std::floor(t * rate + 0.5f) % frameCount;
+    return f < 0 ? f + frameCount : f;
+}
+
+// getter for whether there are frames
+bool BakedPalettes::isEmpty() const {
+    return frames == nullptr || frameCount == 0;
+}
+
+// getter for frame count
+int BakedPalettes::getFrameCount() const {
+    return frameCount;
+}
+
+// getter for rate
+float BakedPalettes::getRate() const {
+    return rate;
+}
+
+// getter for duration (time of the last frame)
+float BakedPalettes::getDuration() const {
+    return frameCount > 0 ? (frameCount - 1) / rate : 0;
+}
+
+// texels in one frame
+size_t BakedPalettes::getFrameTexels() const {
+    return jointCount * texelsPerJoint;
+}
+
+// texels in the whole bake
+size_t BakedPalettes::getTexelCount() const {
+    return (size_t) frameCount * getFrameTexels();
+}
+
+// getter for the frames
+const glm::vec4* BakedPalettes::getData() const {
+    return frames;
+}
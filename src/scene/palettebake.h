@@ -0,0 +1,83 @@
+#ifndef PALETTEBAKE_H
+#define PALETTEBAKE_H
+
+#include "animation.h"
+#include "joint.h"
+#include "ik.h"
+#include <la.h>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+/// BAKED PALETTES CLASS:
+/// the skinning palette of every frame of a clip, sampled at a fixed rate.
+/// Each frame is laid out exactly like MyGL's live joint palette (3 texels per
+/// joint for linear blend skinning, 2 for dual quaternions), and frames are
+/// stored back to back, so the whole bake can sit in one buffer texture and
+/// playback only has to pick a frame: no sampling, no hierarchy evaluation.
+///
+/// A bake can be saved to a cache file and later memory-mapped straight back
+/// in, in which case the frames are read from the mapping without a copy.
+
+class BakedPalettes {
+public:
+    // texels per joint in each layout
+    static const int LINEAR_TEXELS = 3;
+    static const int DUAL_QUAT_TEXELS = 2;
+
+private:
+    size_t jointCount;
+    int frameCount;
+    int texelsPerJoint;
+    float rate;                   // frames per second
+
+    std::vector<glm::vec4> baked; // frames computed by bake()
+    QFile cacheFile;              // mapped cache file, if the frames came from map()
+    const glm::vec4* frames;      // either baked.data() or the mapping
+
+public:
+    // an empty bake
+    BakedPalettes();
+
+    // write the palette entry (texelsPerJoint texels) of one joint's skin matrix
+    static void packSkinMatrix(const glm::mat4 &skin, bool dualQuat, glm::vec4* out);
+
+    // sample the clip at the given rate from 0 to its duration and store the
+    // palette of every frame; joints without keys keep their current pose.
+    // With IK handles, every frame is posed on the joints themselves and the
+    // handles are solved like in live playback; the joints are put back after
+    void bake(const AnimationClip &clip, const std::vector<Joint*> &skeleton,
+              float framesPerSecond, bool dualQuat,
+              std::vector<IKHandle>* handles = nullptr, ik::Solver solver = ik::CCD);
+
+    // write the frames to a cache file
+    bool save(const QString &path) const;
+
+    // memory-map a cache file written by save(); the frames stay mapped
+    // until the next bake(), map() or clear()
+    bool map(const QString &path);
+
+    // drop the frames (and unmap the cache file)
+    void clear();
+
+    // does the bake fit a skeleton of this many joints, skinned this way?
+    bool matches(size_t joints, bool dualQuat) const;
+
+    // the frame showing time t (looping over the baked range)
+    int frameAt(float t) const;
+
+    // getters
+    bool isEmpty() const;
+    int getFrameCount() const;
+    float getRate() const;
+    float getDuration() const;
+
+    // texels in one frame, and in the whole bake
+    size_t getFrameTexels() const;
+    size_t getTexelCount() const;
+
+    // all frames, back to back
+    const glm::vec4* getData() const;
+};
+
+#endif // PALETTEBAKE_H
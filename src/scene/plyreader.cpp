@@ -0,0 +1,626 @@
+#include "plyreader.h"
+#include "objreader.h"
+#include <parallel.h>
+#include <QFile>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+enum ScalarType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64, NO_TYPE };
+
+struct Property {
+    std::string name;
+    ScalarType type;        // item type for lists
+    ScalarType countType;   // NO_TYPE for scalars
+
+    bool isList() const { return countType != NO_TYPE; }
+};
+
+struct Element {
+    std::string name;
+    size_t count;
+    std::vector<Property> props;
+};
+
+struct Header {
+    bool binary;
+    std::vector<Element> elements;
+    size_t bodyOffset;
+};
+
+// where the properties we use sit in an element, -1 if it doesn't have them
+struct Layout {
+    int x, y, z;
+    int red, green, blue;
+    int indices;
+};
+
+static size_t typeSize(ScalarType type) {
+    static const size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return sizes[type];
+}
+
+static ScalarType parseType(const std::string &word) {
+    if (word == "char" || word == "int8") return INT8;
+    if (word == "uchar" || word == "uint8") return UINT8;
+    if (word == "short" || word == "int16") return INT16;
+    if (word == "ushort" || word == "uint16") return UINT16;
+    if (word == "int" || word == "int32") return INT32;
+    if (word == "uint" || word == "uint32") return UINT32;
+    if (word == "float" || word == "float32") return FLOAT32;
+    if (word == "double" || word == "float64") return FLOAT64;
+    return NO_TYPE;
+}
+
+static bool isIntegerType(ScalarType type) {
+    return type != FLOAT32 && type != FLOAT64;
+}
+
+// what an integer color channel is divided by
+static float colorScale(ScalarType type) {
+    switch (type) {
+    case INT8: return 127.f;
+    case UINT8: return 255.f;
+    case INT16: return 32767.f;
+    case UINT16: return 65535.f;
+    case INT32: return 2147483647.f;
+    case UINT32: return 4294967295.f;
+    default: return 1.f;
+    }
+}
+
+// the whitespace-separated words of [p, end)
+static std::vector<std::string> splitWords(const char* p, const char* end) {
+    std::vector<std::string> words;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+            ++p;
+        }
+        if (p > start) {
+            words.push_back(std::string(start, p));
+        }
+    }
+    return words;
+}
+
+// the fewest bytes a record of an element can take: its scalars and list
+// counts (lists can be empty) in binary, and in ASCII a digit and a
+// separator for each of them
+static size_t minRecordBytes(const Element &element, bool binary) {
+    size_t bytes = 0;
+    for (const Property &prop : element.props) {
+        bytes += binary ? typeSize(prop.isList() ? prop.countType : prop.type) : 2;
+    }
+    return bytes;
+}
+
+static bool parseHeader(const char* data, size_t size, Header &header) {
+    const char* p = data;
+    const char* end = data + size;
+    bool first = true;
+    bool haveFormat = false;
+    while (p < end) {
+        const char* eol = (const char*) std::memchr(p, '\n', end - p);
+        if (eol == nullptr) {
+            return false;
+        }
+        std::vector<std::string> words = splitWords(p, eol);
+        p = eol + 1;
+
+        if (first) {
+            if (words.size() != 1 || words[0] != "ply") {
+                return false;
+            }
+            first = false;
+        } else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        } else if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") {
+                header.binary = false;
+            } else if (words[1] == "binary_little_endian") {
+                header.binary = true;
+            } else {
+                return false;
+            }
+            haveFormat = true;
+        } else if (words[0] == "element" && words.size() == 3) {
+            char* countEnd = nullptr;
+            Element element;
+            element.name = words[1];
+            element.count = (size_t) std::strtoull(words[2].c_str(), &countEnd, 10);
+            if (*countEnd != '\0' || words[2][0] == '-') {
+                return false;
+            }
+            header.elements.push_back(element);
+        } else if (words[0] == "property" && !header.elements.empty()) {
+            Property prop;
+            if (words.size() == 5 && words[1] == "list") {
+                prop.countType = parseType(words[2]);
+                prop.type = parseType(words[3]);
+                prop.name = words[4];
+                if (prop.countType == NO_TYPE || prop.countType == FLOAT32 || prop.countType == FLOAT64) {
+                    return false;
+                }
+            } else if (words.size() == 3) {
+                prop.countType = NO_TYPE;
+                prop.type = parseType(words[1]);
+                prop.name = words[2];
+            } else {
+                return false;
+            }
+            if (prop.type == NO_TYPE) {
+                return false;
+            }
+            header.elements.back().props.push_back(prop);
+        } else if (words[0] == "end_header") {
+            header.bodyOffset = (size_t) (p - data);
+            if (!haveFormat) {
+                return false;
+            }
+            // element counts are what the body is sized by, so a count the rest of
+            // the file can't hold is rejected before anything is allocated for it
+            // (an ASCII body may end right after its last digit)
+            size_t remaining = size - header.bodyOffset + (header.binary ? 0 : 1);
+            for (const Element &element : header.elements) {
+                size_t recordBytes = minRecordBytes(element, header.binary);
+                if (recordBytes > 0) {
+                    if (element.count > remaining / recordBytes) {
+                        return false;
+                    }
+                    remaining -= element.count * recordBytes;
+                }
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+static int findProperty(const Element &element, const char* name, bool list) {
+    for (size_t i = 0; i < element.props.size(); ++i) {
+        if (element.props[i].name == name && element.props[i].isList() == list) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+static Layout findLayout(const Element &element) {
+    Layout layout;
+    layout.x = findProperty(element, "x", false);
+    layout.y = findProperty(element, "y", false);
+    layout.z = findProperty(element, "z", false);
+    layout.red = findProperty(element, "red", false);
+    layout.green = findProperty(element, "green", false);
+    layout.blue = findProperty(element, "blue", false);
+    layout.indices = findProperty(element, "vertex_indices", true);
+    if (layout.indices < 0) {
+        layout.indices = findProperty(element, "vertex_index", true);
+    }
+    return layout;
+}
+
+static bool hasColor(const Layout &layout) {
+    return layout.red >= 0 && layout.green >= 0 && layout.blue >= 0;
+}
+
+/// BINARY BODY:
+
+static double readNumber(const uint8_t* p, ScalarType type) {
+    switch (type) {
+    case INT8: { int8_t v; std::memcpy(&v, p, 1); return v; }
+    case UINT8: return *p;
+    case INT16: { int16_t v; std::memcpy(&v, p, 2); return v; }
+    case UINT16: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+    case INT32: { int32_t v; std::memcpy(&v, p, 4); return v; }
+    case UINT32: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    case FLOAT32: { float v; std::memcpy(&v, p, 4); return v; }
+    case FLOAT64: { double v; std::memcpy(&v, p, 8); return v; }
+    default: return 0;
+    }
+}
+
+// integer value of a list count or index; negative values come back as
+// huge unsigned ones, which every range check rejects
+static uint64_t readInteger(const uint8_t* p, ScalarType type) {
+    switch (type) {
+    case INT8: { int8_t v; std::memcpy(&v, p, 1); return (uint64_t) (int64_t) v; }
+    case UINT8: return *p;
+    case INT16: { int16_t v; std::memcpy(&v, p, 2); return (uint64_t) (int64_t) v; }
+    case UINT16: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+    case INT32: { int32_t v; std::memcpy(&v, p, 4); return (uint64_t) (int64_t) v; }
+    case UINT32: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    default: { double v = readNumber(p, type); return v >= 0 ? (uint64_t) v : ~0ull; }
+    }
+}
+
+// where each record of an element starts
+struct Records {
+    const uint8_t* base;
+    size_t stride;                  // record size when every record has the same size
+    std::vector<uint64_t> offsets;  // start of each record otherwise
+
+    const uint8_t* operator[](size_t i) const {
+        return base + (offsets.empty() ? i * stride : offsets[i]);
+    }
+};
+
+// find the records of an element starting at p, advancing p past them;
+// false if they don't fit in the file
+static bool indexRecords(const Element &element, const uint8_t* &p, const uint8_t* end, Records &records) {
+    records.base = p;
+    records.stride = 0;
+    bool fixed = true;
+    for (const Property &prop : element.props) {
+        fixed = fixed && !prop.isList();
+        records.stride += typeSize(prop.type);
+    }
+    if (fixed) {
+        if (records.stride > 0 && element.count > (size_t) (end - p) / records.stride) {
+            return false;
+        }
+        p += element.count * records.stride;
+        return true;
+    }
+
+    // list lengths vary, so this pass is sequential; it only reads counts
+    records.offsets.resize(element.count);
+    for (size_t i = 0; i < element.count; ++i) {
+        records.offsets[i] = (uint64_t) (p - records.base);
+        for (const Property &prop : element.props) {
+            size_t itemSize = typeSize(prop.type);
+            if (prop.isList()) {
+                size_t countSize = typeSize(prop.countType);
+                if ((size_t) (end - p) < countSize) {
+                    return false;
+                }
+                uint64_t n = readInteger(p, prop.countType);
+                p += countSize;
+                if (n > (size_t) (end - p) / itemSize) {
+                    return false;
+                }
+                p += n * itemSize;
+            } else {
+                if ((size_t) (end - p) < itemSize) {
+                    return false;
+                }
+                p += itemSize;
+            }
+        }
+    }
+    return true;
+}
+
+// start of every property of a record that indexRecords() accepted, in one walk
+static void locate(const Element &element, const uint8_t* record, const uint8_t** at) {
+    const uint8_t* p = record;
+    for (size_t i = 0; i < element.props.size(); ++i) {
+        const Property &prop = element.props[i];
+        at[i] = p;
+        if (prop.isList()) {
+            uint64_t n = readInteger(p, prop.countType);
+            p += typeSize(prop.countType) + n * typeSize(prop.type);
+        } else {
+            p += typeSize(prop.type);
+        }
+    }
+}
+
+static glm::vec4 readColor(const Element &element, const Layout &layout, const uint8_t* const* at) {
+    const int channels[3] = {layout.red, layout.green, layout.blue};
+    glm::vec4 color(0, 0, 0, 1);
+    for (int c = 0; c < 3; ++c) {
+        ScalarType type = element.props[channels[c]].type;
+        color[c] = (float) readNumber(at[channels[c]], type) / colorScale(type);
+    }
+    return color;
+}
+
+static void readVerticesBinary(const Element &element, const Records &records,
+                               MeshArrays &arrays, std::vector<glm::vec4> &colors) {
+    Layout layout = findLayout(element);
+    bool color = hasColor(layout);
+    size_t n = element.count;
+    arrays.positions.resize(n);
+    colors.resize(color ? n : 0);
+
+    // x, y, z as three floats in a row: straight copy
+    const std::vector<Property> &props = element.props;
+    bool packed = records.offsets.empty() && layout.y == layout.x + 1 && layout.z == layout.x + 2
+            && props[layout.x].type == FLOAT32 && props[layout.y].type == FLOAT32
+            && props[layout.z].type == FLOAT32;
+    size_t xOffset = 0;
+    for (int i = 0; i < layout.x; ++i) {
+        xOffset += typeSize(props[i].type);
+    }
+
+    parallel::forRange(n, 1 << 14, [&](size_t begin, size_t end) {
+        std::vector<const uint8_t*> at(props.size());
+        for (size_t v = begin; v < end; ++v) {
+            const uint8_t* record = records[v];
+            glm::vec4 &pos = arrays.positions[v];
+            if (packed) {
+                std::memcpy(&pos[0], record + xOffset, 3 * sizeof(float));
+            }
+            if (!packed || color) {
+                locate(element, record, at.data());
+            }
+            if (!packed) {
+                pos[0] = (float) readNumber(at[layout.x], props[layout.x].type);
+                pos[1] = (float) readNumber(at[layout.y], props[layout.y].type);
+                pos[2] = (float) readNumber(at[layout.z], props[layout.z].type);
+            }
+            pos[3] = 1;
+            if (color) {
+                colors[v] = readColor(element, layout, at.data());
+            }
+        }
+    });
+}
+
+static bool readFacesBinary(const Element &element, const Records &records, size_t vertCount,
+                            MeshArrays &arrays) {
+    Layout layout = findLayout(element);
+    bool color = hasColor(layout);
+    const Property &list = element.props[layout.indices];
+    size_t countSize = typeSize(list.countType);
+
+    // corner counts are independent once the records are known
+    std::vector<uint32_t> counts(element.count);
+    parallel::forRange(element.count, 1 << 14, [&](size_t begin, size_t end) {
+        std::vector<const uint8_t*> at(element.props.size());
+        for (size_t f = begin; f < end; ++f) {
+            locate(element, records[f], at.data());
+            uint64_t n = readInteger(at[layout.indices], list.countType);
+            counts[f] = n >= 3 && n <= 0xffffffffu ? (uint32_t) n : 0;
+        }
+    });
+
+    // prefix sum over the faces that are kept
+    std::vector<uint32_t> kept;
+    kept.reserve(element.count);
+    arrays.faceOffsets.clear();
+    arrays.faceOffsets.reserve(element.count + 1);
+    uint64_t corners = 0;
+    for (size_t f = 0; f < element.count; ++f) {
+        if (counts[f] != 0) {
+            kept.push_back((uint32_t) f);
+            arrays.faceOffsets.push_back((uint32_t) corners);
+            corners += counts[f];
+        }
+    }
+    if (corners > 0xffffffffu) {
+        return false;
+    }
+    arrays.faceOffsets.push_back((uint32_t) corners);
+    arrays.corners.resize((size_t) corners);
+    arrays.faceColors.resize(color ? kept.size() : 0);
+
+    std::atomic<bool> badIndex(false);
+    parallel::forRange(kept.size(), 1 << 14, [&](size_t begin, size_t end) {
+        bool bad = false;
+        std::vector<const uint8_t*> at(element.props.size());
+        for (size_t i = begin; i < end; ++i) {
+            locate(element, records[kept[i]], at.data());
+            const uint8_t* items = at[layout.indices] + countSize;
+            uint32_t* out = &arrays.corners[arrays.faceOffsets[i]];
+            uint32_t n = counts[kept[i]];
+            if (list.type == INT32 || list.type == UINT32) {
+                std::memcpy(out, items, n * sizeof(uint32_t));
+            } else {
+                size_t itemSize = typeSize(list.type);
+                for (uint32_t c = 0; c < n; ++c) {
+                    uint64_t index = readInteger(items + c * itemSize, list.type);
+                    out[c] = index < vertCount ? (uint32_t) index : 0xffffffffu;
+                }
+            }
+            for (uint32_t c = 0; c < n; ++c) {
+                bad = bad || out[c] >= vertCount;
+            }
+            if (color) {
+                arrays.faceColors[i] = readColor(element, layout, at.data());
+            }
+        }
+        if (bad) {
+            badIndex = true;
+        }
+    });
+    return !badIndex;
+}
+
+static bool parseBinary(const char* data, size_t size, const Header &header,
+                        MeshArrays &arrays, std::vector<glm::vec4> &vertexColors) {
+    const uint8_t* p = (const uint8_t*) data + header.bodyOffset;
+    const uint8_t* end = (const uint8_t*) data + size;
+    for (const Element &element : header.elements) {
+        Records records;
+        if (!indexRecords(element, p, end, records)) {
+            return false;
+        }
+        if (element.name == "vertex") {
+            readVerticesBinary(element, records, arrays, vertexColors);
+        } else if (element.name == "face" && findLayout(element).indices >= 0) {
+            if (!readFacesBinary(element, records, arrays.positions.size(), arrays)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// ASCII BODY:
+
+// whitespace-separated numbers
+struct AsciiCursor {
+    const char* p;
+    const char* end;
+
+    bool next(ScalarType type, double &value) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+            ++p;
+        }
+        if (isIntegerType(type)) {
+            long long v;
+            if (!objreader::parseInt(p, end, v)) {
+                return false;
+            }
+            value = (double) v;
+        } else {
+            float v;
+            if (!objreader::parseFloat(p, end, v)) {
+                return false;
+            }
+            value = v;
+        }
+        return true;
+    }
+};
+
+static bool parseAscii(const char* data, size_t size, const Header &header,
+                       MeshArrays &arrays, std::vector<glm::vec4> &vertexColors) {
+    AsciiCursor cursor = {data + header.bodyOffset, data + size};
+    std::vector<double> values;
+    std::vector<uint32_t> faceCorners;
+    for (const Element &element : header.elements) {
+        Layout layout = findLayout(element);
+        bool vertex = element.name == "vertex";
+        bool face = element.name == "face" && layout.indices >= 0;
+        bool color = hasColor(layout);
+        if (vertex) {
+            arrays.positions.reserve(element.count);
+            if (color) {
+                vertexColors.reserve(element.count);
+            }
+        }
+
+        values.resize(element.props.size());
+        for (size_t r = 0; r < element.count; ++r) {
+            faceCorners.clear();
+            for (size_t i = 0; i < element.props.size(); ++i) {
+                const Property &prop = element.props[i];
+                if (!prop.isList()) {
+                    if (!cursor.next(prop.type, values[i])) {
+                        return false;
+                    }
+                    continue;
+                }
+                double count;
+                if (!cursor.next(prop.countType, count) || count < 0) {
+                    return false;
+                }
+                for (size_t c = 0; c < (size_t) count; ++c) {
+                    double index;
+                    if (!cursor.next(prop.type, index)) {
+                        return false;
+                    }
+                    if (face && (int) i == layout.indices) {
+                        if (index < 0 || index >= (double) arrays.positions.size()) {
+                            return false;
+                        }
+                        faceCorners.push_back((uint32_t) index);
+                    }
+                }
+            }
+
+            const int channels[3] = {layout.red, layout.green, layout.blue};
+            glm::vec4 c(0, 0, 0, 1);
+            if (color) {
+                for (int k = 0; k < 3; ++k) {
+                    c[k] = (float) values[channels[k]] / colorScale(element.props[channels[k]].type);
+                }
+            }
+            if (vertex) {
+                arrays.positions.push_back(glm::vec4((float) values[layout.x], (float) values[layout.y], (float) values[layout.z], 1.f));
+                if (color) {
+                    vertexColors.push_back(c);
+                }
+            } else if (face && faceCorners.size() >= 3) {
+                arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+                arrays.corners.insert(arrays.corners.end(), faceCorners.begin(), faceCorners.end());
+                if (color) {
+                    arrays.faceColors.push_back(c);
+                }
+            }
+        }
+    }
+    arrays.faceOffsets.push_back((uint32_t) arrays.corners.size());
+    return true;
+}
+
+bool plyreader::parse(const char* data, size_t size, MeshArrays &arrays) {
+    Header header;
+    if (!parseHeader(data, size, header)) {
+        return false;
+    }
+
+    // vertices come before the faces that index them, and need positions
+    bool seenVertex = false;
+    for (const Element &element : header.elements) {
+        if (element.name == "vertex") {
+            Layout layout = findLayout(element);
+            if (seenVertex || layout.x < 0 || layout.y < 0 || layout.z < 0) {
+                return false;
+            }
+            seenVertex = true;
+        } else if (element.name == "face" && !seenVertex) {
+            return false;
+        }
+    }
+
+    arrays.positions.clear();
+    arrays.faceOffsets.clear();
+    arrays.corners.clear();
+    arrays.faceColors.clear();
+    arrays.skinWeights.clear();
+    std::vector<glm::vec4> vertexColors;
+    bool ok = header.binary ? parseBinary(data, size, header, arrays, vertexColors)
+                            : parseAscii(data, size, header, arrays, vertexColors);
+    if (!ok) {
+        return false;
+    }
+    if (arrays.faceOffsets.empty()) {
+        arrays.faceOffsets.push_back(0);
+    }
+
+    // the mesh only has face colors: average the corners' vertex colors
+    if (arrays.faceColors.empty() && !vertexColors.empty()) {
+        arrays.faceColors.resize(arrays.faceCount());
+        parallel::forRange(arrays.faceCount(), 1 << 14, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                glm::vec4 sum(0);
+                for (uint32_t h = arrays.faceOffsets[f]; h < arrays.faceOffsets[f + 1]; ++h) {
+                    sum += vertexColors[arrays.corners[h]];
+                }
+                arrays.faceColors[f] = sum / (float) (arrays.faceOffsets[f + 1] - arrays.faceOffsets[f]);
+            }
+        });
+    }
+    return true;
+}
+
+bool plyreader::read(const QString &path, MeshArrays &arrays) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    if (size <= 0) {
+        return false;
+    }
+    const uchar* mapped = file.map(0, size);
+    if (mapped == nullptr) {
+        return false;
+    }
+    bool ok = parse((const char*) mapped, (size_t) size, arrays);
+    file.unmap((uchar*) mapped);
+    return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef PLYREADER_H
+#define PLYREADER_H
+
+#include "mesharrays.h"
+#include <QString>
+#include <cstddef>
+
+/// Stanford PLY reader (ascii and binary_little_endian).
+///
+/// The header is parsed into elements and typed properties; of the body only
+/// vertex x, y, z (and red, green, blue), face vertex_indices (or
+/// vertex_index) lists (and red, green, blue) are used, and any other element
+/// or property is skipped. Binary files are memory-mapped and read in place:
+/// one sequential pass finds where every variable-length record starts, and
+/// the records are then copied into the mesh arrays in parallel, with float
+/// positions and 32-bit indices going through memcpy. Color channels may be
+/// any type; integers are scaled to [0, 1] by their type's maximum.
+///
+/// The mesh only has face colors, so vertex colors are averaged over each
+/// face's corners when the file has no face colors of its own. Faces with
+/// fewer than three corners are dropped.
+
+namespace plyreader {
+    // parse a whole PLY file; false if it's malformed, truncated (element
+    // counts the body can't hold are caught in the header) or refers to a
+    // vertex that doesn't exist
+    bool parse(const char* data, size_t size, MeshArrays &arrays);
+
+    // map and parse a PLY file into flat mesh arrays (faces get colors only
+    // if the file has face or vertex colors)
+    bool read(const QString &path, MeshArrays &arrays);
+}
+
+#endif // PLYREADER_H
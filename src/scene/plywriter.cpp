@@ -0,0 +1,126 @@
+#include "plywriter.h"
+#include "objwriter.h"
+#include "chunkedwriter.h"
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// a color channel as uchar
+static uint8_t quantize(float c) {
+    return (uint8_t) (std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// records of vertices [begin, end), with their normals if normals is set
+static void formatVertices(const MeshArrays &arrays, size_t begin, size_t end, bool binary, bool normals,
+                           std::string &text) {
+    int values = normals ? 6 : 3;
+    size_t recordBytes = values * (binary ? sizeof(float) : objwriter::MAX_FLOAT_CHARS + 1);
+    text.resize((end - begin) * recordBytes);
+    char* start = &text[0];
+    char* p = start;
+    for (size_t v = begin; v < end; ++v) {
+        const glm::vec4 &pos = arrays.positions[v];
+        if (binary) {
+            std::memcpy(p, &pos[0], 3 * sizeof(float));
+            p += 3 * sizeof(float);
+            if (normals) {
+                std::memcpy(p, &arrays.normals[v][0], 3 * sizeof(float));
+                p += 3 * sizeof(float);
+            }
+        } else {
+            for (int i = 0; i < values; ++i) {
+                p += objwriter::formatFloat(i < 3 ? pos[i] : arrays.normals[v][i - 3], p);
+                *p++ = i < values - 1 ? ' ' : '\n';
+            }
+        }
+    }
+    text.resize(p - start);
+}
+
+// records of faces [begin, end)
+static void formatFaces(const MeshArrays &arrays, size_t begin, size_t end, bool binary,
+                        bool wideCounts, bool colors, std::string &text) {
+    size_t corners = arrays.faceOffsets[end] - arrays.faceOffsets[begin];
+    size_t faceBytes = binary ? sizeof(int32_t) + 3 : objwriter::MAX_UINT_CHARS + 1 + 3 * 4;
+    size_t cornerBytes = binary ? sizeof(int32_t) : objwriter::MAX_UINT_CHARS + 1;
+    text.resize((end - begin) * faceBytes + corners * cornerBytes);
+    char* start = &text[0];
+    char* p = start;
+    for (size_t f = begin; f < end; ++f) {
+        uint32_t first = arrays.faceOffsets[f];
+        uint32_t count = arrays.faceOffsets[f + 1] - first;
+        if (binary) {
+            if (wideCounts) {
+                std::memcpy(p, &count, sizeof(uint32_t));
+                p += sizeof(uint32_t);
+            } else {
+                *p++ = (char) count;
+            }
+            // the int indices are the corners as they are
+            std::memcpy(p, &arrays.corners[first], count * sizeof(uint32_t));
+            p += count * sizeof(uint32_t);
+        } else {
+            p += objwriter::formatUInt(count, p);
+            for (uint32_t h = first; h < first + count; ++h) {
+                *p++ = ' ';
+                p += objwriter::formatUInt(arrays.corners[h], p);
+            }
+        }
+        if (colors) {
+            const glm::vec4 &c = arrays.faceColors[f];
+            for (int i = 0; i < 3; ++i) {
+                if (binary) {
+                    *p++ = (char) quantize(c[i]);
+                } else {
+                    *p++ = ' ';
+                    p += objwriter::formatUInt(quantize(c[i]), p);
+                }
+            }
+        }
+        if (!binary) {
+            *p++ = '\n';
+        }
+    }
+    text.resize(p - start);
+}
+
+// write arrays to a PLY file
+bool plywriter::write(const QString &path, const MeshArrays &arrays, bool binary, bool faceColors) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    size_t vertCount = arrays.positions.size();
+    size_t faceCount = arrays.faceCount();
+    bool colors = faceColors && arrays.faceColors.size() == faceCount;
+    bool normals = arrays.hasNormals();
+    bool wideCounts = false;
+    for (size_t f = 0; f < faceCount && !wideCounts; ++f) {
+        wideCounts = arrays.faceOffsets[f + 1] - arrays.faceOffsets[f] > 255;
+    }
+
+    std::string header = "ply\n";
+    header += binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n";
+    header += "element vertex " + std::to_string(vertCount) + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n";
+    if (normals) {
+        header += "property float nx\nproperty float ny\nproperty float nz\n";
+    }
+    header += "element face " + std::to_string(faceCount) + "\n";
+    header += wideCounts ? "property list uint int vertex_indices\n" : "property list uchar int vertex_indices\n";
+    if (colors) {
+        header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    }
+    header += "end_header\n";
+    bool ok = file.write(header.data(), (qint64) header.size()) == (qint64) header.size();
+    ok = ok && chunkedwriter::write(file, vertCount,
+        [&](size_t begin, size_t end, std::string &text) {
+            formatVertices(arrays, begin, end, binary, normals, text);
+        }, faceCount,
+        [&](size_t begin, size_t end, std::string &text) {
+            formatFaces(arrays, begin, end, binary, wideCounts, colors, text);
+        });
+    file.close();
+    return ok && file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,23 @@
+#ifndef PLYWRITER_H
+#define PLYWRITER_H
+
+#include "mesharrays.h"
+#include <QString>
+
+/// Stanford PLY writer (ascii or binary_little_endian).
+///
+/// Vertices are written as float x, y, z (then nx, ny, nz if the arrays have
+/// vertex normals) and faces as a vertex_indices list
+/// (uchar counts, or int counts if a face has more than 255 corners) of int
+/// indices, followed by uchar red, green, blue when face colors are written.
+/// Like the OBJ writer, chunks of vertices and faces are formatted in
+/// parallel and written in order; binary records are assembled with memcpy
+/// in the host's byte order, which is assumed to be little-endian.
+
+namespace plywriter {
+    // write arrays to a PLY file, with their vertex normals if they have them
+    // and face colors if asked
+    bool write(const QString &path, const MeshArrays &arrays, bool binary, bool faceColors);
+}
+
+#endif // PLYWRITER_H
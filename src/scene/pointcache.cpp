@@ -0,0 +1,481 @@
+#include "pointcache.h"
+#include <parallel.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+static const char MAGIC[8] = {'M', 'M', 'P', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t VERSION = 1;
+
+// vertices per parallel block when encoding and decoding
+static const size_t GRAIN = 1 << 14;
+
+// frames start on multiples of this, so their positions can be used in place
+static const uint64_t FRAME_ALIGNMENT = 16;
+
+// the start of a file; frameCount and tableOffset are filled in by close()
+struct PointCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t vertexCount;
+    uint64_t frameCount;
+    float rate;
+    uint32_t reserved;
+    uint64_t tableOffset;
+};
+
+enum FrameType {
+    RAW,
+    KEY,
+    DELTA
+};
+
+// the start of a frame; quantized positions are origin + step * grid coordinates
+struct FrameHeader {
+    uint32_t type;
+    uint32_t keyFrame;  // the frame itself, or the KEY frame a DELTA frame builds on
+    float origin[3];
+    float step;
+    uint32_t reserved[2];
+};
+
+// bytes of a frame's positions
+static uint64_t payloadBytes(uint32_t type, uint64_t vertexCount) {
+    switch (type) {
+    case RAW: return vertexCount * 3 * sizeof(float);
+    case KEY: return vertexCount * 3 * sizeof(uint16_t);
+    default: return vertexCount * 3 * sizeof(int8_t);
+    }
+}
+
+// bytes of a frame's normals, which follow its positions in NORMALS files
+static uint64_t normalBytes(uint32_t flags, uint64_t vertexCount) {
+    return flags & pointcache::NORMALS ? vertexCount * 2 * sizeof(int16_t) : 0;
+}
+
+// a unit normal folded onto the octahedron and quantized to two snorm16s
+// (zero and NaN normals come back as +z)
+static inline void encodeNormal(const glm::vec4 &n, int16_t* out) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float u = 0, v = 0;
+    if (sum > 0) {
+        u = n.x / sum;
+        v = n.y / sum;
+        if (n.z < 0) {
+            float fu = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+            v = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+            u = fu;
+        }
+    }
+    out[0] = (int16_t) std::floor(std::max(std::min(u, 1.f), -1.f) * 32767 + 0.5f);
+    out[1] = (int16_t) std::floor(std::max(std::min(v, 1.f), -1.f) * 32767 + 0.5f);
+}
+
+// the unit normal of an encodeNormal pair
+static inline glm::vec4 decodeNormal(const int16_t* in) {
+    float u = std::max(in[0] / 32767.f, -1.f);
+    float v = std::max(in[1] / 32767.f, -1.f);
+    glm::vec3 n(u, v, 1 - std::abs(u) - std::abs(v));
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0 ? -t : t;
+    n.y += n.y >= 0 ? -t : t;
+    return glm::vec4(glm::normalize(n), 0);
+}
+
+// a grid coordinate, or -1 if the coordinate is off the grid
+static inline float gridCoord(float p, float origin, float step) {
+    float q = std::floor((p - origin) / step + 0.5f);
+    return q >= 0 && q <= 65535 ? q : -1;
+}
+
+PointCacheWriter::PointCacheWriter() :
+    vertexCount(0),
+    flags(0),
+    rate(0),
+    step(0),
+    keyFrame(0),
+    failed(false)
+{
+    origin[0] = origin[1] = origin[2] = 0;
+}
+
+PointCacheWriter::~PointCacheWriter() {
+    if (file.isOpen()) {
+        close();
+    }
+}
+
+// start a cache; the header is written again by close()
+bool PointCacheWriter::open(const QString &path, size_t vertices, float framesPerSecond, uint32_t fl) {
+    if (file.isOpen()) {
+        close();
+    }
+    if (vertices == 0 || vertices > UINT32_MAX || !(framesPerSecond > 0)) {
+        return false;
+    }
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    vertexCount = vertices;
+    flags = fl;
+    rate = framesPerSecond;
+    offsets.clear();
+    quantized.assign(3 * vertices, 0);
+    keyFrame = 0;
+    failed = false;
+
+    PointCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    failed = file.write((const char*) &header, sizeof(header)) != (qint64) sizeof(header);
+    return !failed;
+}
+
+// write the next frame
+bool PointCacheWriter::append(const glm::vec4* positions, const glm::vec4* normals) {
+    if (!file.isOpen() || failed || ((flags & pointcache::NORMALS) && normals == nullptr)) {
+        return false;
+    }
+    uint32_t frame = (uint32_t) offsets.size();
+    size_t n = (size_t) vertexCount;
+
+    FrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.type = RAW;
+    header.keyFrame = frame;
+
+    if (flags & pointcache::QUANTIZED) {
+        // a DELTA frame if every vertex stays on the grid and moved less than 128 steps
+        bool delta = (flags & pointcache::DELTA) && frame > 0 && frame - keyFrame < pointcache::KEY_INTERVAL;
+        if (delta) {
+            block.resize(sizeof(header) + payloadBytes(DELTA, n));
+            int8_t* out = (int8_t*) (block.data() + sizeof(header));
+            std::atomic<bool> fits(true);
+            parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end && fits; ++i) {
+                    for (int k = 0; k < 3; ++k) {
+                        float q = gridCoord(positions[i][k], origin[k], step);
+                        float d = q - quantized[3 * i + k];
+                        if (q < 0 || d < -127 || d > 127) {
+                            fits = false;
+                            break;
+                        }
+                        // a KEY frame redoes every coordinate if some other vertex doesn't fit
+                        out[3 * i + k] = (int8_t) d;
+                        quantized[3 * i + k] = (uint16_t) q;
+                    }
+                }
+            });
+            delta = fits;
+            if (delta) {
+                header.type = DELTA;
+                header.keyFrame = keyFrame;
+            }
+        }
+
+        if (!delta) {
+            // a new grid, centered on the frame's bounds, one and a half times their
+            // longest side wide (a flat or collapsed frame still gets a usable step)
+            glm::vec3 boundsMin(positions[0]);
+            glm::vec3 boundsMax(positions[0]);
+            for (size_t i = 1; i < n; ++i) {
+                boundsMin = glm::min(boundsMin, glm::vec3(positions[i]));
+                boundsMax = glm::max(boundsMax, glm::vec3(positions[i]));
+            }
+            glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+            glm::vec3 extent = boundsMax - boundsMin;
+            float side = std::max(extent.x, std::max(extent.y, extent.z));
+            float scale = std::max(std::abs(center.x), std::max(std::abs(center.y), std::abs(center.z)));
+            step = std::max(1.5f * side, 1e-6f * (1 + scale)) / 65535;
+            for (int k = 0; k < 3; ++k) {
+                origin[k] = center[k] - 32768 * step;
+            }
+
+            block.resize(sizeof(header) + payloadBytes(KEY, n));
+            uint16_t* out = (uint16_t*) (block.data() + sizeof(header));
+            parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (int k = 0; k < 3; ++k) {
+                        // only NaNs fall off the grid
+                        float q = gridCoord(positions[i][k], origin[k], step);
+                        out[3 * i + k] = quantized[3 * i + k] = (uint16_t) std::max(q, 0.f);
+                    }
+                }
+            });
+            header.type = KEY;
+            keyFrame = frame;
+        }
+        std::memcpy(header.origin, origin, sizeof(origin));
+        header.step = step;
+    } else {
+        block.resize(sizeof(header) + payloadBytes(RAW, n));
+        float* out = (float*) (block.data() + sizeof(header));
+        parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                out[3 * i] = positions[i].x;
+                out[3 * i + 1] = positions[i].y;
+                out[3 * i + 2] = positions[i].z;
+            }
+        });
+    }
+
+    if (flags & pointcache::NORMALS) {
+        size_t start = block.size();
+        block.resize(start + normalBytes(flags, n));
+        int16_t* out = (int16_t*) (block.data() + start);
+        parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                encodeNormal(normals[i], out + 2 * i);
+            }
+        });
+    }
+
+    std::memcpy(block.data(), &header, sizeof(header));
+    block.resize((block.size() + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT, 0);
+
+    offsets.push_back((uint64_t) file.pos());
+    failed = file.write(block.data(), (qint64) block.size()) != (qint64) block.size();
+    return !failed;
+}
+
+// write the frame table and the header
+bool PointCacheWriter::close() {
+    if (!file.isOpen()) {
+        return false;
+    }
+
+    PointCacheHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = flags;
+    header.vertexCount = vertexCount;
+    header.frameCount = offsets.size();
+    header.rate = rate;
+    header.reserved = 0;
+    header.tableOffset = (uint64_t) file.pos();
+
+    qint64 tableBytes = (qint64) (offsets.size() * sizeof(uint64_t));
+    bool ok = !failed && !offsets.empty()
+        && file.write((const char*) offsets.data(), tableBytes) == tableBytes
+        && file.seek(0)
+        && file.write((const char*) &header, sizeof(header)) == (qint64) sizeof(header);
+    file.close();
+    offsets.clear();
+    quantized.clear();
+    quantized.shrink_to_fit();
+    block.clear();
+    block.shrink_to_fit();
+    return ok;
+}
+
+// frames appended so far
+size_t PointCacheWriter::getFrameCount() const {
+    return offsets.size();
+}
+
+PointCacheReader::PointCacheReader() :
+    base(nullptr),
+    fileSize(0),
+    vertexCount(0),
+    flags(0),
+    rate(0),
+    decodedFrame(-1)
+{}
+
+PointCacheReader::~PointCacheReader() {
+    close();
+}
+
+// map a file written by PointCacheWriter and check its frames
+bool PointCacheReader::open(const QString &path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    fileSize = (uint64_t) file.size();
+    PointCacheHeader header;
+    if (fileSize >= sizeof(header)) {
+        base = file.map(0, (qint64) fileSize);
+    }
+    if (base == nullptr) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    // the table is the end of the file and every frame fits before it
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+            || header.vertexCount == 0 || header.vertexCount > UINT32_MAX
+            || header.frameCount == 0 || header.frameCount > INT32_MAX || !(header.rate > 0)
+            || header.tableOffset < sizeof(header) || header.tableOffset > fileSize
+            || (fileSize - header.tableOffset) / sizeof(uint64_t) != header.frameCount
+            || (fileSize - header.tableOffset) % sizeof(uint64_t) != 0) {
+        close();
+        return false;
+    }
+    offsets.resize((size_t) header.frameCount);
+    std::memcpy(offsets.data(), base + header.tableOffset, offsets.size() * sizeof(uint64_t));
+
+    for (size_t f = 0; f < offsets.size(); ++f) {
+        uint64_t offset = offsets[f];
+        FrameHeader frame;
+        if (offset < sizeof(header) || offset % FRAME_ALIGNMENT != 0
+                || offset > header.tableOffset || header.tableOffset - offset < sizeof(frame)) {
+            close();
+            return false;
+        }
+        std::memcpy(&frame, base + offset, sizeof(frame));
+
+        // a DELTA frame follows its KEY frame or another DELTA frame on the same grid
+        bool valid = frame.type <= DELTA
+            && header.tableOffset - offset - sizeof(frame)
+               >= payloadBytes(frame.type, header.vertexCount) + normalBytes(header.flags, header.vertexCount);
+        if (valid && frame.type == DELTA) {
+            FrameHeader previous;
+            valid = f > 0 && frame.keyFrame < f;
+            if (valid) {
+                std::memcpy(&previous, base + offsets[f - 1], sizeof(previous));
+                valid = previous.type != RAW && previous.keyFrame == frame.keyFrame;
+            }
+        } else if (valid) {
+            valid = frame.keyFrame == f;
+        }
+        if (!valid) {
+            close();
+            return false;
+        }
+    }
+
+    vertexCount = header.vertexCount;
+    flags = header.flags;
+    rate = header.rate;
+    quantized.assign((size_t) (3 * vertexCount), 0);
+    decodedFrame = -1;
+    return true;
+}
+
+// unmap the file
+void PointCacheReader::close() {
+    if (file.isOpen()) {
+        // closing the file releases its mapping
+        file.close();
+    }
+    base = nullptr;
+    fileSize = 0;
+    vertexCount = 0;
+    flags = 0;
+    rate = 0;
+    offsets.clear();
+    quantized.clear();
+    quantized.shrink_to_fit();
+    decodedFrame = -1;
+}
+
+// decode one frame into the grid coordinates: a KEY frame on its own, a DELTA
+// frame from the frame decoded last if it's on the way (playback), otherwise
+// from its KEY frame (a seek)
+void PointCacheReader::decodeQuantized(int frame) {
+    FrameHeader header;
+    std::memcpy(&header, base + offsets[frame], sizeof(header));
+    int from = (int) header.keyFrame;
+    if (decodedFrame >= from && decodedFrame <= frame) {
+        from = decodedFrame + 1;
+    }
+
+    size_t count = (size_t) (3 * vertexCount);
+    for (int f = from; f <= frame; ++f) {
+        const uchar* payload = base + offsets[f] + sizeof(FrameHeader);
+        if (f == (int) header.keyFrame) {
+            std::memcpy(quantized.data(), payload, count * sizeof(uint16_t));
+        } else {
+            const int8_t* deltas = (const int8_t*) payload;
+            parallel::forRange(count, 3 * GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    quantized[i] = (uint16_t) (quantized[i] + deltas[i]);
+                }
+            });
+        }
+    }
+    decodedFrame = frame;
+}
+
+// the positions of a frame, and its normals if asked for and stored
+bool PointCacheReader::readFrame(int frame, glm::vec4* positions, glm::vec4* normals) {
+    if (base == nullptr || frame < 0 || frame >= (int) offsets.size()
+            || (normals != nullptr && !hasNormals())) {
+        return false;
+    }
+    FrameHeader header;
+    std::memcpy(&header, base + offsets[frame], sizeof(header));
+    size_t n = (size_t) vertexCount;
+
+    if (normals != nullptr) {
+        const uchar* in = base + offsets[frame] + sizeof(header) + payloadBytes(header.type, n);
+        parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                // the payloads before them are multiples of 2 bytes long
+                normals[i] = decodeNormal((const int16_t*) in + 2 * i);
+            }
+        });
+    }
+
+    if (header.type == RAW) {
+        const float* in = (const float*) (base + offsets[frame] + sizeof(header));
+        parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                positions[i] = glm::vec4(in[3 * i], in[3 * i + 1], in[3 * i + 2], 1);
+            }
+        });
+        return true;
+    }
+
+    decodeQuantized(frame);
+    glm::vec3 origin(header.origin[0], header.origin[1], header.origin[2]);
+    float step = header.step;
+    parallel::forRange(n, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 q(quantized[3 * i], quantized[3 * i + 1], quantized[3 * i + 2]);
+            positions[i] = glm::vec4(origin + step * q, 1);
+        }
+    });
+    return true;
+}
+
+// the frame showing time t (looping over the cache)
+int PointCacheReader::frameAt(float t) const {
+    int frameCount = getFrameCount();
+    if (frameCount == 0) {
+        return 0;
+    }
+    int f = (int) std::floor(t * rate + 0.5f) % frameCount;
+    return f < 0 ? f + frameCount : f;
+}
+
+// getter for whether a cache is mapped
+bool PointCacheReader::isOpen() const {
+    return base != nullptr;
+}
+
+// getter for whether frames carry normals
+bool PointCacheReader::hasNormals() const {
+    return (flags & pointcache::NORMALS) != 0;
+}
+
+// getter for vertex count
+size_t PointCacheReader::getVertexCount() const {
+    return (size_t) vertexCount;
+}
+
+// getter for frame count
+int PointCacheReader::getFrameCount() const {
+    return (int) offsets.size();
+}
+
+// getter for rate
+float PointCacheReader::getRate() const {
+    return rate;
+}
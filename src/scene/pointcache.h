@@ -0,0 +1,124 @@
+#ifndef POINTCACHE_H
+#define POINTCACHE_H
+
+#include <la.h>
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+/// Point cache: the deformed vertex positions (and, optionally, normals) of
+/// every frame of a shot.
+///
+/// A file is a 48-byte header (magic "MMPCACHE", version, flags, vertex and
+/// frame counts, rate and the offset of the frame table), the frames in order
+/// and, at the end, the table of their offsets. Frames are appended one at a
+/// time as they are produced and the header is finished on close(), so a
+/// shot never has to be held in memory. Each frame is a 32-byte block header
+/// followed by its positions, either
+///   - RAW: float x, y, z per vertex,
+///   - KEY: uint16 x, y, z per vertex on a cubic grid around the frame's
+///     bounds (half again as wide as their longest side, so the next frames
+///     fit too), or
+///   - DELTA: int8 x, y, z per vertex, the change in grid steps since the
+///     previous frame, on the grid of the last KEY frame.
+/// NORMALS files follow each frame's positions with its unit normals, two
+/// int16 per vertex: the normal folded onto an octahedron (|x|+|y|+|z| = 1,
+/// the lower half flipped over the upper one) and quantized to snorm16,
+/// which keeps it within about 0.005 degrees.
+/// QUANTIZED files use KEY frames (error at most half a grid step, 1/87000
+/// of the longest side); QUANTIZED | DELTA files use DELTA frames whenever
+/// every vertex moved less than 128 steps, with a new KEY at least every
+/// KEY_INTERVAL frames so seeking never decodes more than that many.
+/// The reader memory-maps the file and decodes frames in parallel.
+
+namespace pointcache {
+    enum Flags {
+        QUANTIZED = 1,
+        DELTA = 2,
+        NORMALS = 4
+    };
+
+    // the most frames between two KEY frames
+    static const uint32_t KEY_INTERVAL = 30;
+}
+
+class PointCacheWriter {
+private:
+    QFile file;
+    uint64_t vertexCount;
+    uint32_t flags;
+    float rate;
+    std::vector<uint64_t> offsets; // where each frame starts
+
+    // the grid of the last KEY frame and the grid coordinates of the last frame
+    float origin[3];
+    float step;
+    uint32_t keyFrame;
+    bool failed;
+    std::vector<uint16_t> quantized;
+
+    std::vector<char> block; // the frame being written
+
+public:
+    PointCacheWriter();
+    ~PointCacheWriter();
+
+    // start a cache of vertexCount vertices per frame, framesPerSecond frames
+    // per second, encoded as the pointcache::Flags say
+    bool open(const QString &path, size_t vertexCount, float framesPerSecond, uint32_t flags);
+
+    // write the next frame (xyzw per vertex; w is ignored); NORMALS caches
+    // need the frame's unit normals too
+    bool append(const glm::vec4* positions, const glm::vec4* normals = nullptr);
+
+    // write the frame table and the header; false if anything failed
+    bool close();
+
+    // frames appended so far
+    size_t getFrameCount() const;
+};
+
+class PointCacheReader {
+private:
+    QFile file;
+    const uchar* base;
+    uint64_t fileSize;
+    uint64_t vertexCount;
+    uint32_t flags;
+    float rate;
+    std::vector<uint64_t> offsets;
+
+    // the grid coordinates of decodedFrame, which DELTA frames build on
+    std::vector<uint16_t> quantized;
+    int decodedFrame;
+
+    // decode one frame into the grid coordinates (KEY or DELTA frames)
+    void decodeQuantized(int frame);
+
+public:
+    PointCacheReader();
+    ~PointCacheReader();
+
+    // map a file written by PointCacheWriter and check its frames
+    bool open(const QString &path);
+
+    // unmap the file
+    void close();
+
+    // the positions of a frame (xyzw per vertex, w = 1) and, if normals isn't
+    // null, its normals (w = 0; false if the cache has none)
+    bool readFrame(int frame, glm::vec4* positions, glm::vec4* normals = nullptr);
+
+    // the frame showing time t (looping over the cache)
+    int frameAt(float t) const;
+
+    // getters
+    bool isOpen() const;
+    bool hasNormals() const;
+    size_t getVertexCount() const;
+    int getFrameCount() const;
+    float getRate() const;
+};
+
+#endif // POINTCACHE_H
@@ -0,0 +1,104 @@
+#include "rigfile.h"
+#include <sectionfile.h>
+#include <cstring>
+
+static const char MAGIC[8] = {'M', 'M', 'R', 'I', 'G', 0, 0, 0};
+
+// is the file at path a rig file (judging by its magic)?
+bool rigfile::isRigFile(const char* data, size_t size) {
+    return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// write the arrays of a skeleton
+bool rigfile::save(const QString &path, const SkeletonArrays &arrays) {
+    size_t n = arrays.jointCount();
+    if (arrays.positions.size() != n || arrays.rotations.size() != n || arrays.nameOffsets.size() != n + 1) {
+        return false;
+    }
+
+    std::vector<float> positions;
+    std::vector<float> rotations;
+    packPositions(arrays.positions, positions);
+    packRotations(arrays.rotations, rotations);
+
+    SectionWriter writer;
+    writer.add(PARENTS, arrays.parents.data(), n * sizeof(int32_t), sizeof(int32_t));
+    writer.add(POSITIONS, positions.data(), positions.size() * sizeof(float), sizeof(float));
+    writer.add(ROTATIONS, rotations.data(), rotations.size() * sizeof(float), sizeof(float));
+    writer.add(NAMES, arrays.names.data(), arrays.names.size(), 1);
+    writer.add(NAME_OFFSETS, arrays.nameOffsets.data(), arrays.nameOffsets.size() * sizeof(uint32_t), sizeof(uint32_t));
+    return writer.write(path, MAGIC, VERSION);
+}
+
+// read a file written by save()
+bool rigfile::load(const QString &path, SkeletonArrays &arrays) {
+    SectionReader reader;
+    if (!reader.open(path, MAGIC, VERSION)) {
+        return false;
+    }
+
+    std::vector<float> positions;
+    std::vector<float> rotations;
+    std::vector<char> names;
+    if (!reader.read(PARENTS, arrays.parents)
+            || !reader.read(POSITIONS, positions)
+            || !reader.read(ROTATIONS, rotations)
+            || !reader.read(NAMES, names)
+            || !reader.read(NAME_OFFSETS, arrays.nameOffsets)) {
+        return false;
+    }
+
+    if (arrays.parents.empty()
+            || !unpackPositions(positions, arrays.positions)
+            || !unpackRotations(rotations, arrays.rotations)) {
+        return false;
+    }
+    arrays.names.assign(names.begin(), names.end());
+    // the same number of everything, parents first, and names in order inside the name bytes
+    return arrays.isValid();
+}
+
+// x, y, z of every position
+void rigfile::packPositions(const std::vector<glm::vec4> &positions, std::vector<float> &out) {
+    out.resize(3 * positions.size());
+    for (size_t j = 0; j < positions.size(); ++j) {
+        out[3 * j] = positions[j].x;
+        out[3 * j + 1] = positions[j].y;
+        out[3 * j + 2] = positions[j].z;
+    }
+}
+
+// positions from their x, y, z
+bool rigfile::unpackPositions(const std::vector<float> &packed, std::vector<glm::vec4> &positions) {
+    if (packed.size() % 3 != 0) {
+        return false;
+    }
+    positions.resize(packed.size() / 3);
+    for (size_t j = 0; j < positions.size(); ++j) {
+        positions[j] = glm::vec4(packed[3 * j], packed[3 * j + 1], packed[3 * j + 2], 1);
+    }
+    return true;
+}
+
+// w, x, y, z of every rotation
+void rigfile::packRotations(const std::vector<glm::quat> &rotations, std::vector<float> &out) {
+    out.resize(4 * rotations.size());
+    for (size_t j = 0; j < rotations.size(); ++j) {
+        out[4 * j] = rotations[j].w;
+        out[4 * j + 1] = rotations[j].x;
+        out[4 * j + 2] = rotations[j].y;
+        out[4 * j + 3] = rotations[j].z;
+    }
+}
+
+// rotations from their w, x, y, z
+bool rigfile::unpackRotations(const std::vector<float> &packed, std::vector<glm::quat> &rotations) {
+    if (packed.size() % 4 != 0) {
+        return false;
+    }
+    rotations.resize(packed.size() / 4);
+    for (size_t j = 0; j < rotations.size(); ++j) {
+        rotations[j] = glm::quat(packed[4 * j], packed[4 * j + 1], packed[4 * j + 2], packed[4 * j + 3]);
+    }
+    return true;
+}
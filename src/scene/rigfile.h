@@ -0,0 +1,45 @@
+#ifndef RIGFILE_H
+#define RIGFILE_H
+
+#include "skeletonarrays.h"
+#include <QString>
+
+/// Native binary rig format (.rig).
+///
+/// A section file holding the skeleton arrays as they are: parent indices,
+/// x, y, z of every position, w, x, y, z of every rotation and the names
+/// with their offsets. Loading is a memory map, a checksum and a few
+/// memcpys; the parent indices are checked so that every parent comes before
+/// its children.
+
+namespace rigfile {
+    static const uint32_t VERSION = 1;
+
+    enum Section : uint32_t {
+        PARENTS = 1,        // int32 per joint, -1 for the root
+        POSITIONS,          // 3 floats per joint
+        ROTATIONS,          // 4 floats (w, x, y, z) per joint
+        NAMES,              // UTF-8 bytes of all names
+        NAME_OFFSETS        // uint32 per joint, plus the total length
+    };
+
+    // do these bytes start like a rig file?
+    bool isRigFile(const char* data, size_t size);
+
+    // write the arrays of a skeleton
+    bool save(const QString &path, const SkeletonArrays &arrays);
+
+    // read a file written by save()
+    bool load(const QString &path, SkeletonArrays &arrays);
+
+    // x, y, z of every position, and back (with w = 1); components are
+    // stored by name, whatever layout glm gives its types
+    void packPositions(const std::vector<glm::vec4> &positions, std::vector<float> &out);
+    bool unpackPositions(const std::vector<float> &packed, std::vector<glm::vec4> &positions);
+
+    // w, x, y, z of every rotation, and back
+    void packRotations(const std::vector<glm::quat> &rotations, std::vector<float> &out);
+    bool unpackRotations(const std::vector<float> &packed, std::vector<glm::quat> &rotations);
+}
+
+#endif // RIGFILE_H
@@ -0,0 +1,221 @@
+#include "sessionfile.h"
+#include "meshcache.h"
+#include "rigfile.h"
+#include <sectionfile.h>
+#include <parallel.h>
+#include <QByteArray>
+#include <atomic>
+#include <cstring>
+
+static const char MAGIC[8] = {'M', 'M', 'S', 'E', 'S', 'S', 0, 0};
+
+// uncompressed bytes per block
+static const size_t BLOCK = 1 << 20;
+
+// zlib's fastest level: sessions are saved often
+static const int LEVEL = 1;
+
+// the start of a stored section, followed by the stored size (uint32) of
+// every block and then the blocks themselves
+struct PackedHeader {
+    uint64_t rawBytes;
+    uint32_t elementSize;
+    uint32_t blockCount;
+};
+
+// a section before compression
+struct RawSection {
+    uint32_t id;
+    uint32_t elementSize;
+    const char* data;
+    size_t bytes;
+};
+
+// a block to compress or decompress
+struct Block {
+    const char* src;
+    size_t srcBytes;
+    char* dest;
+    size_t destBytes;
+};
+
+template<typename T>
+static RawSection raw(uint32_t id, const std::vector<T> &v) {
+    return {id, (uint32_t) sizeof(T), (const char*) v.data(), v.size() * sizeof(T)};
+}
+
+// the blocks of a stored section, to be decompressed into out (resized to fit)
+template<typename T>
+static bool plan(const SectionReader &reader, uint32_t id, std::vector<T> &out, std::vector<Block> &blocks) {
+    size_t bytes = 0;
+    const char* data = (const char*) reader.section(id, 1, bytes);
+    if (data == nullptr || bytes < sizeof(PackedHeader)) {
+        return false;
+    }
+    PackedHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t offset = sizeof(PackedHeader) + (size_t) header.blockCount * sizeof(uint32_t);
+    if (header.elementSize != sizeof(T) || header.rawBytes % sizeof(T) != 0
+            || header.blockCount != (header.rawBytes + BLOCK - 1) / BLOCK || offset > bytes) {
+        return false;
+    }
+
+    out.resize((size_t) (header.rawBytes / sizeof(T)));
+    char* dest = (char*) out.data();
+    for (uint32_t b = 0; b < header.blockCount; ++b) {
+        uint32_t stored;
+        std::memcpy(&stored, data + sizeof(PackedHeader) + b * sizeof(uint32_t), sizeof(stored));
+        if (stored > bytes - offset) {
+            return false;
+        }
+        size_t begin = b * BLOCK;
+        blocks.push_back({data + offset, stored, dest + begin, std::min<size_t>(BLOCK, header.rawBytes - begin)});
+        offset += stored;
+    }
+    return offset == bytes;
+}
+
+// an index if it is one into count elements, -1 otherwise
+static int32_t inRange(int32_t i, size_t count) {
+    return i >= 0 && (size_t) i < count ? i : -1;
+}
+
+// write a session
+bool sessionfile::save(const QString &path, const Session &session) {
+    const MeshArrays &mesh = session.mesh;
+    const SkeletonArrays &skeleton = session.skeleton;
+    uint64_t report[2] = {session.links.report.boundaryEdges, session.links.report.nonManifoldEdges};
+    std::vector<char> names(skeleton.names.begin(), skeleton.names.end());
+    std::vector<float> jointPositions;
+    std::vector<float> jointRotations;
+    rigfile::packPositions(skeleton.positions, jointPositions);
+    rigfile::packRotations(skeleton.rotations, jointRotations);
+
+    std::vector<RawSection> raws = {
+        raw(POSITIONS, mesh.positions),
+        raw(FACE_OFFSETS, mesh.faceOffsets),
+        raw(CORNERS, mesh.corners),
+        raw(NEXT, session.links.next),
+        raw(SYM, session.links.sym),
+        raw(FACE_COLORS, mesh.faceColors),
+        raw(SKIN_WEIGHTS, mesh.skinWeights),
+        {REPORT, (uint32_t) sizeof(uint64_t), (const char*) report, sizeof(report)},
+        raw(JOINT_PARENTS, skeleton.parents),
+        raw(JOINT_POSITIONS, jointPositions),
+        raw(JOINT_ROTATIONS, jointRotations),
+        raw(JOINT_NAMES, names),
+        raw(JOINT_NAME_OFFSETS, skeleton.nameOffsets),
+        raw(BIND_MATRICES, session.bindMatrices),
+        {STATE, (uint32_t) sizeof(State), (const char*) &session.state, sizeof(State)}
+    };
+
+    // every block of every section is compressed at once
+    std::vector<Block> blocks;
+    for (const RawSection &s : raws) {
+        for (size_t begin = 0; begin < s.bytes; begin += BLOCK) {
+            blocks.push_back({s.data + begin, std::min(BLOCK, s.bytes - begin), nullptr, 0});
+        }
+    }
+    std::vector<QByteArray> packed(blocks.size());
+    parallel::forRange(blocks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            packed[b] = qCompress((const uchar*) blocks[b].src, (int) blocks[b].srcBytes, LEVEL);
+        }
+    });
+
+    // then each section is its header, its block sizes and its blocks
+    std::vector<std::vector<char>> stored(raws.size());
+    SectionWriter writer;
+    size_t b = 0;
+    for (size_t i = 0; i < raws.size(); ++i) {
+        PackedHeader header;
+        header.rawBytes = raws[i].bytes;
+        header.elementSize = raws[i].elementSize;
+        header.blockCount = (uint32_t) ((raws[i].bytes + BLOCK - 1) / BLOCK);
+
+        std::vector<char> &out = stored[i];
+        out.resize(sizeof(header) + header.blockCount * sizeof(uint32_t));
+        std::memcpy(out.data(), &header, sizeof(header));
+        for (uint32_t k = 0; k < header.blockCount; ++k) {
+            const QByteArray &block = packed[b + k];
+            uint32_t size = (uint32_t) block.size();
+            std::memcpy(out.data() + sizeof(header) + k * sizeof(uint32_t), &size, sizeof(size));
+            out.insert(out.end(), block.constData(), block.constData() + block.size());
+        }
+        b += header.blockCount;
+        writer.add(raws[i].id, out.data(), out.size(), 1);
+    }
+    return writer.write(path, MAGIC, VERSION);
+}
+
+// read a file written by save()
+bool sessionfile::load(const QString &path, Session &session) {
+    SectionReader reader;
+    if (!reader.open(path, MAGIC, VERSION)) {
+        return false;
+    }
+
+    MeshArrays &mesh = session.mesh;
+    SkeletonArrays &skeleton = session.skeleton;
+    std::vector<uint64_t> report;
+    std::vector<char> names;
+    std::vector<float> jointPositions;
+    std::vector<float> jointRotations;
+    std::vector<State> state;
+    std::vector<Block> blocks;
+    if (!plan(reader, POSITIONS, mesh.positions, blocks)
+            || !plan(reader, FACE_OFFSETS, mesh.faceOffsets, blocks)
+            || !plan(reader, CORNERS, mesh.corners, blocks)
+            || !plan(reader, NEXT, session.links.next, blocks)
+            || !plan(reader, SYM, session.links.sym, blocks)
+            || !plan(reader, FACE_COLORS, mesh.faceColors, blocks)
+            || !plan(reader, SKIN_WEIGHTS, mesh.skinWeights, blocks)
+            || !plan(reader, REPORT, report, blocks)
+            || !plan(reader, JOINT_PARENTS, skeleton.parents, blocks)
+            || !plan(reader, JOINT_POSITIONS, jointPositions, blocks)
+            || !plan(reader, JOINT_ROTATIONS, jointRotations, blocks)
+            || !plan(reader, JOINT_NAMES, names, blocks)
+            || !plan(reader, JOINT_NAME_OFFSETS, skeleton.nameOffsets, blocks)
+            || !plan(reader, BIND_MATRICES, session.bindMatrices, blocks)
+            || !plan(reader, STATE, state, blocks)) {
+        return false;
+    }
+
+    // every block of every section is decompressed at once, straight into place
+    std::atomic<bool> ok(true);
+    parallel::forRange(blocks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end && ok; ++b) {
+            QByteArray block = qUncompress((const uchar*) blocks[b].src, (int) blocks[b].srcBytes);
+            if ((size_t) block.size() != blocks[b].destBytes) {
+                ok = false;
+            } else {
+                std::memcpy(blocks[b].dest, block.constData(), blocks[b].destBytes);
+            }
+        }
+    });
+    if (!ok || report.size() != 2 || state.size() != 1
+            || !rigfile::unpackPositions(jointPositions, skeleton.positions)
+            || !rigfile::unpackRotations(jointRotations, skeleton.rotations)) {
+        return false;
+    }
+    session.links.report.boundaryEdges = report[0];
+    session.links.report.nonManifoldEdges = report[1];
+    skeleton.names.assign(names.begin(), names.end());
+    session.state = state[0];
+
+    // an empty skeleton has no root
+    if (!meshcache::validate(mesh, session.links)
+            || (skeleton.jointCount() > 0 && !skeleton.isValid())
+            || (skeleton.jointCount() == 0 && skeleton.nameOffsets.size() != 1)
+            || session.bindMatrices.size() != skeleton.jointCount()) {
+        return false;
+    }
+
+    // a selection that doesn't exist is dropped
+    State &st = session.state;
+    st.vertex = inRange(st.vertex, mesh.positions.size());
+    st.halfEdge = inRange(st.halfEdge, mesh.corners.size());
+    st.face = inRange(st.face, mesh.faceCount());
+    st.joint = inRange(st.joint, skeleton.jointCount());
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef SESSIONFILE_H
+#define SESSIONFILE_H
+
+#include "mesharrays.h"
+#include "connectivity.h"
+#include "skeletonarrays.h"
+#include <QString>
+
+/// Session files (.session): everything needed to pick up where one left off.
+///
+/// A section file holding the mesh arrays with their next/sym links and skin
+/// weights, the skeleton in its current pose (its positions and rotations
+/// stored component by component, like in rig files), the joints' bind
+/// matrices, and which elements and joint were selected. Every section is cut into 1 MB
+/// blocks that are compressed on their own (zlib, through qCompress), so
+/// saving and loading compress and decompress all blocks of all sections in
+/// parallel. Nothing is re-parsed, re-linked or re-bound when a session opens.
+
+namespace sessionfile {
+    static const uint32_t VERSION = 2;
+
+    enum Section : uint32_t {
+        POSITIONS = 1,      // glm::vec4 per vertex
+        FACE_OFFSETS,       // uint32 per face, plus the corner count
+        CORNERS,            // uint32 vertex index per corner
+        NEXT,               // uint32 per half-edge
+        SYM,                // uint32 per half-edge, connectivity::NONE on boundaries
+        FACE_COLORS,        // glm::vec4 per face
+        SKIN_WEIGHTS,       // SkinWeights per vertex
+        REPORT,             // boundary and non-manifold edge counts (2 x uint64)
+        JOINT_PARENTS,      // int32 per joint, -1 for the root
+        JOINT_POSITIONS,    // 3 floats per joint, relative to its parent
+        JOINT_ROTATIONS,    // 4 floats (w, x, y, z) per joint, relative to its parent
+        JOINT_NAMES,        // UTF-8 bytes of all joint names
+        JOINT_NAME_OFFSETS, // uint32 per joint, plus the total length
+        BIND_MATRICES,      // glm::mat4 per joint
+        STATE               // one State
+    };
+
+    // selections (indices, -1 for none) and modes
+    struct State {
+        int32_t vertex;
+        int32_t halfEdge;   // corner index
+        int32_t face;
+        int32_t joint;
+        uint32_t skinned;   // is the mesh bound to the skeleton?
+        uint32_t reserved;
+
+        State() : vertex(-1), halfEdge(-1), face(-1), joint(-1), skinned(0), reserved(0) {}
+    };
+
+    struct Session {
+        MeshArrays mesh;
+        connectivity::Links links;
+        SkeletonArrays skeleton;
+        std::vector<glm::mat4> bindMatrices;
+        State state;
+    };
+
+    // write a session
+    bool save(const QString &path, const Session &session);
+
+    // read a file written by save(); every index is checked to be in range
+    bool load(const QString &path, Session &session);
+}
+
+#endif // SESSIONFILE_H
@@ -0,0 +1,59 @@
+#ifndef SKELETONARRAYS_H
+#define SKELETONARRAYS_H
+
+#include <la.h>
+#include <glm/gtc/quaternion.hpp>
+#include <QString>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// SKELETON ARRAYS:
+/// flat, index-based copy of a skeleton's rest pose, in the order the joints
+/// are created (every parent before its children). This is what the skeleton
+/// readers fill and the rig writer saves, without any Joint objects.
+
+struct SkeletonArrays {
+    // index of each joint's parent, -1 for the root
+    std::vector<int32_t> parents;
+
+    // position of each joint relative to its parent
+    std::vector<glm::vec4> positions;
+
+    // orientation of each joint relative to its parent
+    std::vector<glm::quat> rotations;
+
+    // the UTF-8 names of all joints back to back, and where each one starts
+    // (plus one trailing entry holding the total length)
+    std::string names;
+    std::vector<uint32_t> nameOffsets;
+
+    // number of joints
+    size_t jointCount() const {
+        return parents.size();
+    }
+
+    // does every joint have a position, rotation and name, one root that comes
+    // first, and every parent before its children?
+    bool isValid() const {
+        size_t n = parents.size();
+        if (positions.size() != n || rotations.size() != n || nameOffsets.size() != n + 1
+                || nameOffsets[0] != 0 || nameOffsets[n] != names.size()) {
+            return false;
+        }
+        for (size_t j = 0; j < n; ++j) {
+            if (parents[j] < -1 || parents[j] >= (int32_t) j || (parents[j] == -1) != (j == 0)
+                    || nameOffsets[j] > nameOffsets[j + 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // name of joint j
+    QString name(size_t j) const {
+        return QString::fromUtf8(names.data() + nameOffsets[j], (int) (nameOffsets[j + 1] - nameOffsets[j]));
+    }
+};
+
+#endif // SKELETONARRAYS_H
@@ -0,0 +1,165 @@
+#include "skeletongizmo.h"
+#include <unordered_map>
+#include <glm/gtx/rotate_vector.hpp>
+
+// constructor
+SkeletonGizmo::SkeletonGizmo(GLWidget277 *context) : Drawable(context),
+    instanceBuf(context),
+    poseDirty(true)
+{}
+
+// set the skeleton to draw
+void SkeletonGizmo::setSkeleton(const std::vector<Joint*> &jts) {
+    joints = jts;
+    visible.clear();
+    updatePose();
+}
+
+// recompute every joint's instance data
+void SkeletonGizmo::updatePose() {
+    Joint::updateTransforms(joints);
+
+    std::unordered_map<const Joint*, int> jointIdx;
+    instances.resize(joints.size() * TEXELS_PER_JOINT);
+
+    for (size_t i = 0; i < joints.size(); ++i) {
+        Joint* jt = joints[i];
+        jointIdx[jt] = (int) i;
+
+        glm::mat4 world = jt->getOverallTransformation();
+        glm::vec4* inst = &instances[i * TEXELS_PER_JOINT];
+        inst[0] = world[0];
+        inst[1] = world[1];
+        inst[2] = world[2];
+        inst[3] = world[3];
+
+        // the root's bone collapses onto the joint itself
+        inst[4] = world[3];
+        auto parent = jointIdx.find(jt->getParent());
+        if (parent != jointIdx.end()) {
+            inst[4] = instances[parent->second * TEXELS_PER_JOINT + 3];
+        }
+
+        // a tint with zero alpha keeps the per-axis circle colors
+        inst[5] = jt->isSelected() ? glm::vec4(1, 1, 1, 1) : glm::vec4(0);
+    }
+    poseDirty = true;
+}
+
+// keep only the joints whose gizmo overlaps the frustum
+void SkeletonGizmo::cull(const Frustum &frustum) {
+    std::vector<int> nowVisible;
+    nowVisible.reserve(joints.size());
+
+    for (size_t i = 0; i < joints.size(); ++i) {
+        const glm::vec4* inst = &instances[i * TEXELS_PER_JOINT];
+
+        // the circles have radius 0.5 and are only rotated, never scaled
+        glm::vec3 center = glm::vec3(inst[3]);
+        glm::vec3 boundsMin = glm::min(center - glm::vec3(0.5f), glm::vec3(inst[4]));
+        glm::vec3 boundsMax = glm::max(center + glm::vec3(0.5f), glm::vec3(inst[4]));
+        if (frustum.intersects(boundsMin, boundsMax)) {
+            nowVisible.push_back((int) i);
+        }
+    }
+
+    if (!poseDirty && nowVisible == visible) {
+        return;
+    }
+    visible.swap(nowVisible);
+    poseDirty = false;
+
+    packed.resize(visible.size() * TEXELS_PER_JOINT);
+    for (size_t v = 0; v < visible.size(); ++v) {
+        std::copy(&instances[visible[v] * TEXELS_PER_JOINT],
+                  &instances[visible[v] * TEXELS_PER_JOINT] + TEXELS_PER_JOINT,
+                  &packed[v * TEXELS_PER_JOINT]);
+    }
+    instanceBuf.upload(packed.data(), packed.size() * sizeof(glm::vec4));
+}
+
+// change draw mode
+GLenum SkeletonGizmo::drawMode() {
+    return GL_LINES;
+}
+
+// one instance per visible joint
+int SkeletonGizmo::instanceCount() {
+    return (int) visible.size();
+}
+
+// instance data is read from a buffer texture
+bool SkeletonGizmo::bindInstances(int unit) {
+    if (!instanceBuf.isCreated()) {
+        return false;
+    }
+    instanceBuf.bind(unit);
+    return true;
+}
+
+// create the shared circle and bone geometry
+void SkeletonGizmo::create() {
+    std::vector<GLuint> idx;
+    std::vector<glm::vec4> pos;
+    std::vector<glm::vec4> col;
+
+    // three 20 segment circles of radius 0.5 around the X, Y and Z axes
+    const glm::vec4 starts[3] = { glm::vec4(0, 0.5, 0, 1),
+                                  glm::vec4(0, 0, 0.5, 1),
+                                  glm::vec4(0.5, 0, 0, 1) };
+    const glm::vec4 colors[3] = { glm::vec4(1, 0, 0, 1),
+                                  glm::vec4(0, 1, 0, 1),
+                                  glm::vec4(0, 0, 1, 1) };
+    for (int axis = 0; axis < 3; ++axis) {
+        GLuint first = pos.size();
+        for (int i = 0; i < 20; ++i) {
+            idx.push_back(first + i);
+            idx.push_back(first + (i + 1) % 20);
+
+            float angle = glm::radians(i * 18.0f);
+            glm::vec4 p;
+            if (axis == 0) {
+                p = glm::rotateX(starts[axis], angle);
+            } else if (axis == 1) {
+                p = glm::rotateY(starts[axis], angle);
+            } else {
+                p = glm::rotateZ(starts[axis], angle);
+            }
+            pos.push_back(p);
+            col.push_back(colors[axis]);
+        }
+    }
+
+    // line to the parent: w = 0 marks the end that sits on the parent joint
+    idx.push_back(pos.size());
+    idx.push_back(pos.size() + 1);
+    pos.push_back(glm::vec4(0, 0, 0, 1));
+    pos.push_back(glm::vec4(0, 0, 0, 0));
+    col.push_back(glm::vec4(1, 1, 0, 1));
+    col.push_back(glm::vec4(1, 0, 1, 1));
+
+    count = idx.size();
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                             idx.size() * sizeof(GLuint),
+                             idx.data(), GL_STATIC_DRAW);
+
+    generatePos();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER,
+                             pos.size() * sizeof(glm::vec4),
+                             pos.data(), GL_STATIC_DRAW);
+
+    generateCol();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+    mp_context->glBufferData(GL_ARRAY_BUFFER,
+                             col.size() * sizeof(glm::vec4),
+                             col.data(), GL_STATIC_DRAW);
+}
+
+void SkeletonGizmo::destroy() {
+    Drawable::destroy();
+    instanceBuf.destroy();
+}
@@ -0,0 +1,68 @@
+#ifndef SKELETONGIZMO_H
+#define SKELETONGIZMO_H
+
+#include "drawable.h"
+#include "joint.h"
+#include "frustum.h"
+#include "texturebuffer.h"
+#include <la.h>
+
+/// SKELETON GIZMO CLASS:
+/// draws every joint of a skeleton (three circles around the joint plus a line
+/// to its parent) with one instanced draw call. The circle and line geometry is
+/// stored once, in the joint's local space; each instance reads its joint's
+/// world matrix, parent position and tint from a buffer texture by gl_InstanceID.
+
+class SkeletonGizmo : public Drawable {
+public:
+    // vec4 texels per instance: 4 matrix columns, parent position, tint
+    static const int TEXELS_PER_JOINT = 6;
+
+private:
+    // the joints drawn, in skeleton order
+    std::vector<Joint*> joints;
+
+    // per-joint instance data for the whole skeleton (TEXELS_PER_JOINT each)
+    std::vector<glm::vec4> instances;
+
+    // the joints that passed the last cull, in skeleton order
+    std::vector<int> visible;
+
+    // instance data of the visible joints, as uploaded
+    std::vector<glm::vec4> packed;
+
+    TextureBuffer instanceBuf;
+
+    // has the pose changed since the last upload?
+    bool poseDirty;
+
+public:
+    // constructor
+    SkeletonGizmo(GLWidget277* mp_context);
+
+    // set the skeleton to draw (joints come after their parents)
+    void setSkeleton(const std::vector<Joint*> &jts);
+
+    // recompute every joint's instance data after the pose or selection changed
+    void updatePose();
+
+    // keep only the joints whose gizmo overlaps the frustum; uploads the
+    // instance data if the pose or the set of visible joints changed
+    void cull(const Frustum &frustum);
+
+    // change draw mode
+    virtual GLenum drawMode() override;
+
+    // one instance per visible joint
+    virtual int instanceCount() override;
+
+    // instance data is read from a buffer texture
+    virtual bool bindInstances(int unit) override;
+
+    // create the shared circle and bone geometry
+    virtual void create() override;
+
+    virtual void destroy() override;
+};
+
+#endif // SKELETONGIZMO_H
@@ -0,0 +1,403 @@
+#include "skeletonreader.h"
+#include "objreader.h"
+#include "rigfile.h"
+#include <QFile>
+#include <cstring>
+
+// what a JSON value is to the skeleton
+enum Role {
+    DOCUMENT,       // the whole file
+    JOINT,          // a joint object (the root or one of some children)
+    NAME,           // a joint's "name"
+    POS,            // a joint's "pos" array
+    ROT,            // a joint's "rot" array
+    CHILDREN,       // a joint's "children" array
+    POS_VALUE,      // a number in "pos"
+    ROT_VALUE,      // a number in "rot"
+    SKIP            // anything else
+};
+
+// an object or array that is open
+struct Frame {
+    Role role;
+    bool object;
+    int32_t joint;  // the joint of a JOINT object or of a CHILDREN array
+    int count;      // values read so far, in arrays
+    float pos[3];   // the numbers of "pos" and "rot", in JOINT objects
+    float rot[4];
+};
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline void skipSpace(const char* &p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        ++p;
+    }
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// four hex digits of a \u escape at p
+static bool parseHex4(const char* &p, const char* end, uint32_t &code) {
+    if (end - p < 4) {
+        return false;
+    }
+    code = 0;
+    for (int i = 0; i < 4; ++i) {
+        int d = hexDigit(p[i]);
+        if (d < 0) {
+            return false;
+        }
+        code = code * 16 + (uint32_t) d;
+    }
+    p += 4;
+    return true;
+}
+
+static void appendUtf8(uint32_t code, std::string &out) {
+    if (code < 0x80) {
+        out += (char) code;
+    } else if (code < 0x800) {
+        out += (char) (0xC0 | (code >> 6));
+        out += (char) (0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += (char) (0xE0 | (code >> 12));
+        out += (char) (0x80 | ((code >> 6) & 0x3F));
+        out += (char) (0x80 | (code & 0x3F));
+    } else {
+        out += (char) (0xF0 | (code >> 18));
+        out += (char) (0x80 | ((code >> 12) & 0x3F));
+        out += (char) (0x80 | ((code >> 6) & 0x3F));
+        out += (char) (0x80 | (code & 0x3F));
+    }
+}
+
+// the string starting at the quote at p, appended to out with its escapes
+// decoded (or only skipped if out is null)
+static bool parseString(const char* &p, const char* end, std::string* out) {
+    ++p;
+    while (true) {
+        // copy the run up to the next quote or escape in one go
+        const char* run = p;
+        while (p < end && *p != '"' && *p != '\\') {
+            ++p;
+        }
+        if (out != nullptr) {
+            out->append(run, p - run);
+        }
+        if (p >= end) {
+            return false;
+        }
+        if (*p++ == '"') {
+            return true;
+        }
+
+        if (p >= end) {
+            return false;
+        }
+        char e = *p++;
+        char decoded = 0;
+        switch (e) {
+        case '"': decoded = '"'; break;
+        case '\\': decoded = '\\'; break;
+        case '/': decoded = '/'; break;
+        case 'b': decoded = '\b'; break;
+        case 'f': decoded = '\f'; break;
+        case 'n': decoded = '\n'; break;
+        case 'r': decoded = '\r'; break;
+        case 't': decoded = '\t'; break;
+        case 'u': {
+            uint32_t code;
+            if (!parseHex4(p, end, code)) {
+                return false;
+            }
+            // a surrogate pair is one code point
+            uint32_t low;
+            if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                const char* q = p + 2;
+                if (parseHex4(q, end, low) && low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p = q;
+                }
+            }
+            if (out != nullptr) {
+                appendUtf8(code, *out);
+            }
+            continue;
+        }
+        default:
+            return false;
+        }
+        if (out != nullptr) {
+            *out += decoded;
+        }
+    }
+}
+
+// the key at p and its colon; the role of the value that follows is returned in role
+static bool parseKey(const char* &p, const char* end, const Frame &frame, bool haveRoot,
+                     std::string &key, Role &role) {
+    skipSpace(p, end);
+    if (p >= end || *p != '"') {
+        return false;
+    }
+    key.clear();
+    if (!parseString(p, end, &key)) {
+        return false;
+    }
+    skipSpace(p, end);
+    if (p >= end || *p != ':') {
+        return false;
+    }
+    ++p;
+
+    role = SKIP;
+    if (frame.role == DOCUMENT) {
+        // like a JSON object, only one root
+        if (key == "root" && !haveRoot) {
+            role = JOINT;
+        }
+    } else if (frame.role == JOINT) {
+        if (key == "name") {
+            role = NAME;
+        } else if (key == "pos") {
+            role = POS;
+        } else if (key == "rot") {
+            role = ROT;
+        } else if (key == "children") {
+            role = CHILDREN;
+        }
+    }
+    return true;
+}
+
+// the role of the elements of an array
+static Role elementRole(const Frame &frame) {
+    switch (frame.role) {
+    case CHILDREN: return JOINT;
+    case POS: return POS_VALUE;
+    case ROT: return ROT_VALUE;
+    default: return SKIP;
+    }
+}
+
+// the orientation of an angle and axis as the skeleton files have them
+static glm::quat jointRotation(const float rot[4], bool root) {
+    glm::vec3 axis(rot[1], rot[2], rot[3]);
+    if (root) {
+        // the root's angle has always been in radians, around the axis as it is
+        return glm::angleAxis(rot[0], axis);
+    }
+    if (glm::length(axis) == 0.f) {
+        return glm::quat();
+    }
+    return glm::angleAxis(glm::radians(rot[0]), glm::normalize(axis));
+}
+
+bool skeletonreader::parseJson(const char* data, size_t size, SkeletonArrays &arrays) {
+    arrays.parents.clear();
+    arrays.positions.clear();
+    arrays.rotations.clear();
+    arrays.names.clear();
+    arrays.nameOffsets.assign(1, 0);
+
+    const char* p = data;
+    const char* end = data + size;
+    // a UTF-8 byte order mark
+    if (size >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+
+    // names arrive in any order relative to the children, so each joint's name
+    // is first kept as a range of this and put in joint order at the end
+    std::string nameText;
+    std::vector<uint32_t> nameBegin;
+    std::vector<uint32_t> nameEnd;
+
+    std::vector<Frame> stack;
+    std::string key;
+    Role role = DOCUMENT;
+    while (true) {
+        // a value
+        skipSpace(p, end);
+        if (p >= end) {
+            return false;
+        }
+        char c = *p;
+        if (role == DOCUMENT && c != '{') {
+            return false;
+        }
+        bool closed = false;
+
+        if (c == '{' || c == '[') {
+            ++p;
+            Frame frame;
+            frame.object = c == '{';
+            frame.role = SKIP;
+            if (frame.object ? (role == DOCUMENT || role == JOINT)
+                             : (role == POS || role == ROT || role == CHILDREN)) {
+                frame.role = role;
+            }
+            frame.joint = -1;
+            frame.count = 0;
+
+            if (frame.role == JOINT) {
+                // a joint gets its index when its object starts, so every
+                // parent comes before its children
+                frame.joint = (int32_t) arrays.parents.size();
+                const Frame &outer = stack.back();
+                arrays.parents.push_back(outer.role == CHILDREN ? outer.joint : -1);
+                nameBegin.push_back(0);
+                nameEnd.push_back(0);
+                std::memset(frame.pos, 0, sizeof(frame.pos));
+                std::memset(frame.rot, 0, sizeof(frame.rot));
+            } else if (frame.role == CHILDREN) {
+                frame.joint = stack.back().joint;
+            }
+            stack.push_back(frame);
+
+            skipSpace(p, end);
+            if (p < end && *p == (frame.object ? '}' : ']')) {
+                // empty; closed below
+                closed = true;
+            } else if (frame.object) {
+                if (!parseKey(p, end, stack.back(), !arrays.parents.empty(), key, role)) {
+                    return false;
+                }
+                continue;
+            } else {
+                role = elementRole(stack.back());
+                continue;
+            }
+        } else if (c == '"') {
+            if (role == NAME) {
+                int32_t j = stack.back().joint;
+                nameBegin[j] = (uint32_t) nameText.size();
+                if (!parseString(p, end, &nameText)) {
+                    return false;
+                }
+                nameEnd[j] = (uint32_t) nameText.size();
+            } else if (!parseString(p, end, nullptr)) {
+                return false;
+            }
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            float v;
+            if (!objreader::parseFloat(p, end, v)) {
+                return false;
+            }
+            if (role == POS_VALUE || role == ROT_VALUE) {
+                // the array is on top, its joint right below it
+                int i = stack.back().count;
+                Frame &joint = stack[stack.size() - 2];
+                if (role == POS_VALUE && i < 3) {
+                    joint.pos[i] = v;
+                } else if (role == ROT_VALUE && i < 4) {
+                    joint.rot[i] = v;
+                }
+            }
+        } else if (end - p >= 4 && (std::memcmp(p, "true", 4) == 0 || std::memcmp(p, "null", 4) == 0)) {
+            p += 4;
+        } else if (end - p >= 5 && std::memcmp(p, "false", 5) == 0) {
+            p += 5;
+        } else {
+            return false;
+        }
+
+        // after a value (or right at an empty container): a comma, or the end
+        // of the innermost open object or array, which is a value itself
+        while (true) {
+            if (closed) {
+                ++p;
+                const Frame &frame = stack.back();
+                if (frame.role == JOINT) {
+                    int32_t j = frame.joint;
+                    arrays.positions.resize(arrays.parents.size());
+                    arrays.rotations.resize(arrays.parents.size());
+                    arrays.positions[j] = glm::vec4(frame.pos[0], frame.pos[1], frame.pos[2], 1);
+                    arrays.rotations[j] = jointRotation(frame.rot, arrays.parents[j] < 0);
+                }
+                stack.pop_back();
+                closed = false;
+            }
+            if (stack.empty()) {
+                break;
+            }
+            Frame &frame = stack.back();
+            if (!frame.object) {
+                frame.count++;
+            }
+
+            skipSpace(p, end);
+            if (p >= end) {
+                return false;
+            }
+            if (*p == ',') {
+                ++p;
+                if (frame.object) {
+                    if (!parseKey(p, end, frame, !arrays.parents.empty(), key, role)) {
+                        return false;
+                    }
+                } else {
+                    role = elementRole(frame);
+                }
+                break;
+            }
+            if (*p != (frame.object ? '}' : ']')) {
+                return false;
+            }
+            closed = true;
+        }
+        if (stack.empty()) {
+            break;
+        }
+    }
+
+    skipSpace(p, end);
+    if (p != end || arrays.parents.empty()) {
+        return false;
+    }
+
+    // the names in joint order
+    size_t n = arrays.parents.size();
+    arrays.names.reserve(nameText.size());
+    arrays.nameOffsets.resize(n + 1);
+    for (size_t j = 0; j < n; ++j) {
+        arrays.names.append(nameText, nameBegin[j], nameEnd[j] - nameBegin[j]);
+        arrays.nameOffsets[j + 1] = (uint32_t) arrays.names.size();
+    }
+    return true;
+}
+
+// map and read a skeleton JSON or binary rig file
+bool skeletonreader::read(const QString &path, SkeletonArrays &arrays) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    if (size <= 0) {
+        return false;
+    }
+    const uchar* mapped = file.map(0, size);
+    if (mapped == nullptr) {
+        return false;
+    }
+    bool rig = rigfile::isRigFile((const char*) mapped, (size_t) size);
+    bool ok = rig || parseJson((const char*) mapped, (size_t) size, arrays);
+    file.unmap((uchar*) mapped);
+    file.close();
+    return rig ? rigfile::load(path, arrays) : ok;
+}
@@ -0,0 +1,27 @@
+#ifndef SKELETONREADER_H
+#define SKELETONREADER_H
+
+#include "skeletonarrays.h"
+#include <QString>
+#include <cstddef>
+
+/// Streaming skeleton reader.
+///
+/// Skeleton JSON ({"root": {"name", "pos", "rot", "children": [...]}}) is
+/// read in a single pass over the memory-mapped text: there is no document
+/// tree and no recursion, just a stack of the objects and arrays that are
+/// open, and every joint goes straight into the flat arrays when its object
+/// starts (so joints come out in the order the old loader made them). "pos"
+/// is x, y, z; "rot" is an angle and an axis, the root's angle in radians and
+/// everyone else's in degrees, as the skeleton files have always had it.
+/// Unknown keys are skipped. Binary .rig files (see rigfile.h) are read too.
+
+namespace skeletonreader {
+    // parse skeleton JSON; false if it isn't well-formed or has no root joint
+    bool parseJson(const char* data, size_t size, SkeletonArrays &arrays);
+
+    // map and read a skeleton JSON or binary rig file
+    bool read(const QString &path, SkeletonArrays &arrays);
+}
+
+#endif // SKELETONREADER_H
@@ -0,0 +1,335 @@
+#include "skinbinding.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t LEAF_SIZE = 4;
+
+// below this depth nodes are split in half, so the tree stays shallower than
+// the query stack is deep
+static const int SAH_DEPTH = 32;
+
+// squared distance from p to the segment ab
+static float segmentDist2(const float p[3], const skinbinding::Bone &bone) {
+    float ab[3], ap[3];
+    float abab = 0, apab = 0;
+    for (int i = 0; i < 3; ++i) {
+        ab[i] = bone.b[i] - bone.a[i];
+        ap[i] = p[i] - bone.a[i];
+        abab += ab[i] * ab[i];
+        apab += ap[i] * ab[i];
+    }
+    float t = abab > 0 ? std::min(std::max(apab / abab, 0.f), 1.f) : 0.f;
+    float d2 = 0;
+    for (int i = 0; i < 3; ++i) {
+        float d = ap[i] - t * ab[i];
+        d2 += d * d;
+    }
+    return d2;
+}
+
+// squared distance from p to a box (0 inside)
+static float boxDist2(const float p[3], const float lo[3], const float hi[3]) {
+    float d2 = 0;
+    for (int i = 0; i < 3; ++i) {
+        float d = std::max(std::max(lo[i] - p[i], p[i] - hi[i]), 0.f);
+        d2 += d * d;
+    }
+    return d2;
+}
+
+// a growing bounding box of bones
+struct Box {
+    float lo[3];
+    float hi[3];
+
+    Box() {
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = HUGE_VALF;
+            hi[i] = -HUGE_VALF;
+        }
+    }
+
+    void grow(const skinbinding::Bone &bone) {
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = std::min(lo[i], std::min(bone.a[i], bone.b[i]));
+            hi[i] = std::max(hi[i], std::max(bone.a[i], bone.b[i]));
+        }
+    }
+
+    float area() const {
+        float dx = hi[0] - lo[0];
+        float dy = hi[1] - lo[1];
+        float dz = hi[2] - lo[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+// sort bones [begin, end) by their midpoints along an axis
+static void sortByMidpoint(std::vector<skinbinding::Bone> &bones, uint32_t begin, uint32_t end, int axis) {
+    std::sort(bones.begin() + begin, bones.begin() + end,
+              [axis](const skinbinding::Bone &x, const skinbinding::Bone &y) {
+                  return x.a[axis] + x.b[axis] < y.a[axis] + y.b[axis];
+              });
+}
+
+uint32_t skinbinding::BoneBVH::buildNode(uint32_t begin, uint32_t end, int depth) {
+    uint32_t index = nodes.size();
+    nodes.push_back(Node());
+
+    Box box;
+    for (uint32_t b = begin; b < end; ++b) {
+        box.grow(bones[b]);
+    }
+    Node node;
+    std::copy(box.lo, box.lo + 3, node.lo);
+    std::copy(box.hi, box.hi + 3, node.hi);
+
+    if (end - begin <= LEAF_SIZE) {
+        node.first = begin;
+        node.count = end - begin;
+        nodes[index] = node;
+        return index;
+    }
+
+    // split the bones, ordered by midpoint along one axis, where the surface
+    // area heuristic says a query will test the fewest bones: the bones of
+    // each side weighted by the surface area of that side's box
+    uint32_t count = end - begin;
+    uint32_t minSide = depth < SAH_DEPTH ? 1 : count / 2;
+    std::vector<float> rightCost(count);
+    float bestCost = HUGE_VALF;
+    int axis = 0;
+    uint32_t mid = begin + count / 2;
+    for (int a = 0; a < 3; ++a) {
+        sortByMidpoint(bones, begin, end, a);
+        Box right;
+        for (uint32_t i = count - 1; i > 0; --i) {
+            right.grow(bones[begin + i]);
+            rightCost[i] = right.area() * (count - i);
+        }
+        Box left;
+        for (uint32_t i = 1; i < count; ++i) {
+            left.grow(bones[begin + i - 1]);
+            float cost = left.area() * i + rightCost[i];
+            if (cost < bestCost && i >= minSide && count - i >= minSide) {
+                bestCost = cost;
+                axis = a;
+                mid = begin + i;
+            }
+        }
+    }
+    sortByMidpoint(bones, begin, end, axis);
+
+    buildNode(begin, mid, depth + 1);
+    node.first = buildNode(mid, end, depth + 1);
+    node.count = 0;
+    nodes[index] = node;
+    return index;
+}
+
+void skinbinding::BoneBVH::build(const std::vector<Bone> &bs) {
+    bones = bs;
+    nodes.clear();
+    if (!bones.empty()) {
+        nodes.reserve(2 * (bones.size() / LEAF_SIZE + 1));
+        buildNode(0, bones.size(), 0);
+    }
+
+    // the bones of each joint, in their order after the build
+    int jointCount = 0;
+    for (const Bone &bone : bones) {
+        jointCount = std::max(jointCount, bone.joint + 1);
+    }
+    jointFirst.assign(jointCount + 1, 0);
+    for (const Bone &bone : bones) {
+        jointFirst[bone.joint + 1]++;
+    }
+    for (int j = 0; j < jointCount; ++j) {
+        jointFirst[j + 1] += jointFirst[j];
+    }
+    jointBones.resize(bones.size());
+    std::vector<uint32_t> fill(jointFirst.begin(), jointFirst.end() - 1);
+    for (uint32_t b = 0; b < bones.size(); ++b) {
+        jointBones[fill[bones[b].joint]++] = b;
+    }
+}
+
+bool skinbinding::BoneBVH::empty() const {
+    return nodes.empty();
+}
+
+int skinbinding::BoneBVH::nearest(const float p[3], int k, int* joints, float* dists,
+                                  const int* seeds, int seedCount) const {
+    k = std::min(std::max(k, 1), MAX_K);
+
+    // best distinct owners so far, sorted by squared distance, and the
+    // distance a bone has to beat to get in
+    int bestJoint[MAX_K];
+    float bestDist2[MAX_K];
+    int found = 0;
+    float bound = HUGE_VALF;
+
+    // an owner already in the list only keeps its closest bone
+    auto offer = [&](int owner, float d2) {
+        if (d2 >= bound) {
+            return;
+        }
+        int slot = 0;
+        while (slot < found && bestJoint[slot] != owner) {
+            slot++;
+        }
+        if (slot < found) {
+            if (d2 >= bestDist2[slot]) {
+                return;
+            }
+        } else if (found < k) {
+            slot = found++;
+        } else {
+            slot = k - 1;
+        }
+
+        // move the entry up to its sorted position
+        while (slot > 0 && bestDist2[slot - 1] > d2) {
+            bestJoint[slot] = bestJoint[slot - 1];
+            bestDist2[slot] = bestDist2[slot - 1];
+            slot--;
+        }
+        bestJoint[slot] = owner;
+        bestDist2[slot] = d2;
+        if (found == k) {
+            bound = bestDist2[k - 1];
+        }
+    };
+
+    // the seeds' bones first: when they are near p (the joints of a nearby
+    // vertex, say), the bound is tight before the tree is even entered
+    for (int s = 0; s < seedCount; ++s) {
+        int joint = seeds[s];
+        if (joint >= 0 && joint + 1 < (int) jointFirst.size()) {
+            for (uint32_t i = jointFirst[joint]; i < jointFirst[joint + 1]; ++i) {
+                offer(joint, segmentDist2(p, bones[jointBones[i]]));
+            }
+        }
+    }
+
+    // nodes still to visit, with the squared distance to their box
+    uint32_t stack[64];
+    float stackDist2[64];
+    int top = 0;
+    if (!nodes.empty()) {
+        stack[top] = 0;
+        stackDist2[top++] = 0;
+    }
+
+    while (top > 0) {
+        --top;
+        if (stackDist2[top] >= bound) {
+            continue;
+        }
+        const Node &node = nodes[stack[top]];
+
+        if (node.count == 0) {
+            // the nearer child goes on top so it is searched first
+            uint32_t left = (uint32_t) (&node - nodes.data()) + 1;
+            uint32_t right = node.first;
+            float dl = boxDist2(p, nodes[left].lo, nodes[left].hi);
+            float dr = boxDist2(p, nodes[right].lo, nodes[right].hi);
+            if (dl > dr) {
+                std::swap(left, right);
+                std::swap(dl, dr);
+            }
+            if (dr < bound) {
+                stack[top] = right;
+                stackDist2[top++] = dr;
+            }
+            if (dl < bound) {
+                stack[top] = left;
+                stackDist2[top++] = dl;
+            }
+            continue;
+        }
+
+        for (uint32_t b = node.first; b < node.first + node.count; ++b) {
+            offer(bones[b].joint, segmentDist2(p, bones[b]));
+        }
+    }
+
+    for (int i = 0; i < found; ++i) {
+        joints[i] = bestJoint[i];
+        dists[i] = std::sqrt(bestDist2[i]);
+    }
+    return found;
+}
+
+// spread the low 10 bits of x to every third bit
+static uint32_t spreadBits(uint32_t x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+void skinbinding::bind(const float* positions, size_t vertCount, const BoneBVH &bvh, int k,
+                       int* joints, float* weights) {
+    k = std::min(std::max(k, 1), MAX_K);
+    if (vertCount == 0) {
+        return;
+    }
+
+    // visit the vertices along a Morton curve, so each query is seeded with
+    // the joints of a vertex close to it whatever order the mesh is in
+    float lo[3] = {HUGE_VALF, HUGE_VALF, HUGE_VALF};
+    float hi[3] = {-HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+    for (size_t v = 0; v < vertCount; ++v) {
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = std::min(lo[i], positions[4 * v + i]);
+            hi[i] = std::max(hi[i], positions[4 * v + i]);
+        }
+    }
+    float scale[3];
+    for (int i = 0; i < 3; ++i) {
+        scale[i] = hi[i] > lo[i] ? 1023.f / (hi[i] - lo[i]) : 0.f;
+    }
+    std::vector<uint64_t> order(vertCount);
+    parallel::forRange(vertCount, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t code = 0;
+            for (int i = 0; i < 3; ++i) {
+                code |= spreadBits((uint32_t) ((positions[4 * v + i] - lo[i]) * scale[i])) << i;
+            }
+            order[v] = (uint64_t) code << 32 | v;
+        }
+    });
+    std::sort(order.begin(), order.end());
+
+    parallel::forRange(vertCount, 1024, [&](size_t begin, size_t end) {
+        float dists[MAX_K];
+        const int* seeds = nullptr;
+        int seedCount = 0;
+        for (size_t n = begin; n < end; ++n) {
+            size_t v = (uint32_t) order[n];
+            int* vj = joints + k * v;
+            float* vw = weights + k * v;
+            int found = bvh.nearest(positions + 4 * v, k, vj, dists, seeds, seedCount);
+            seeds = vj;
+            seedCount = found;
+
+            // inverse distance weights; a vertex on a bone belongs to it alone
+            float total = 0;
+            for (int i = 0; i < found; ++i) {
+                vw[i] = 1.f / std::max(dists[i], 1e-6f);
+                total += vw[i];
+            }
+            for (int i = 0; i < found; ++i) {
+                vw[i] /= total;
+            }
+            for (int i = found; i < k; ++i) {
+                vj[i] = found > 0 ? vj[0] : 0;
+                vw[i] = 0;
+            }
+        }
+    });
+}
@@ -0,0 +1,72 @@
+#ifndef SKINBINDING_H
+#define SKINBINDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Automatic skin binding.
+///
+/// Every bone is a segment from a joint to one of its children, owned by the
+/// joint (rotating the joint swings the segment); joints without children are
+/// single points. A BVH over the segments (split by the surface area
+/// heuristic) answers "which k distinct joints own the bones nearest to this
+/// point" without scanning the whole skeleton, and bind() runs that query for
+/// every vertex in parallel, writing joint indices and inverse-distance
+/// weights into flat arrays. bind() visits the vertices along a Morton curve
+/// and seeds each query with the joints found for the vertex before it, so
+/// the search starts with a tight bound.
+
+namespace skinbinding {
+    // most influences a query can return
+    static const int MAX_K = 8;
+
+    // a bone segment from a to b (a == b for a point) owned by a joint index
+    struct Bone {
+        float a[3];
+        float b[3];
+        int joint;
+    };
+
+    class BoneBVH {
+    private:
+        // leaf: count > 0 and bones [first, first + count)
+        // inner: count == 0, left child is the next node and right child is first
+        struct Node {
+            float lo[3];
+            float hi[3];
+            uint32_t first;
+            uint32_t count;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<Bone> bones;
+
+        // bones of joint j: bones[jointBones[jointFirst[j] .. jointFirst[j + 1])]
+        std::vector<uint32_t> jointFirst;
+        std::vector<uint32_t> jointBones;
+
+        uint32_t buildNode(uint32_t begin, uint32_t end, int depth);
+
+    public:
+        void build(const std::vector<Bone> &bs);
+
+        // the k nearest distinct joints to p (closest first) and their distances
+        // returns how many were found (fewer than k if the skeleton is small)
+        // seeds (the joints of a nearby point, say) are measured first to
+        // narrow the search
+        int nearest(const float p[3], int k, int* joints, float* dists,
+                    const int* seeds = nullptr, int seedCount = 0) const;
+
+        bool empty() const;
+    };
+
+    // for each of vertCount positions (xyzw quadruples), write the k nearest joints
+    // and their normalized inverse-distance weights to joints[k * v .. k * v + k)
+    // and weights[k * v .. k * v + k). Missing slots repeat the nearest joint with
+    // zero weight.
+    void bind(const float* positions, size_t vertCount, const BoneBVH &bvh, int k,
+              int* joints, float* weights);
+}
+
+#endif // SKINBINDING_H
@@ -0,0 +1,95 @@
+#include "skinweights.h"
+#include <algorithm>
+#include <cmath>
+
+// unbound
+SkinWeights::SkinWeights() {
+    clear();
+}
+
+void SkinWeights::set(const int* jts, const float* ws, int n, float minWeight) {
+    clear();
+
+    // the largest MAX_INFLUENCES weights, largest first; duplicate joints are merged
+    int bestJoint[MAX_INFLUENCES];
+    float bestWeight[MAX_INFLUENCES];
+    int found = 0;
+    float total = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!(ws[i] > 0) || jts[i] < 0) {
+            continue;
+        }
+        total += ws[i];
+
+        float w = ws[i];
+        int slot = 0;
+        while (slot < found && bestJoint[slot] != jts[i]) {
+            slot++;
+        }
+        if (slot < found) {
+            w += bestWeight[slot];
+        } else if (found < MAX_INFLUENCES) {
+            slot = found++;
+        } else if (w > bestWeight[MAX_INFLUENCES - 1]) {
+            slot = MAX_INFLUENCES - 1;
+        } else {
+            continue;
+        }
+        while (slot > 0 && bestWeight[slot - 1] < w) {
+            bestJoint[slot] = bestJoint[slot - 1];
+            bestWeight[slot] = bestWeight[slot - 1];
+            slot--;
+        }
+        bestJoint[slot] = jts[i];
+        bestWeight[slot] = w;
+    }
+
+    // prune tiny influences, but always keep the largest
+    while (found > 1 && bestWeight[found - 1] < minWeight * total) {
+        found--;
+    }
+
+    float kept = 0;
+    for (int i = 0; i < found; ++i) {
+        kept += bestWeight[i];
+    }
+    if (found == 0 || !(kept > 0)) {
+        return;
+    }
+
+    // quantize, handing the rounding error to the largest weight so the sum is exact
+    int sum = 0;
+    for (int i = 0; i < found; ++i) {
+        joints[i] = (uint16_t) bestJoint[i];
+        weights[i] = (uint16_t) std::lround(bestWeight[i] / kept * 65535.f);
+        sum += weights[i];
+    }
+    weights[0] = (uint16_t) (weights[0] + 65535 - sum);
+}
+
+// drop every influence
+void SkinWeights::clear() {
+    for (int i = 0; i < MAX_INFLUENCES; ++i) {
+        joints[i] = 0;
+        weights[i] = 0;
+    }
+}
+
+// number of influences with non-zero weight
+int SkinWeights::count() const {
+    int n = 0;
+    for (int i = 0; i < MAX_INFLUENCES; ++i) {
+        n += weights[i] != 0;
+    }
+    return n;
+}
+
+// weight of slot i as a float in [0, 1]
+float SkinWeights::weight(int i) const {
+    return weights[i] / 65535.f;
+}
+
+// does any joint move this vertex?
+bool SkinWeights::isBound() const {
+    return weights[0] != 0;
+}
@@ -0,0 +1,38 @@
+#ifndef SKINWEIGHTS_H
+#define SKINWEIGHTS_H
+
+#include <cstdint>
+
+/// SKIN WEIGHTS:
+/// the joints that move a vertex and how much, packed into 16 bytes: up to four
+/// 16-bit joint indices (into the skeleton) and four unorm16 weights that sum to
+/// exactly 65535. Unused slots have zero weight; a vertex with no weights is
+/// unbound and stays at its rest position. The layout is uploaded to the GPU as is.
+
+struct SkinWeights {
+    static const int MAX_INFLUENCES = 4;
+
+    uint16_t joints[MAX_INFLUENCES];
+    uint16_t weights[MAX_INFLUENCES];
+
+    // unbound
+    SkinWeights();
+
+    // set from n (joint, weight) pairs: keeps the MAX_INFLUENCES largest, prunes
+    // those below minWeight of the total, then normalizes and quantizes the rest
+    void set(const int* jts, const float* ws, int n, float minWeight = 0.01f);
+
+    // drop every influence
+    void clear();
+
+    // number of influences with non-zero weight
+    int count() const;
+
+    // weight of slot i as a float in [0, 1]
+    float weight(int i) const;
+
+    // does any joint move this vertex?
+    bool isBound() const;
+};
+
+#endif // SKINWEIGHTS_H
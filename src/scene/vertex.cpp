@@ -13,6 +13,7 @@ int HalfEdge::heCount = 0;
 // constructor
 Vertex::Vertex(const glm::vec4 v) :
     points(v),
+    vertHE(nullptr),
     id(vertCount++)
 {
     setText(QString::number(id));
@@ -41,28 +42,14 @@ glm::vec4 Vertex::getCoord() const {
     return points;
 }
 
-// set influence given two joints and two distances
-void Vertex::setInfluence(Joint* jt1, const float d1, Joint* jt2, const float d2) {
-    // compute influence as a percentage
-    float total = d1 + d2;
-    float infJt1 = d1 / total;
-    float infJt2 = d2 / total;
-
-    joints.push_back(jt1);
-    joints.push_back(jt2);
-
-    influences.push_back(infJt1);
-    influences.push_back(infJt2);
-}
-
-// get joints with inf on the current vertex
-std::vector<Joint*> Vertex::getJoints() const {
-    return joints;
+// setter for skin weights
+void Vertex::setSkinWeights(const SkinWeights &weights) {
+    skin = weights;
 }
 
-// get influence on the current vertex
-std::vector<float> Vertex::getInfluence() const {
-    return influences;
+// getter for skin weights
+const SkinWeights &Vertex::getSkinWeights() const {
+    return skin;
 }
 
 // getter for id
@@ -80,6 +67,7 @@ void Vertex::resetID() {
 
 // constuctor
 Face::Face(const glm::vec4 col) :
+    faceHE(nullptr),
     color(col),
     id(faceCount++)
 {
@@ -123,6 +111,8 @@ void Face::resetID() {
 
 // constructor
 HalfEdge::HalfEdge(Face* f, Vertex* v) :
+    next(nullptr),
+    sym(nullptr),
     face(f),
     vert(v),
     id(heCount++)
@@ -143,6 +133,19 @@ HalfEdge* HalfEdge::getSymHE() const {
     return sym;
 }
 
+// the vertex this half edge leaves from: the sym's vertex, or on a boundary
+// the vertex of the half edge before it around the face
+Vertex* HalfEdge::getStartVert() const {
+    if (sym != nullptr) {
+        return sym->vert;
+    }
+    const HalfEdge* prev = this;
+    while (prev->next != this) {
+        prev = prev->next;
+    }
+    return prev->vert;
+}
+
 // getter for face
 Face* HalfEdge::getFace() const {
     return face;
@@ -159,9 +162,12 @@ void HalfEdge::setNextHE(HalfEdge* he) {
 }
 
 // setter for symmetrical half edge
+// (null for a boundary edge)
 void HalfEdge::setSymHE(HalfEdge* he) {
     sym = he;
-    he->sym = this;
+    if (he != nullptr) {
+        he->sym = this;
+    }
 }
 
 // setter for face
@@ -1,6 +1,6 @@
 #ifndef VERTEX_H
 #define VERTEX_H
-#include "joint.h"
+#include "skinweights.h"
 #include <la.h>
 #include <QListWidgetItem>
 
@@ -14,8 +14,7 @@ private:
     HalfEdge* vertHE;
 
     // influence joints have on the vertex
-    std::vector<Joint*> joints;
-    std::vector<float> influences;
+    SkinWeights skin;
 
     int id;
 
@@ -40,14 +39,11 @@ public:
     // getter for coord
     glm::vec4 getCoord() const;
 
-    // set influence given two joints and two distances
-    void setInfluence(Joint* jt1, const float d1, Joint* jt2, const float d2);
+    // setter for skin weights
+    void setSkinWeights(const SkinWeights &weights);
 
-    // get joints with inf on the current vertex
-    std::vector<Joint*>  getJoints() const;
-
-    // get influence on the current vertex
-    std::vector<float>  getInfluence() const;
+    // getter for skin weights
+    const SkinWeights &getSkinWeights() const;
 
     // getter for id
     int getID() const;
@@ -118,6 +114,9 @@ public:
     // getter for symmetrical half edge
     HalfEdge* getSymHE() const;
 
+    // the vertex this half edge leaves from (also on boundaries, where sym is null)
+    Vertex* getStartVert() const;
+
     // getter for face
     Face* getFace() const;
 
@@ -0,0 +1,183 @@
+#include "vertexcache.h"
+#include <cmath>
+#include <cstring>
+
+/// FORSYTH'S ALGORITHM:
+/// every vertex gets a score from its position in a simulated LRU cache
+/// (recently used vertices score high) and from the number of triangles
+/// still using it (low valence scores high, so stragglers get finished off).
+/// A triangle's score is the sum of its vertex scores. We greedily emit the
+/// best triangle touching the cache, then rescore only the cached vertices.
+/// See https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+
+static const int CACHE_SIZE = 32;
+static const int MAX_VALENCE = 64;
+
+static const float CACHE_DECAY = 1.5f;
+static const float LAST_TRI_SCORE = 0.75f;
+static const float VALENCE_SCALE = 2.0f;
+static const float VALENCE_POWER = 0.5f;
+
+struct ScoreTables {
+    float cache[CACHE_SIZE];
+    float valence[MAX_VALENCE];
+
+    ScoreTables() {
+        for (int i = 0; i < CACHE_SIZE; ++i) {
+            if (i < 3) {
+                // the three vertices of the last triangle are all equally useful
+                cache[i] = LAST_TRI_SCORE;
+            } else {
+                float s = 1.f - (i - 3) / (float) (CACHE_SIZE - 3);
+                cache[i] = std::pow(s, CACHE_DECAY);
+            }
+        }
+        valence[0] = 0;
+        for (int i = 1; i < MAX_VALENCE; ++i) {
+            valence[i] = VALENCE_SCALE * std::pow((float) i, -VALENCE_POWER);
+        }
+    }
+};
+
+static float vertexScore(const ScoreTables &tables, int cachePos, uint32_t remaining) {
+    if (remaining == 0) {
+        // no triangle needs this vertex any more
+        return -1.f;
+    }
+    float score = cachePos >= 0 ? tables.cache[cachePos] : 0.f;
+    return score + (remaining < MAX_VALENCE ? tables.valence[remaining]
+                                            : VALENCE_SCALE * std::pow((float) remaining, -VALENCE_POWER));
+}
+
+void vertexcache::optimizeTriangles(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    static const ScoreTables tables;
+    size_t triCount = indexCount / 3;
+    if (triCount < 2) {
+        return;
+    }
+
+    // STEP 1: vertex -> triangle adjacency in CSR form
+    std::vector<uint32_t> adjOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triCount * 3; ++i) {
+        adjOffsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjOffsets[v + 1] += adjOffsets[v];
+    }
+    std::vector<uint32_t> adj(triCount * 3);
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t t = 0; t < triCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[3 * t + k];
+            adj[adjOffsets[v] + remaining[v]++] = (uint32_t) t;
+        }
+    }
+
+    // STEP 2: initial scores
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vScore[v] = vertexScore(tables, -1, remaining[v]);
+    }
+
+    std::vector<float> tScore(triCount);
+    std::vector<bool> emitted(triCount, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triCount; ++t) {
+        tScore[t] = vScore[indices[3 * t]] + vScore[indices[3 * t + 1]] + vScore[indices[3 * t + 2]];
+        if (tScore[t] > tScore[best]) {
+            best = t;
+        }
+    }
+
+    // STEP 3: greedily emit triangles
+    std::vector<uint32_t> out(triCount * 3);
+
+    // the cache holds up to three extra vertices while the new triangle is pushed in
+    uint32_t cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t cursor = 0;
+
+    for (size_t n = 0; n < triCount; ++n) {
+        if (best == ~(size_t) 0) {
+            // nothing in the cache touches a live triangle: take the next unused one
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t* tri = indices + 3 * best;
+        out[3 * n] = tri[0];
+        out[3 * n + 1] = tri[1];
+        out[3 * n + 2] = tri[2];
+        emitted[best] = true;
+
+        // remove the triangle from its vertices' adjacency lists
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = tri[k];
+            uint32_t* list = adj.data() + adjOffsets[v];
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                if (list[i] == best) {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // push the triangle's vertices to the front of the LRU cache
+        uint32_t newCache[CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            newCache[newCount++] = tri[k];
+        }
+        for (int i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // rescore everything in the (extended) cache and find the next best triangle
+        best = ~(size_t) 0;
+        float bestScore = -1.f;
+        for (int i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            cachePos[v] = i < CACHE_SIZE ? i : -1;
+            vScore[v] = vertexScore(tables, cachePos[v], remaining[v]);
+        }
+        for (int i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            const uint32_t* list = adj.data() + adjOffsets[v];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                uint32_t t = list[j];
+                const uint32_t* tv = indices + 3 * (size_t) t;
+                tScore[t] = vScore[tv[0]] + vScore[tv[1]] + vScore[tv[2]];
+                if (tScore[t] > bestScore) {
+                    bestScore = tScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+        std::memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+    }
+
+    std::memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+size_t vertexcache::optimizeFetch(uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                  std::vector<uint32_t> &remap) {
+    remap.assign(vertexCount, ~0u);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (remap[v] == ~0u) {
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+    return next;
+}
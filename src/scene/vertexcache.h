@@ -0,0 +1,39 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Index buffer reordering for the GPU post-transform vertex cache.
+///
+/// optimizeTriangles() reorders the triangles of an indexed triangle list with
+/// Tom Forsyth's linear-speed algorithm so that consecutive triangles reuse
+/// recently transformed vertices, and optimizeFetch() then renumbers the
+/// vertices in order of first use so the vertex fetches walk memory linearly.
+/// Both are cheap (linear in the index count) and only pay off for shaders
+/// that do real work per vertex, like the skinning shader.
+
+namespace vertexcache {
+    // reorder the triangles of indices in place
+    void optimizeTriangles(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    // renumber vertices by first use; remap[old] = new (or ~0u for unused vertices)
+    // returns the number of referenced vertices
+    size_t optimizeFetch(uint32_t* indices, size_t indexCount, size_t vertexCount,
+                         std::vector<uint32_t> &remap);
+
+    // apply a remap produced by optimizeFetch to a per-vertex attribute array
+    template<typename T>
+    void remapVertices(std::vector<T> &attrib, const std::vector<uint32_t> &remap, size_t used) {
+        std::vector<T> out(used);
+        for (size_t i = 0; i < remap.size() && i < attrib.size(); ++i) {
+            if (remap[i] != ~0u) {
+                out[remap[i]] = attrib[i];
+            }
+        }
+        attrib.swap(out);
+    }
+}
+
+#endif // VERTEXCACHE_H
@@ -0,0 +1,230 @@
+#include "sectionfile.h"
+#include <parallel.h>
+
+// on-disk layout, native little-endian
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // BYTE_ORDER as written; reads back swapped on the wrong endianness
+    uint32_t sectionCount;
+    uint32_t reserved;
+    uint64_t tableChecksum;
+};
+
+struct TableEntry {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t checksum;
+};
+
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// checksums hash 1 MB blocks in parallel, then hash the block hashes
+static const size_t HASH_BLOCK = 1 << 20;
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mixWord(uint64_t acc, uint64_t word) {
+    return rotl(acc + word * PRIME2, 31) * PRIME1;
+}
+
+// four independent lanes of multiply-rotate over 8-byte words, then the tail
+static uint64_t hashBytes(const uint8_t* p, size_t n, uint64_t seed) {
+    size_t i = 0;
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t a = seed + PRIME1 + PRIME2;
+        uint64_t b = seed + PRIME2;
+        uint64_t c = seed;
+        uint64_t d = seed - PRIME1;
+        for (; i + 32 <= n; i += 32) {
+            a = mixWord(a, load64(p + i));
+            b = mixWord(b, load64(p + i + 8));
+            c = mixWord(c, load64(p + i + 16));
+            d = mixWord(d, load64(p + i + 24));
+        }
+        h = rotl(a, 1) + rotl(b, 7) + rotl(c, 12) + rotl(d, 18);
+    } else {
+        h = seed + PRIME3;
+    }
+    h += n;
+    for (; i + 8 <= n; i += 8) {
+        h ^= mixWord(0, load64(p + i));
+        h = rotl(h, 27) * PRIME1 + PRIME3;
+    }
+    for (; i < n; ++i) {
+        h ^= p[i] * PRIME3;
+        h = rotl(h, 11) * PRIME1;
+    }
+    // final avalanche
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t sectionfile::checksum(const void* data, size_t bytes) {
+    const uint8_t* p = (const uint8_t*) data;
+    size_t blocks = (bytes + HASH_BLOCK - 1) / HASH_BLOCK;
+    if (blocks <= 1) {
+        return hashBytes(p, bytes, 0);
+    }
+    std::vector<uint64_t> hashes(blocks);
+    parallel::forRange(blocks, 1, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t begin = b * HASH_BLOCK;
+            hashes[b] = hashBytes(p + begin, std::min(HASH_BLOCK, bytes - begin), b);
+        }
+    });
+    return hashBytes((const uint8_t*) hashes.data(), blocks * sizeof(uint64_t), bytes);
+}
+
+static uint64_t alignUp(uint64_t x) {
+    return (x + sectionfile::ALIGNMENT - 1) / sectionfile::ALIGNMENT * sectionfile::ALIGNMENT;
+}
+
+/// SECTION WRITER FUNCTIONS:
+
+// queue a section
+void SectionWriter::add(uint32_t id, const void* data, size_t bytes, uint32_t elementSize) {
+    sections.push_back({id, elementSize, data, bytes});
+}
+
+// write the queued sections
+bool SectionWriter::write(const QString &path, const char* magic, uint32_t version) const {
+    FileHeader header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.sectionCount = (uint32_t) sections.size();
+    header.reserved = 0;
+
+    std::vector<TableEntry> table(sections.size());
+    uint64_t offset = alignUp(sizeof(FileHeader) + table.size() * sizeof(TableEntry));
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const Pending &s = sections[i];
+        table[i].id = s.id;
+        table[i].elementSize = s.elementSize;
+        table[i].offset = offset;
+        table[i].bytes = s.bytes;
+        table[i].checksum = sectionfile::checksum(s.data, s.bytes);
+        offset = alignUp(offset + s.bytes);
+    }
+    header.tableChecksum = sectionfile::checksum(table.data(), table.size() * sizeof(TableEntry));
+
+    // write next to the target and swap it in at the end, so a failed
+    // write never leaves a truncated file behind
+    QString tmpPath = path + ".tmp";
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    bool ok = file.write((const char*) &header, sizeof(header)) == (qint64) sizeof(header);
+    qint64 tableBytes = (qint64) (table.size() * sizeof(TableEntry));
+    ok = ok && file.write((const char*) table.data(), tableBytes) == tableBytes;
+
+    static const char zeros[sectionfile::ALIGNMENT] = {};
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        qint64 pad = (qint64) table[i].offset - file.pos();
+        ok = pad >= 0 && file.write(zeros, pad) == pad;
+        ok = ok && file.write((const char*) sections[i].data, sections[i].bytes) == (qint64) sections[i].bytes;
+    }
+    file.close();
+
+    if (!ok) {
+        QFile::remove(tmpPath);
+        return false;
+    }
+    QFile::remove(path);
+    return QFile::rename(tmpPath, path);
+}
+
+/// SECTION READER FUNCTIONS:
+
+SectionReader::SectionReader() :
+    base(nullptr)
+{}
+
+// map the file and check its magic, version, layout and checksums
+bool SectionReader::open(const QString &path, const char* magic, uint32_t version) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    if (size < (qint64) sizeof(FileHeader) || (base = file.map(0, size)) == nullptr) {
+        close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    uint64_t tableEnd = sizeof(FileHeader) + (uint64_t) header.sectionCount * sizeof(TableEntry);
+    if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0
+            || header.version != version
+            || header.byteOrder != BYTE_ORDER_MARK
+            || tableEnd > (uint64_t) size
+            || sectionfile::checksum(base + sizeof(FileHeader), tableEnd - sizeof(FileHeader))
+               != header.tableChecksum) {
+        close();
+        return false;
+    }
+
+    sections.resize(header.sectionCount);
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        TableEntry entry;
+        std::memcpy(&entry, base + sizeof(FileHeader) + i * sizeof(TableEntry), sizeof(entry));
+        bool inside = entry.offset % sectionfile::ALIGNMENT == 0
+                && entry.offset >= tableEnd
+                && entry.offset <= (uint64_t) size
+                && entry.bytes <= (uint64_t) size - entry.offset;
+        if (!inside || entry.elementSize == 0 || entry.bytes % entry.elementSize != 0
+                || sectionfile::checksum(base + entry.offset, entry.bytes) != entry.checksum) {
+            close();
+            return false;
+        }
+        sections[i] = {entry.id, entry.elementSize, entry.offset, entry.bytes, entry.checksum};
+    }
+    return true;
+}
+
+// unmap the file
+void SectionReader::close() {
+    if (file.isOpen()) {
+        // closing the file releases its mapping
+        file.close();
+    }
+    base = nullptr;
+    sections.clear();
+}
+
+// a section's bytes in the mapping
+const void* SectionReader::section(uint32_t id, uint32_t elementSize, size_t &bytes) const {
+    for (const Section &s : sections) {
+        if (s.id == id) {
+            if (s.elementSize != elementSize) {
+                return nullptr;
+            }
+            bytes = (size_t) s.bytes;
+            return base + s.offset;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,89 @@
+#ifndef SECTIONFILE_H
+#define SECTIONFILE_H
+
+#include <QFile>
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// Binary container of typed sections, read back through a memory map.
+///
+/// A file is a 32-byte header (8-byte magic, version, byte order marker,
+/// section count and a checksum of the section table), the section table
+/// (id, element size, offset, size and checksum of every section) and the
+/// sections themselves, each starting on a 64-byte boundary so arrays of any
+/// element type can be used in place. Every section is checksummed when the
+/// file is opened; nothing is parsed.
+
+namespace sectionfile {
+    // every section starts at a multiple of this
+    static const size_t ALIGNMENT = 64;
+
+    // 64-bit hash of a block of bytes (parallel over 1 MB blocks)
+    uint64_t checksum(const void* data, size_t bytes);
+}
+
+class SectionWriter {
+private:
+    struct Pending {
+        uint32_t id;
+        uint32_t elementSize;
+        const void* data;
+        size_t bytes;
+    };
+    std::vector<Pending> sections;
+
+public:
+    // queue a section (the data must stay alive until write())
+    void add(uint32_t id, const void* data, size_t bytes, uint32_t elementSize);
+
+    // write the queued sections; magic is 8 bytes
+    bool write(const QString &path, const char* magic, uint32_t version) const;
+};
+
+class SectionReader {
+private:
+    struct Section {
+        uint32_t id;
+        uint32_t elementSize;
+        uint64_t offset;
+        uint64_t bytes;
+        uint64_t checksum;
+    };
+
+    QFile file;
+    const uchar* base;
+    std::vector<Section> sections;
+
+public:
+    SectionReader();
+
+    // map the file and check its magic, version, layout and checksums
+    bool open(const QString &path, const char* magic, uint32_t version);
+
+    // unmap the file
+    void close();
+
+    // a section's bytes in the mapping, or nullptr if it's missing or its
+    // elements aren't elementSize bytes
+    const void* section(uint32_t id, uint32_t elementSize, size_t &bytes) const;
+
+    // copy a whole section into a vector; false if it's missing or mistyped
+    template<typename T>
+    bool read(uint32_t id, std::vector<T> &out) const {
+        size_t bytes = 0;
+        const void* data = section(id, sizeof(T), bytes);
+        if (data == nullptr) {
+            return false;
+        }
+        out.resize(bytes / sizeof(T));
+        if (bytes > 0) {
+            std::memcpy(out.data(), data, bytes);
+        }
+        return true;
+    }
+};
+
+#endif // SECTIONFILE_H
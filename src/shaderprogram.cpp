@@ -7,7 +7,7 @@ ShaderProgram::ShaderProgram(GLWidget277 *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1), attrIDs(-1), attrInf(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
-      unifBindMatrices(-1), unifJointTrans(-1),
+      unifJointPalette(-1), unifPaletteBase(-1), unifInstances(-1),
       context(context)
 {}
 
@@ -69,8 +69,9 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
     unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
-    unifBindMatrices = context->glGetUniformLocation(prog, "u_bindMatrices");
-    unifJointTrans = context->glGetUniformLocation(prog, "u_jointTrans");
+    unifJointPalette = context->glGetUniformLocation(prog, "u_JointPalette");
+    unifPaletteBase = context->glGetUniformLocation(prog, "u_PaletteBase");
+    unifInstances  = context->glGetUniformLocation(prog, "u_Instances");
 }
 
 void ShaderProgram::useMe()
@@ -137,6 +138,26 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
     }
 }
 
+void ShaderProgram::setJointPalette(int unit)
+{
+    useMe();
+
+    if (unifJointPalette != -1)
+    {
+        context->glUniform1i(unifJointPalette, unit);
+    }
+}
+
+void ShaderProgram::setPaletteBase(int texel)
+{
+    useMe();
+
+    if (unifPaletteBase != -1)
+    {
+        context->glUniform1i(unifPaletteBase, texel);
+    }
+}
+
 //This function, as its name implies, uses the passed in GL widget
 void ShaderProgram::draw(Drawable &d)
 {
@@ -166,20 +187,31 @@ void ShaderProgram::draw(Drawable &d)
         context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
     }
 
+    // joint indices are integers, read as such; weights are unorm16
     if (attrIDs != -1 && d.bindJtID()) {
         context->glEnableVertexAttribArray(attrIDs);
-        context->glVertexAttribPointer(attrIDs, 2, GL_FLOAT, false, 0, NULL);
+        context->glVertexAttribIPointer(attrIDs, 4, GL_UNSIGNED_SHORT, 0, NULL);
     }
 
     if (attrInf != -1 && d.bindJtInf()) {
         context->glEnableVertexAttribArray(attrInf);
-        context->glVertexAttribIPointer(attrInf, 2, GL_INT, 0, NULL);
+        context->glVertexAttribPointer(attrInf, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0, NULL);
+    }
+
+    // Per-instance data lives in a buffer texture on texture unit 0
+    if (unifInstances != -1 && d.bindInstances(0)) {
+        context->glUniform1i(unifInstances, 0);
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    int instances = d.instanceCount();
+    if (instances == 1) {
+        context->glDrawElements(d.drawMode(), d.elemCount(), d.indexType(), 0);
+    } else if (instances > 1) {
+        context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), d.indexType(), 0, instances);
+    }
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
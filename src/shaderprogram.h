@@ -19,16 +19,17 @@ public:
     int attrNor; // A handle for the "in" vec4 representing vertex normal in the vertex shader
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
 
-    int attrIDs; // A handle for the "in" ivec2 representing the joint IDs
-    int attrInf; // A handle for the "in" vec2 representing the joint influences on vertex
+    int attrIDs; // A handle for the "in" ivec4 representing the joint IDs
+    int attrInf; // A handle for the "in" vec4 representing the joint influences on vertex
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
     int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
     int unifColor; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
 
-    int unifBindMatrices; // a handle for the "uniform" array representing the bind matrices
-    int unifJointTrans; // a handle for the "uniform" array representing the bind matrices
+    int unifJointPalette; // a handle for the "uniform" samplerBuffer holding the per-joint matrices
+    int unifPaletteBase; // a handle for the "uniform" int offset of the current pose in the joint palette
+    int unifInstances; // a handle for the "uniform" samplerBuffer holding per-instance data
 
 public:
     ShaderProgram(GLWidget277* context);
@@ -42,6 +43,10 @@ public:
     void setViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
     void setGeometryColor(glm::vec4 color);
+    // Tell the shader which texture unit the joint palette buffer texture is bound to
+    void setJointPalette(int unit);
+    // Tell the shader at which texel of the joint palette the current pose starts
+    void setPaletteBase(int texel);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
     // Utility function used in create()
@@ -0,0 +1,47 @@
+#include "simd.h"
+
+#if defined(MM_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(MM_SIMD_X86) && defined(_MSC_VER)
+// read cpuid leaf 1 / leaf 7 and check that the OS saves the AVX registers
+static bool msvcHasFeature(bool avx2) {
+    int info[4];
+    __cpuid(info, 1);
+    if (!avx2) {
+        return (info[2] & (1 << 19)) != 0;
+    }
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+#endif
+
+bool simd::hasSSE41() {
+#if defined(MM_SIMD_X86) && defined(_MSC_VER)
+    static const bool supported = msvcHasFeature(false);
+    return supported;
+#elif defined(MM_SIMD_X86)
+    static const bool supported = __builtin_cpu_supports("sse4.1");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool simd::hasAVX2() {
+#if defined(MM_SIMD_X86) && defined(_MSC_VER)
+    static const bool supported = msvcHasFeature(true);
+    return supported;
+#elif defined(MM_SIMD_X86)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,29 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/// SIMD helpers: kernels are compiled once per instruction set using target
+/// attributes, and the widest one the running CPU supports is picked at runtime.
+/// This keeps the build flags baseline x86-64 while still using AVX2 when it's there.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MM_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MM_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MM_TARGET_SSE41
+#define MM_TARGET_AVX2
+#endif
+
+namespace simd {
+    // does the running CPU (and OS) support SSE4.1?
+    bool hasSSE41();
+
+    // does the running CPU (and OS) support AVX2?
+    bool hasAVX2();
+}
+
+#endif // SIMD_H
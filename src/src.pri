@@ -13,11 +13,38 @@ SOURCES += \
     $$PWD/la.cpp \
     $$PWD/drawable.cpp \
     $$PWD/camera.cpp \
+    $$PWD/frustum.cpp \
+    $$PWD/texturebuffer.cpp \
+    $$PWD/sectionfile.cpp \
+    $$PWD/backgroundtask.cpp \
     $$PWD/cameracontrolshelp.cpp \
     $$PWD/scene/vertex.cpp \
     $$PWD/scene/mesh.cpp \
     $$PWD/scene/drawvertex.cpp \
-    $$PWD/scene/joint.cpp
+    $$PWD/scene/joint.cpp \
+    $$PWD/scene/skinbinding.cpp \
+    $$PWD/scene/skinweights.cpp \
+    $$PWD/scene/cpuskinning.cpp \
+    $$PWD/scene/animation.cpp \
+    $$PWD/scene/palettebake.cpp \
+    $$PWD/scene/pointcache.cpp \
+    $$PWD/scene/ik.cpp \
+    $$PWD/scene/objreader.cpp \
+    $$PWD/scene/objwriter.cpp \
+    $$PWD/scene/plyreader.cpp \
+    $$PWD/scene/plywriter.cpp \
+    $$PWD/scene/chunkedwriter.cpp \
+    $$PWD/scene/glbreader.cpp \
+    $$PWD/scene/skeletonreader.cpp \
+    $$PWD/scene/rigfile.cpp \
+    $$PWD/scene/connectivity.cpp \
+    $$PWD/scene/meshcache.cpp \
+    $$PWD/scene/sessionfile.cpp \
+    $$PWD/scene/skeletongizmo.cpp \
+    $$PWD/scene/meshchunk.cpp \
+    $$PWD/scene/normals.cpp \
+    $$PWD/scene/vertexcache.cpp \
+    $$PWD/simd.cpp
 
 HEADERS += \
     $$PWD/la.h \
@@ -30,8 +57,38 @@ HEADERS += \
     $$PWD/scene/sphere.h \
     $$PWD/drawable.h \
     $$PWD/camera.h \
+    $$PWD/frustum.h \
+    $$PWD/texturebuffer.h \
+    $$PWD/sectionfile.h \
+    $$PWD/backgroundtask.h \
     $$PWD/cameracontrolshelp.h \
     $$PWD/scene/vertex.h \
     $$PWD/scene/mesh.h \
     $$PWD/scene/drawvertex.h \
-    $$PWD/scene/joint.h
+    $$PWD/scene/joint.h \
+    $$PWD/scene/skinbinding.h \
+    $$PWD/scene/skinweights.h \
+    $$PWD/scene/cpuskinning.h \
+    $$PWD/scene/animation.h \
+    $$PWD/scene/palettebake.h \
+    $$PWD/scene/pointcache.h \
+    $$PWD/scene/ik.h \
+    $$PWD/scene/objreader.h \
+    $$PWD/scene/objwriter.h \
+    $$PWD/scene/plyreader.h \
+    $$PWD/scene/plywriter.h \
+    $$PWD/scene/chunkedwriter.h \
+    $$PWD/scene/glbreader.h \
+    $$PWD/scene/skeletonreader.h \
+    $$PWD/scene/rigfile.h \
+    $$PWD/scene/connectivity.h \
+    $$PWD/scene/meshcache.h \
+    $$PWD/scene/sessionfile.h \
+    $$PWD/scene/skeletongizmo.h \
+    $$PWD/scene/mesharrays.h \
+    $$PWD/scene/skeletonarrays.h \
+    $$PWD/scene/meshchunk.h \
+    $$PWD/scene/normals.h \
+    $$PWD/scene/vertexcache.h \
+    $$PWD/simd.h \
+    $$PWD/parallel.h
@@ -0,0 +1,52 @@
+#include "texturebuffer.h"
+
+TextureBuffer::TextureBuffer(GLWidget277* context, GLenum format)
+    : buf(0), tex(0), format(format), capacity(0), created(false),
+      mp_context(context)
+{}
+
+void TextureBuffer::upload(const void* data, size_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+
+    if (!created) {
+        mp_context->glGenBuffers(1, &buf);
+        mp_context->glGenTextures(1, &tex);
+        created = true;
+    }
+
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, buf);
+    if (bytes > capacity) {
+        // reallocate and point the texture at the new storage
+        mp_context->glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+        capacity = bytes;
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+        mp_context->glTexBuffer(GL_TEXTURE_BUFFER, format, buf);
+    } else {
+        mp_context->glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    }
+}
+
+void TextureBuffer::bind(int unit)
+{
+    mp_context->glActiveTexture(GL_TEXTURE0 + unit);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+    mp_context->glActiveTexture(GL_TEXTURE0);
+}
+
+void TextureBuffer::destroy()
+{
+    if (created) {
+        mp_context->glDeleteTextures(1, &tex);
+        mp_context->glDeleteBuffers(1, &buf);
+        created = false;
+        capacity = 0;
+    }
+}
+
+bool TextureBuffer::isCreated() const
+{
+    return created;
+}
@@ -0,0 +1,36 @@
+#ifndef TEXTUREBUFFER_H
+#define TEXTUREBUFFER_H
+
+#include <glwidget277.h>
+#include <la.h>
+
+//A buffer object read by shaders through a samplerBuffer (texelFetch).
+//Used for per-instance and per-joint data that doesn't fit in uniforms.
+class TextureBuffer
+{
+private:
+    GLuint buf;        // the buffer object holding the data
+    GLuint tex;        // the buffer texture the shaders sample
+    GLenum format;     // internal format of one texel, e.g. GL_RGBA32F
+    size_t capacity;   // bytes allocated in buf
+    bool created;
+
+    GLWidget277* mp_context;
+
+public:
+    TextureBuffer(GLWidget277* context, GLenum format = GL_RGBA32F);
+
+    // copy bytes of data into the buffer; the storage only grows, otherwise a
+    // single glBufferSubData replaces the contents
+    void upload(const void* data, size_t bytes);
+
+    // bind the buffer texture to the given texture unit
+    void bind(int unit);
+
+    // frees the buffer and texture
+    void destroy();
+
+    bool isCreated() const;
+};
+
+#endif // TEXTUREBUFFER_H